@@ -0,0 +1,193 @@
+#!/bin/bash
+# Benchmark suite for the three warehouse programs.
+#
+# Builds single_thread, openmp_exec and mpi_exec, generates seeded datasets with writedatatofile, and drives every
+# build through the same batch workload: load, point lookups, search, sort, bulk update, total value and export.
+# The data size and the thread / rank count are varied. Each phase is timed inside the program with a batch
+# "time" command, which reads the monotonic wall clock (the MPI build waits for every rank first).
+#
+# Usage: bench/run_benchmarks.sh [--rows=N[,N...]] [--files=N] [--workers=N[,N...]] [--repeats=N] [--lookups=N]
+#                                [--searches=N] [--seed=N] [--out=DIR] [--mpirun=COMMAND] [--no-mpi]
+#
+#   --rows      dataset sizes (default 1000000; at most 10000000, the programs' MAX_ITEMS)
+#   --files     CSV files each dataset is split into; passed to the generator and every program (default 20)
+#   --workers   OpenMP thread and MPI rank counts (default: powers of two up to the core count)
+#   --repeats   runs of every configuration; the scaling table uses the median (default 3)
+#   --lookups   point lookups in the workload (default 100000)
+#   --searches  name searches in the workload (default 200)
+#   --seed      seed of the datasets and the workload (default 42)
+#   --out       output directory (default bench/results)
+#   --mpirun    launcher the rank count is appended to (default "mpirun -np"; add --oversubscribe or
+#               --allow-run-as-root here when needed)
+#   --no-mpi    skip the MPI build
+#
+# Output, in the --out directory:
+#   results.csv  variant,rows,workers,repeat,phase,seconds   every timed phase of every run
+#   scaling.csv  variant,rows,workers,phase,median_seconds,speedup_vs_single_thread,speedup_vs_one_worker
+#   checks.csv   variant,rows,workers,repeat,total_value,items   the total after the workload, which every run of
+#                the same dataset must agree on
+#   environment.txt  machine, compilers and git revision of the run
+# CFLAGS (default -O2) is passed to every compiler.
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+ROWS=1000000
+FILES=20
+WORKERS=""
+REPEATS=3
+LOOKUPS=100000
+SEARCHES=200
+SEED=42
+OUT="$ROOT/bench/results"
+MPIRUN="mpirun -np"
+USE_MPI=1
+CFLAGS=${CFLAGS:--O2}
+PHASES="load lookups search sort bulk_update total_value export"
+
+for arg in "$@"; do
+    case "$arg" in
+        --rows=*) ROWS=${arg#--rows=} ;;
+        --files=*) FILES=${arg#--files=} ;;
+        --workers=*) WORKERS=${arg#--workers=} ;;
+        --repeats=*) REPEATS=${arg#--repeats=} ;;
+        --lookups=*) LOOKUPS=${arg#--lookups=} ;;
+        --searches=*) SEARCHES=${arg#--searches=} ;;
+        --seed=*) SEED=${arg#--seed=} ;;
+        --out=*) OUT=${arg#--out=} ;;
+        --mpirun=*) MPIRUN=${arg#--mpirun=} ;;
+        --no-mpi) USE_MPI=0 ;;
+        *) echo "Unknown option: $arg (see the top of $0)" >&2; exit 1 ;;
+    esac
+done
+
+if [ -z "$WORKERS" ]; then
+    cores=$(nproc)
+    WORKERS=1
+    for ((w = 2; w <= cores; w *= 2)); do WORKERS="$WORKERS,$w"; done
+fi
+if [ "$USE_MPI" = 1 ] && ! command -v mpicc > /dev/null; then
+    echo "mpicc not found; skipping the MPI build." >&2
+    USE_MPI=0
+fi
+
+mkdir -p "$OUT/bin" "$OUT/data"
+OUT=$(cd "$OUT" && pwd)
+BIN="$OUT/bin"
+
+# Build every program the same way
+echo "Building with CFLAGS=$CFLAGS..."
+gcc $CFLAGS "$ROOT/code/single_thread.c" -o "$BIN/single_thread" -lm
+gcc $CFLAGS -fopenmp "$ROOT/code/openmp_exec.c" -o "$BIN/openmp_exec" -lm
+gcc $CFLAGS -fopenmp "$ROOT/code/writedatatofile.c" -o "$BIN/writedatatofile" -lm
+if [ "$USE_MPI" = 1 ]; then
+    mpicc $CFLAGS "$ROOT/code/mpi_exec.c" -o "$BIN/mpi_exec" -lm
+fi
+
+{
+    echo "date: $(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    echo "host: $(uname -a)"
+    echo "cores: $(nproc)"
+    echo "cpu: $(grep -m1 'model name' /proc/cpuinfo 2>/dev/null | cut -d: -f2- | sed 's/^ *//')"
+    echo "gcc: $(gcc --version | head -1)"
+    [ "$USE_MPI" = 1 ] && echo "mpicc: $(mpicc --version | head -1)"
+    echo "git: $(git -C "$ROOT" rev-parse --short HEAD 2>/dev/null)$(git -C "$ROOT" diff --quiet 2>/dev/null || echo ' (modified)')"
+    echo "cflags: $CFLAGS"
+    echo "rows: $ROWS  files: $FILES  workers: $WORKERS  repeats: $REPEATS  lookups: $LOOKUPS  searches: $SEARCHES  seed: $SEED"
+} > "$OUT/environment.txt"
+
+echo "variant,rows,workers,repeat,phase,seconds" > "$OUT/results.csv"
+echo "variant,rows,workers,repeat,total_value,items" > "$OUT/checks.csv"
+
+# Function to write the batch workload for a dataset of $1 rows. The random IDs come from awk seeded with --seed,
+# so every build sees exactly the same commands.
+write_workload() {
+    awk -v rows="$1" -v lookups="$LOOKUPS" -v searches="$SEARCHES" -v seed="$SEED" 'BEGIN {
+        srand(seed)
+        print "time,load"
+        for (i = 0; i < lookups; i++) printf "get,%d\n", 1 + int(rand() * rows)
+        print "time,lookups"
+        for (i = 0; i < searches; i++) printf "search,Item_%d\n", 1 + int(rand() * rows)
+        print "time,search"
+        print "sort,price"
+        print "time,sort"
+        print "bulk,,-1,-1,-1,50,-1,-1,1,25,3,1.05"
+        print "time,bulk_update"
+        print "total"
+        print "time,total_value"
+        print "export,bench_export.csv,csv"
+        print "time,export"
+    }'
+}
+
+# Function to run one configuration: variant $1, rows $2, workers $3, repeat $4, in the dataset directory
+run_one() {
+    local variant=$1 rows=$2 workers=$3 repeat=$4
+    local output="$OUT/data/$rows/run.out"
+    case "$variant" in
+        single_thread) "$BIN/single_thread" --files="$FILES" --batch=workload.txt > "$output" 2> /dev/null ;;
+        openmp) OMP_NUM_THREADS=$workers "$BIN/openmp_exec" --files="$FILES" --batch=workload.txt > "$output" 2> /dev/null ;;
+        mpi) $MPIRUN "$workers" "$BIN/mpi_exec" --files="$FILES" --batch=workload.txt > "$output" 2> /dev/null ;;
+    esac
+    rm -f bench_export.csv*
+
+    # Time commands answer "<line> OK <label> <seconds>"; the total answers "<line> OK <value> <items>"
+    awk -v prefix="$variant,$rows,$workers,$repeat" -v phases="$PHASES" -v totalLine="$TOTAL_LINE" \
+        -v checks="$OUT/checks.csv" 'BEGIN { split(phases, list, " "); for (p in list) wanted[list[p]] = 1 }
+        $2 == "OK" && ($3 in wanted) { printf "%s,%s,%s\n", prefix, $3, $4; found++ }
+        $1 == totalLine && $2 == "OK" { printf "%s,%s,%s\n", prefix, $3, $4 >> checks }
+        END { if (found != length(list)) { print "missing phases in " FILENAME > "/dev/stderr"; exit 1 } }' \
+        "$output" >> "$OUT/results.csv"
+    rm -f "$output"
+}
+
+for rows in ${ROWS//,/ }; do
+    data="$OUT/data/$rows"
+    mkdir -p "$data"
+    cd "$data"
+    if [ "$(cat seed 2>/dev/null)" != "$SEED $FILES" ]; then
+        echo "Generating $rows rows in $FILES files..."
+        rm -f warehouse_data_*.csv
+        "$BIN/writedatatofile" --rows="$rows" --files="$FILES" --seed="$SEED" > /dev/null
+        echo "$SEED $FILES" > seed
+    fi
+    write_workload "$rows" > workload.txt
+    TOTAL_LINE=$(grep -n '^total$' workload.txt | cut -d: -f1)
+
+    for ((repeat = 1; repeat <= REPEATS; repeat++)); do
+        echo "rows=$rows repeat=$repeat: single_thread"
+        run_one single_thread "$rows" 1 "$repeat"
+        for workers in ${WORKERS//,/ }; do
+            echo "rows=$rows repeat=$repeat: openmp x$workers"
+            run_one openmp "$rows" "$workers" "$repeat"
+            if [ "$USE_MPI" = 1 ]; then
+                echo "rows=$rows repeat=$repeat: mpi x$workers"
+                run_one mpi "$rows" "$workers" "$repeat"
+            fi
+        done
+    done
+done
+
+# Medians per configuration and phase, then speedups against single_thread and against the same build on one worker
+tail -n +2 "$OUT/results.csv" | sort -t, -k1,1 -k2,2n -k3,3n -k5,5 -k6,6g | awk -F, '
+    function flush() { if (count) printf "%s,%s\n", key, (count % 2 ? values[(count + 1) / 2] : (values[count / 2] + values[count / 2 + 1]) / 2) }
+    { k = $1 "," $2 "," $3 "," $5; if (k != key) { flush(); key = k; count = 0 } values[++count] = $6 }
+    END { flush() }' > "$OUT/medians.tmp"
+awk -F, 'NR == FNR { if ($1 == "single_thread") base[$2 "," $4] = $5; if ($3 == 1) one[$1 "," $2 "," $4] = $5; next }
+    FNR == 1 { print "variant,rows,workers,phase,median_seconds,speedup_vs_single_thread,speedup_vs_one_worker" }
+    { b = base[$2 "," $4]; o = one[$1 "," $2 "," $4]
+      printf "%s,%s,%s,%s,%.6f,%s,%s\n", $1, $2, $3, $4, $5, ($5 > 0 && b != "" ? sprintf("%.2f", b / $5) : ""),
+             ($5 > 0 && o != "" ? sprintf("%.2f", o / $5) : "") }' "$OUT/medians.tmp" "$OUT/medians.tmp" > "$OUT/scaling.csv"
+rm -f "$OUT/medians.tmp"
+
+# Every run over one dataset executes the same writes, so it must end with the same total
+if [ "$(tail -n +2 "$OUT/checks.csv" | cut -d, -f2,5,6 | sort -u | cut -d, -f1 | uniq -d)" != "" ]; then
+    echo "WARNING: runs over the same dataset disagree on the final total; see $OUT/checks.csv" >&2
+fi
+
+if command -v column > /dev/null; then
+    column -t -s, "$OUT/scaling.csv"
+else
+    cat "$OUT/scaling.csv"
+fi
+echo "Results written to $OUT"
@@ -3,335 +3,4335 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <limits.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1 // SSE2 and AVX2 scan kernels are compiled in; which one runs is decided at run time
+#endif
 #include <mpi.h>
 
 #define INITIAL_SIZE 1000
 #define MAX_LINE_LENGTH 1024
-#define LOW_STOCK_THRESHOLD 10
+#define DATA_FILES 20 // Default count of warehouse_data_N.csv files loaded, as writedatatofile writes by default
+#define LOW_STOCK_THRESHOLD 10 // Default reorder threshold; --reorder-threshold=N overrides it for every category
+#define ALERT_QUEUE_SIZE 256 // Threshold crossings kept between two displays; later ones are only counted
+#define VALUE_SCALE 10000 // Fixed-point units per currency unit in the running aggregates
 #define MAX_ITEMS 10000000
+#define INDEX_EMPTY -1
+#define MIN_INDEX_CAPACITY 1024
+#define TOMBSTONE_ID INT_MIN // ID stored in a deleted slot until the next compaction
+#define DELETE_MODE_TOMBSTONE 0
+#define DELETE_MODE_SWAP 1
+#define AUTO_COMPACT_PERCENT 50 // Compact automatically once this share of slots are tombstones
+#define SORT_BY_PRICE 0
+#define SORT_BY_QUANTITY 1
+#define SORT_BY_ID 2
+#define SORT_BY_NAME 3
+#define NAME_RUN_LENGTH 32 // Runs insertion-sorted before merging when sorting by name
+#define MAX_CATEGORIES 256 // Category codes must fit in an unsigned char
+#define GRAM_BUCKET_BITS 16 // The name index hashes trigrams into 1 << GRAM_BUCKET_BITS posting lists
+#define GRAM_BUCKETS (1 << GRAM_BUCKET_BITS)
+#define GRAM_ANCHOR 1 // Byte standing for "start of name" in the two grams that make prefix lookups indexable
+#define GRAM_PROBE_COST 4 // Rough cost of checking one index candidate, in sequentially scanned rows
+#define SNAPSHOT_MAGIC "WHSNAP\0" // First 8 bytes of every snapshot file
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_CHECKSUM_SEED 0x5748534E41503031ULL
+#define SNAPSHOT_BLOCK_ROWS 65536 // Rows staged per write when saving a snapshot
+#define SNAPSHOT_FIELD_ID 0
+#define SNAPSHOT_FIELD_QUANTITY 1
+#define SNAPSHOT_FIELD_PRICE 2
+#define SNAPSHOT_FIELD_CATEGORY 3
+#define SNAPSHOT_FIELD_NAME_LENGTH 4
+#define SNAPSHOT_FIELDS 5
+#define EXPORT_CSV 0 // Export formats
+#define EXPORT_BINARY 1
+#define EXPORT_BLOCK_WORDS 256 // Selection bitmap words (64 rows each) formatted into one buffer and written at once
+#define EXPORT_ROW_BYTES 384 // Room for one formatted row in either format
+#define EXPORT_MAGIC "WHCOLS\0" // First 8 bytes of a binary export
+#define EXPORT_VERSION 2
+#define LOAD_SAMPLE_BYTES 65536 // Head of each file whose lines are counted to estimate its row count
+#define NAME_MAX_LENGTH 255 // Longest item name kept; the WAL stores a name's length in one byte
+#define NAME_ARENA_MIN_BYTES 65536 // First allocation of the name arena
+#define NAME_GARBAGE_PERCENT 50 // Compact the name arena once this share of its bytes belong to no row
+#define OP_NONE -1 // Operations timed by the metrics layer, one latency histogram each
+#define OP_ADD 0
+#define OP_DELETE 1
+#define OP_RETRIEVE 2
+#define OP_UPDATE 3
+#define OP_BULK_UPDATE 4
+#define OP_SEARCH 5
+#define OP_SORT 6
+#define OP_STOCK_ALERT 7
+#define OP_PRINT 8
+#define OP_EXPORT 9
+#define OP_CATEGORY_VIEW 10
+#define OP_TOTAL 11
+#define OP_COMPACT 12
+#define OP_SNAPSHOT 13
+#define OP_FILTERED_UPDATE 14
+#define OP_SET_THRESHOLD 15
+#define OP_TOP_K 16
+#define OP_COUNT 17
+#define LATENCY_SUB_BUCKETS 16 // Histogram buckets per power of two, so a bucket is never wider than 1/16 of its values
+#define LATENCY_SUB_BITS 4     // log2(LATENCY_SUB_BUCKETS)
+#define LATENCY_BUCKETS 592    // Covers latencies up to 2^40 ns (about 18 minutes); slower ones land in the last bucket
+#define STATS_INTERVAL 10      // Default seconds between two dumps to --stats-file
+#define RESULT_OK 0
+#define RESULT_NOT_FOUND 1
+#define RESULT_EXISTS 2
+#define RESULT_RESERVED_ID 3
+#define RESULT_TOO_MANY_CATEGORIES 4
+#define RESULT_INVALID_COMMAND 5
+#define RESULT_WRITE_FAILED 6
+#define ROUTE_REPLY_TAG 1 // MPI tag of a point command's reply from its owning rank
+#define BATCH_GROUP_LINES 1024 // Batch commands read (and under MPI broadcast) together; the WAL is committed once per group
+#define BATCH_INVALID 0
+#define BATCH_ADD 1
+#define BATCH_DELETE 2
+#define BATCH_UPDATE 3
+#define BATCH_GET 4
+#define BATCH_SEARCH 5
+#define BATCH_TOTAL 6 // Commands from here on work on the whole table rather than one ID
+#define BATCH_SORT 7
+#define BATCH_BULK 8
+#define BATCH_EXPORT 9
+#define BATCH_TIME 10
+#define BATCH_STATS 11
+#define BULK_CHUNK_ROWS 65536 // Rows a bulk update applies between progress checks
+#define BULK_PROGRESS_ROWS 1000000 // A progress line is printed each time this many more rows are done
+#define BULK_KEEP 0 // Filtered bulk update actions
+#define BULK_ADD 1
+#define BULK_SET 2
+#define BULK_SCALE 3 // Prices only
+#define BULK_PLAN_SCAN 0 // How a filtered bulk update finds its candidate rows
+#define BULK_PLAN_CATEGORY 1
+#define BULK_PLAN_ID 2
+#define BULK_PROBE_COST 4 // Rough cost of one id index probe, in sequentially scanned rows
+#define SCAN_SCALAR 0 // Range scan kernel levels
+#define SCAN_SSE2 1
+#define SCAN_AVX2 2
+#define WAL_BUFFER_BYTES 65536 // Records are gathered here and written with one write() per commit
+#define WAL_SYNC_EVERY 16 // Default commits per fdatasync(); --wal-sync=N overrides, 0 leaves syncing to the OS
+#define WAL_RECORD_ADD 1
+#define WAL_RECORD_DELETE 2
+#define WAL_RECORD_UPDATE 3
+#define WAL_RECORD_BULK 4
+#define WAL_RECORD_FILTERED 5
+#define WAL_FIELD_NAME 1 // Update record flags: which fields the update changes
+#define WAL_FIELD_CATEGORY 2
+#define WAL_FIELD_QUANTITY 4
+#define WAL_FIELD_PRICE 8
 
+// Build with -DCOLUMNAR_STORE to keep id, quantity, price and category in separate contiguous columns
+// instead of inside each Item; scans over numeric fields then stream only the columns they read.
 typedef struct {
+#ifndef COLUMNAR_STORE
     int id;
-    char name[50];
-    char category[50];  
+#endif
+    uint32_t nameOffset; // Start of the item's NUL-terminated name in nameArena
+#ifndef COLUMNAR_STORE
+    unsigned char category; // Code into categoryNames[]
     int quantity;
     float price;
+#endif
 } Item;
 
+#ifdef COLUMNAR_STORE
+// Numeric fields stored column-wise; row i of every column belongs with the name in items[i]
+typedef struct {
+    int *id;
+    int *quantity;
+    float *price;
+    unsigned char *category;
+} ItemColumns;
+
+#define ITEM_ID(i) (columns.id[i])
+#define ITEM_QUANTITY(i) (columns.quantity[i])
+#define ITEM_PRICE(i) (columns.price[i])
+#define ITEM_CATEGORY(i) (columns.category[i])
+#define COLUMN_STRIDE sizeof(int) // Bytes from one row's id, quantity or price to the next row's
+#else
+#define ITEM_ID(i) (items[i].id)
+#define ITEM_QUANTITY(i) (items[i].quantity)
+#define ITEM_PRICE(i) (items[i].price)
+#define ITEM_CATEGORY(i) (items[i].category)
+#define COLUMN_STRIDE sizeof(Item)
+#endif
+#define ITEM_NAME(i) (nameArena + items[i].nameOffset)
+#define ITEM_CATEGORY_NAME(i) (categoryNames[ITEM_CATEGORY(i)])
+#ifdef COLUMNAR_STORE
+#define ITEM_BYTES (sizeof(Item) + 3 * sizeof(int) + 1) // Bytes one row occupies across items[] and the columns
+#else
+#define ITEM_BYTES sizeof(Item)
+#endif
+
+// One slot of the open-addressing index that maps an item ID to its row in items[]
+typedef struct {
+    int id;
+    int row; // INDEX_EMPTY marks a free slot
+} IndexSlot;
+
+// A data file mapped into memory by mapFile()
+typedef struct {
+    char *data;
+    size_t size;
+} MappedFile;
+
+// Fixed header at the start of a snapshot file. It is followed by 8-byte aligned sections: category names,
+// category row counts, then the id, quantity, price, category and name length columns, the names, the category
+// bitmaps and the ID index.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t itemCount;
+    uint32_t categoryCount;
+    uint32_t indexCapacity;
+    uint32_t shard;       // Rank that wrote the file, holding the ids ownerRank() maps to it (always 0 outside MPI)
+    uint32_t shardCount;
+    uint64_t walSequence; // LSN of the last WAL record included; replay starts after it
+    uint64_t nameBytes;   // Size of the name section
+    uint64_t checksum;    // Of every byte after the header
+} SnapshotHeader;
+
+// Fixed header at the start of a binary export. It is followed by the category names, then blocks of at most
+// blockRows rows, each [uint32 row count][ids][quantities][prices][category codes][name lengths][names].
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowCount;
+    uint32_t categoryCount;
+    uint32_t blockRows;
+} ExportHeader;
+
+// Growable buffer for output that is produced before it is printed
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+// Predicate of a filtered bulk update; all bounds are inclusive
+typedef struct {
+    char category[50]; // Empty matches every category
+    int minId, maxId;
+    int minQuantity, maxQuantity;
+    float minPrice, maxPrice;
+} BulkFilter;
+
+// Action of a filtered bulk update: a BULK_* mode and its operand for each field
+typedef struct {
+    int quantityMode;
+    int quantity;
+    int priceMode;
+    float price;
+} BulkAction;
+
+// One parsed line of a batch command stream (see parseBatchCommand for the syntax)
+typedef struct {
+    int line;
+    int op;             // BATCH_* code
+    int id;
+    int quantity;       // Negative keeps the current value in an update
+    float price;        // Negative keeps the current value in an update
+    char name[NAME_MAX_LENGTH + 1]; // Empty keeps the current value in an update; the keyword of a search
+    char category[50];
+    int result;         // RESULT_* code once the command has run
+    int matches;        // Rows returned by a get or search
+    TextBuffer output;  // Those rows, one CSV line each
+    int mode;           // Sort column or export format
+    int descending;     // Sort order
+    BulkFilter filter;  // Filter and action of a bulk update
+    BulkAction action;
+} BatchCommand;
+
+// One entry of a sort permutation: an order-preserving 32-bit key and the row it was taken from
+typedef struct {
+    unsigned int key;
+    int row;
+} SortEntry;
+
+// Latency histogram and work counters of one operation. Buckets are log-linear as in an HDR histogram:
+// one per nanosecond below LATENCY_SUB_BUCKETS, then LATENCY_SUB_BUCKETS equal buckets per power of two.
+typedef struct {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t rows;  // Rows scanned
+    uint64_t bytes; // Bytes of row storage touched
+    uint64_t buckets[LATENCY_BUCKETS];
+} OpMetrics;
+
+// An operation being timed: when it started and the work counters at that moment
+typedef struct {
+    int op; // OP_* code, or OP_NONE when nothing is timed
+    uint64_t startNs;
+    uint64_t rows;
+    uint64_t bytes;
+} OpTimer;
+
+// Posting list of the name index: IDs of the items whose name contains one of the bucket's trigrams
+typedef struct {
+    int *ids;
+    int count;
+    int capacity;
+} GramList;
+
+// An item as it travels between ranks in a distributed sort or top-k: its sort key and the fields printed
+typedef struct {
+    unsigned int key; // rowSortKey(), inverted for descending orders; unused when sorting by name
+    int id;
+    int quantity;
+    float price;
+    char name[NAME_MAX_LENGTH + 1];
+    char category[50];
+} ItemRecord;
+
+// One rank's aggregates for one category. Ranks number their categories independently, so totals are merged by name.
+typedef struct {
+    char name[50];
+    int count;
+    int threshold;
+    long long value;
+} CategoryTotal;
+
+// A threshold crossing queued by a write: the item as it was right after the change
+typedef struct {
+    int id;
+    char name[NAME_MAX_LENGTH + 1];
+    int quantity;
+    int threshold;
+    int low; // 1 when the item dropped below its threshold, 0 when it was restocked
+} StockAlert;
+
 Item *items = NULL;
 int itemCount = 0;
 int itemCapacity = INITIAL_SIZE;
+#ifdef COLUMNAR_STORE
+ItemColumns columns;
+#endif
+
+// Name arena: the items' names, NUL-terminated and back to back. A row refers to its name by offset; renamed and
+// deleted items leave their old bytes behind as garbage until compactNames() rewrites the arena in row order.
+char *nameArena = NULL;
+size_t nameArenaLength = 0;
+size_t nameArenaCapacity = 0;
+size_t nameArenaGarbage = 0;
+
+IndexSlot *idIndex = NULL;
+int idIndexCapacity = 0; // Always a power of two
+int idIndexShift = 32;   // 32 - log2(idIndexCapacity), used by hashId()
+int idIndexCount = 0;
+
+int deleteMode = DELETE_MODE_TOMBSTONE;
+int tombstoneCount = 0; // Deleted slots still occupying items[]
+const char *snapshotFile = NULL; // Set by --snapshot=FILE to start from a snapshot instead of the CSV files
+const char *batchFile = NULL;    // Set by --batch=FILE (or - for stdin) to run a command stream instead of the menu
+int dataFileCount = DATA_FILES;  // Set by --files=N to load the files of a writedatatofile --files=N run
+double batchMark = 0;            // When the last batch "time" command ran; the program start before the first one
+int scanKernel = SCAN_AVX2;      // Highest range scan kernel to use, lowered by --scan-kernel=scalar|sse2
+int scanCpuLevel = -1;           // Highest kernel the CPU supports, detected on first use
+int listColumn = -1;             // SORT_BY_* order of the last sort; printItems lists all ranks merged in it (-1: rank by rank)
+int listDescending = 0;
+ItemRecord *sortedSlice = NULL;  // This rank's slice of the global order the last sort built; any write drops it
+int sortedSliceCount = 0;
+
+// Write-ahead log (--wal=FILE). Mutations append binary records to walBuffer; walCommit() writes them out
+// with a single write() after each command and calls fdatasync() every walSyncEvery commits.
+// Each record is [body length][checksum][LSN][type][payload].
+const char *walFile = NULL;
+int walFd = -1;
+int walSyncEvery = WAL_SYNC_EVERY;
+unsigned char walBuffer[WAL_BUFFER_BYTES];
+size_t walBuffered = 0;
+int walUnsynced = 0;      // Commits written since the last fdatasync()
+uint64_t walSequence = 0; // LSN of the last record applied to the table
+
+// Category dictionary. Rows store a small code; categoryRows[c] has bit r set for every live row r in category c,
+// so listing, counting or summing a category touches only its own rows.
+char categoryNames[MAX_CATEGORIES][50];
+int categoryCount = 0;
+uint64_t *categoryRows[MAX_CATEGORIES];
+int categoryItemCount[MAX_CATEGORIES];
+
+// Running aggregates over the live rows, kept current by every change so that dashboard queries need no scan.
+// Values are fixed-point (VALUE_SCALE units per currency unit): removing a row subtracts exactly what adding it
+// added, so the totals never drift however many updates they absorb. Category counts are categoryItemCount[].
+long long totalValueUnits = 0;
+long long categoryValueUnits[MAX_CATEGORIES];
+int lowStockCount = 0;
+int verifyAggregates = 0; // Set by --verify-aggregates to cross-check every dashboard query against a full rescan
+
+// Reorder thresholds. A live row is low on stock while its quantity is below its category's threshold, and
+// lowStockRows has bit r set for every such row r of this rank's shard. Each write compares that bit with the
+// row's new state and queues a StockAlert when it flips; the queues of all ranks are shown after every command.
+// Thresholds are set on every rank by category name, so a category keeps its threshold whichever rank holds an item.
+int categoryThreshold[MAX_CATEGORIES];
+int defaultThreshold = LOW_STOCK_THRESHOLD;
+uint64_t *lowStockRows = NULL;
+StockAlert alertQueue[ALERT_QUEUE_SIZE];
+int alertCount = 0; // Crossings since the queue was last shown; the first ALERT_QUEUE_SIZE are in alertQueue
+
+// Trigram index of item names. Lists hold IDs rather than rows, so moving rows (sorting, compaction, swap
+// deletes) never touches it. Removing a name only counts its entries as stale: lookups re-check every
+// candidate against the row, and the index is rebuilt once stale entries outnumber live ones.
+GramList gramLists[GRAM_BUCKETS];
+long long gramEntries = 0;
+long long gramStale = 0;
+
+// Operation metrics. startOp() and finishOp() around every menu and batch operation record this rank's part of
+// it in opMetrics[op]; the scans add the rows and bytes they touch to workRows and workBytes with noteWork(),
+// and finishOp() charges the operation with the difference. gatherMetrics() sums the ranks on rank 0.
+OpMetrics opMetrics[OP_COUNT];
+uint64_t workRows = 0;
+uint64_t workBytes = 0;
+const char *opNames[OP_COUNT] = {"add", "delete", "retrieve", "update", "bulk_update", "search", "sort", "stock_alert",
+                                 "print", "export", "category_view", "total", "compact", "snapshot", "filtered_update",
+                                 "set_threshold", "top_k"};
+const char *statsFile = NULL; // Set by --stats-file=FILE to append the metrics there every statsInterval seconds
+int statsInterval = STATS_INTERVAL;
+FILE *statsOutput = NULL;
+double statsStart = 0;        // Program start; dump lines carry the seconds since
+double lastStatsDump = 0;
 
 // Function prototypes
 void loadDataFromFiles(int rank, int size);
-void loadData(const char *filename);
-void addItem(int id, const char *name, const char *category, int quantity, float price);
-void deleteItem(int id);
-void retrieveItem(int id);
-void updateItem(int id, const char *name, const char *category, int quantity, float price);
-void processBulkUpdates(int increment);
-void searchItems(const char *keyword);
-void sortItemsByPrice();
-void logOperation(const char *operation, const char *details);
-void exportData(const char *filename);
-void stockAlert();
+void loadData(const char *data, size_t length, int rank, int size);
+void addItem(int id, const char *name, const char *category, int quantity, float price, int rank, int size);
+void deleteItem(int id, int rank, int size);
+void retrieveItem(int id, int rank, int size);
+void updateItem(int id, const char *name, const char *category, int quantity, float price, int rank, int size);
+void bulkUpdateRows(int begin, int end, int quantityDelta, float priceDelta);
+void applyBulkUpdate(int quantityDelta, float priceDelta, int reportProgress);
+void processBulkUpdates(int quantityDelta, float priceDelta, int rank);
+int scanKernelLevel();
+void selectIntRangeScalar(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRangeScalar(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+#ifdef SCAN_X86
+void selectIntRangeSse2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRangeSse2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+void selectIntRangeAvx2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRangeAvx2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+#endif
+void selectIntRange(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRange(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+uint64_t *newBitmap(int words);
+void selectIntColumn(const int *first, int lo, int hi, uint64_t *bits);
+void selectFloatColumn(const float *first, float lo, float hi, uint64_t *bits);
+void andBitmaps(uint64_t *bits, const uint64_t *other, int words);
+void selectFilterRows(const BulkFilter *filter, int category, uint64_t *selected);
+void applyBulkAction(const BulkAction *action, int row);
+void initBulkFilter(BulkFilter *filter);
+int filteredUpdateRow(const BulkFilter *filter, int category, const BulkAction *action, int row);
+int applyFilteredUpdate(const BulkFilter *filter, const BulkAction *action, int *plan, int rank, int size);
+void promptBulkFilter(BulkFilter *filter);
+void promptFilteredUpdate(BulkFilter *filter, BulkAction *action);
+void processFilteredUpdate(const BulkFilter *filter, const BulkAction *action, int rank, int size);
+int nameGrams(const char *name, int anchored, unsigned int *buckets);
+void indexName(int id, const char *name);
+void unindexName(const char *name);
+void buildNameIndex();
+void tidyNameIndex();
+void freeNameIndex();
+int nameMatches(const char *name, const char *keyword, int prefix);
+int compareRows(const void *a, const void *b);
+int findNameRows(const char *pattern, int **rows);
+void searchItems(const char *keyword, int rank, int size);
+void sortItems(int column, int descending);
+void fillRecord(ItemRecord *record, int row, int column, int descending);
+int recordBefore(const ItemRecord *x, const ItemRecord *y, int byName, int descending);
+void mergeRecordRuns(const ItemRecord *records, const int *counts, const int *offsets, int runs,
+                     ItemRecord *out, int byName, int descending);
+MPI_Datatype recordDatatype();
+ItemRecord *sampleSortRecords(int column, int descending, int rank, int size, int *count);
+void sortAllShards(int column, int descending, int rank, int size);
+void dropSortedSlice();
+void siftTopEntry(SortEntry *heap, int n, int i);
+int selectTopRows(int column, int descending, int k, SortEntry *heap);
+void topItems(int column, int descending, int k, int rank, int size);
+int formatInt(char *out, long long value);
+int formatPrice(char *out, float price);
+size_t formatExportBlock(int format, const uint64_t *selected, int firstWord, int endWord, char *buffer);
+int writeAll(int fd, const void *data, size_t size);
+int openExportFile(const char *filename, pid_t *compressor);
+int closeExportFile(int fd, pid_t compressor);
+int writeExportHeader(int fd, long long rows);
+long long exportRows(const char *filename, int format, const uint64_t *selected, int words);
+int exportShardName(const char *filename, int rank, char *shardName, size_t size);
+long long exportData(const char *filename, int format, const BulkFilter *filter, int rank);
+void stockAlert(int rank, int size);
 void displayMenu();
-void printItems();
-void viewItemsByCategory();
-void calculateTotalValue();
+void printItems(int rank, int size);
+long long rowValueUnits(int row);
+void aggregateRow(int row, int sign);
+void aggregateRows(int begin, int end, int sign);
+void sumAggregates(long long *total, long long *categoryValues, int *lowStock);
+void readAggregates(long long *total, long long *categoryValues, int *lowStock);
+void rebuildAggregates();
+int isLowStock(int row);
+void queueStockAlert(int row, int low);
+void trackStock(int row);
+void trackStockRows(int begin, int end);
+int untrackStock(int row);
+void rebuildLowStockRows();
+void setCategoryThreshold(int code, int threshold);
+void printStockAlerts(FILE *out, int rank, int size);
+void discardStockAlerts();
+int checkAggregates();
+void viewItemsByCategory(const char *category, int rank, int size);
+void calculateTotalValue(int rank, int size);
+void buildIndex();
+int findItemRow(int id);
+int indexInsert(int id, int row);
+void indexRemove(int id);
+void indexSetRow(int id, int row);
+void compactItems();
+void reserveRows(int capacity);
+void appendRow(int id, const char *name, size_t nameLength, int category, int quantity, float price);
+void reserveNames(size_t extra);
+uint32_t storeName(const char *name, size_t length);
+void renameRow(int row, const char *name);
+void releaseName(int row, int tombstone);
+void compactNames();
+void tidyNames();
+int findCategory(const char *name);
+int internCategory(const char *name);
+void categoryAddRow(int row);
+void categoryRemoveRow(int row);
+void rebuildCategoryBitmaps();
+void moveRow(int dst, int src);
+void freeRows();
+void parseOptions(int argc, char *argv[]);
+void reportResult(int result, int id, const char *success);
+void printGathered(const TextBuffer *text, int rank, int size);
+uint64_t monotonicNs();
+void noteWork(long long rows, long long bytes);
+OpTimer startOp(int op);
+void finishOp(const OpTimer *timer);
+int latencyBucket(uint64_t ns);
+uint64_t bucketHighest(int bucket);
+uint64_t latencyPercentile(const OpMetrics *metrics, int permille);
+void mergeMetrics(OpMetrics *merged);
+int formatStats(const OpMetrics *merged, const char *prefix, TextBuffer *out);
+void gatherMetrics(OpMetrics *merged, int rank);
+void showStats(int rank, int size);
+void openStatsFile(int rank);
+void dumpStats(int force);
+void closeStatsFile();
+void writeGathered(const TextBuffer *text, FILE *out, int rank, int size);
+int ownerRank(int id, int size);
+void routeReply(int owner, int rank, int *result, TextBuffer *text);
+int applyAddItem(int id, const char *name, const char *category, int quantity, float price);
+int applyDeleteItem(int id);
+int applyUpdateItem(int id, const char *name, const char *category, int quantity, float price);
+uint32_t walChecksum(const unsigned char *data, size_t size);
+void walFlush();
+void walAppend(int type, const unsigned char *payload, size_t size);
+void walLogItem(int type, int id, const char *name, const char *category, int quantity, float price);
+void walLogDelete(int id);
+void walLogBulk(int quantityDelta, float priceDelta);
+void walLogFiltered(const BulkFilter *filter, const BulkAction *action);
+void walCommit();
+void walClose();
+void walReplay(int type, const unsigned char *payload, size_t bytes, int rank, int size);
+void walOpen(const char *filename, int rank, int size);
+void textReserve(TextBuffer *buffer, size_t extra);
+void textAppend(TextBuffer *buffer, const char *format, ...);
+void textAppendBytes(TextBuffer *buffer, const void *data, size_t size);
+void appendItemText(TextBuffer *buffer, int row);
+const char *copyBatchField(const char *p, const char *end, char *out, size_t size);
+int parseBatchCommand(const char *line, int lineNumber, BatchCommand *command);
+int parseBatchBulk(const char *p, const char *end, BulkFilter *filter, BulkAction *action);
+void runBatchCommand(BatchCommand *command, int rank, int size);
+void printBatchResult(const BatchCommand *command);
+void runBatchGroup(BatchCommand *commands, int count, int rank, int size);
+void runBatch(const char *filename, int rank, int size);
+uint64_t snapshotChecksum(uint64_t checksum, const void *data, size_t size);
+size_t snapshotPadded(size_t size);
+int snapshotNamesValid(const unsigned char *lengths, const char *names, size_t n, uint64_t nameBytes);
+void writeSnapshotSection(FILE *file, const void *data, size_t size, uint64_t *checksum);
+size_t gatherSnapshotBlock(int field, int start, int count, char *buffer);
+size_t scatterSnapshotBlock(int field, int start, int count, const char *data);
+void saveSnapshot(const char *filename, int rank, int size);
+int openSnapshot(const char *filename, MappedFile *snapshot, int rank, int size);
+void restoreSnapshot(MappedFile *snapshot);
+void mapFile(const char *filename, MappedFile *file);
+void unmapFile(MappedFile *file);
+size_t countLines(const char *begin, const char *end);
+const char *skipHeader(const char *begin, const char *end);
+int parseIntField(const char **p, const char *end, int *value);
+int parsePriceField(const char **p, const char *end, float *value);
+int parseRow(const char *line, const char *end, int *id, const char **name, int *nameLength,
+             const char **category, int *categoryLength, int *quantity, float *price);
+int categoryCode(const char *name, int length);
+
+// Function to resize the row storage (items[] plus, in columnar builds, every column) to hold capacity rows
+void reserveRows(int capacity) {
+    items = realloc(items, sizeof(Item) * capacity);
+#ifdef COLUMNAR_STORE
+    columns.id = realloc(columns.id, sizeof(int) * capacity);
+    columns.quantity = realloc(columns.quantity, sizeof(int) * capacity);
+    columns.price = realloc(columns.price, sizeof(float) * capacity);
+    columns.category = realloc(columns.category, sizeof(unsigned char) * capacity);
+    if (!columns.id || !columns.quantity || !columns.price || !columns.category) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (!items) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    int oldWords = (itemCapacity + 63) / 64;
+    int newWords = (capacity + 63) / 64;
+    for (int c = 0; c < categoryCount; c++) {
+        categoryRows[c] = realloc(categoryRows[c], sizeof(uint64_t) * newWords);
+        if (!categoryRows[c]) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        if (newWords > oldWords) {
+            memset(categoryRows[c] + oldWords, 0, sizeof(uint64_t) * (newWords - oldWords));
+        }
+    }
+    int oldLowWords = lowStockRows ? oldWords : 0; // The first call allocates it from scratch
+    lowStockRows = realloc(lowStockRows, sizeof(uint64_t) * newWords);
+    if (!lowStockRows) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    if (newWords > oldLowWords) {
+        memset(lowStockRows + oldLowWords, 0, sizeof(uint64_t) * (newWords - oldLowWords));
+    }
+    itemCapacity = capacity;
+}
+
+// Function to return the range scan kernel to use: the one asked for, or the best the CPU has if that is lower
+int scanKernelLevel() {
+    if (scanCpuLevel < 0) {
+        scanCpuLevel = SCAN_SCALAR;
+#ifdef SCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            scanCpuLevel = SCAN_AVX2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            scanCpuLevel = SCAN_SSE2;
+        }
+#endif
+    }
+    return scanKernel < scanCpuLevel ? scanKernel : scanCpuLevel;
+}
+
+// Range scan kernels. Each one reads count 32-bit values, the first at values and each next one stride bytes
+// further on (4 for a column, sizeof(Item) for a field of the row structs), and sets bit r of bits for every
+// value r in [lo, hi]. Whole 64-bit words are written, so the bits past count in the last word are cleared.
+
+// Function to scan an int field for the range [lo, hi] one value at a time; also finishes the vector kernels' tails
+void selectIntRangeScalar(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    for (int w = 0; w * 64 < count; w++) {
+        int n = count - w * 64 < 64 ? count - w * 64 : 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) {
+            int v = *(const int *)(values + ((size_t)w * 64 + b) * stride);
+            word |= (uint64_t)(v >= lo && v <= hi) << b;
+        }
+        bits[w] = word;
+    }
+}
+
+// Function to scan a float field for the range [lo, hi] one value at a time
+void selectFloatRangeScalar(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    for (int w = 0; w * 64 < count; w++) {
+        int n = count - w * 64 < 64 ? count - w * 64 : 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) {
+            float v = *(const float *)(values + ((size_t)w * 64 + b) * stride);
+            word |= (uint64_t)(v >= lo && v <= hi) << b;
+        }
+        bits[w] = word;
+    }
+}
+
+#ifdef SCAN_X86
+// Function to scan an int field four values at a time. Strided fields are assembled lane by lane.
+__attribute__((target("sse2")))
+void selectIntRangeSse2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    __m128i low = _mm_set1_epi32(lo), high = _mm_set1_epi32(hi);
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 16; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 4) * stride;
+            __m128i v = contiguous ? _mm_loadu_si128((const __m128i *)p)
+                : _mm_setr_epi32(*(const int *)p, *(const int *)(p + stride), *(const int *)(p + 2 * stride), *(const int *)(p + 3 * stride));
+            __m128i outside = _mm_or_si128(_mm_cmplt_epi32(v, low), _mm_cmpgt_epi32(v, high));
+            word |= (uint64_t)(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF) << (g * 4);
+        }
+        bits[w] = word;
+    }
+    selectIntRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+
+// Function to scan a float field four values at a time
+__attribute__((target("sse2")))
+void selectFloatRangeSse2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    __m128 low = _mm_set1_ps(lo), high = _mm_set1_ps(hi);
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 16; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 4) * stride;
+            __m128 v = contiguous ? _mm_loadu_ps((const float *)p)
+                : _mm_setr_ps(*(const float *)p, *(const float *)(p + stride), *(const float *)(p + 2 * stride), *(const float *)(p + 3 * stride));
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(v, low), _mm_cmple_ps(v, high));
+            word |= (uint64_t)_mm_movemask_ps(inside) << (g * 4);
+        }
+        bits[w] = word;
+    }
+    selectFloatRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+
+// Function to scan an int field eight values at a time. Strided fields are read with one gather per eight rows.
+__attribute__((target("avx2")))
+void selectIntRangeAvx2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    __m256i low = _mm256_set1_epi32(lo), high = _mm256_set1_epi32(hi);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 8; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 8) * stride;
+            __m256i v = contiguous ? _mm256_loadu_si256((const __m256i *)p) : _mm256_i32gather_epi32((const int *)p, offsets, 1);
+            __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, v), _mm256_cmpgt_epi32(v, high));
+            word |= (uint64_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF) << (g * 8);
+        }
+        bits[w] = word;
+    }
+    selectIntRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+
+// Function to scan a float field eight values at a time
+__attribute__((target("avx2")))
+void selectFloatRangeAvx2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    __m256 low = _mm256_set1_ps(lo), high = _mm256_set1_ps(hi);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 8; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 8) * stride;
+            __m256 v = contiguous ? _mm256_loadu_ps((const float *)p) : _mm256_i32gather_ps((const float *)p, offsets, 1);
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(v, low, _CMP_GE_OQ), _mm256_cmp_ps(v, high, _CMP_LE_OQ));
+            word |= (uint64_t)_mm256_movemask_ps(inside) << (g * 8);
+        }
+        bits[w] = word;
+    }
+    selectFloatRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+#endif
+
+// Function to run the int range kernel picked by scanKernelLevel()
+void selectIntRange(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    switch (scanKernelLevel()) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            selectIntRangeAvx2(values, stride, count, lo, hi, bits);
+            break;
+        case SCAN_SSE2:
+            selectIntRangeSse2(values, stride, count, lo, hi, bits);
+            break;
+#endif
+        default:
+            selectIntRangeScalar(values, stride, count, lo, hi, bits);
+    }
+}
+
+// Function to run the float range kernel picked by scanKernelLevel()
+void selectFloatRange(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    switch (scanKernelLevel()) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            selectFloatRangeAvx2(values, stride, count, lo, hi, bits);
+            break;
+        case SCAN_SSE2:
+            selectFloatRangeSse2(values, stride, count, lo, hi, bits);
+            break;
+#endif
+        default:
+            selectFloatRangeScalar(values, stride, count, lo, hi, bits);
+    }
+}
+
+// Function to allocate a row bitmap of the given number of 64-bit words
+uint64_t *newBitmap(int words) {
+    uint64_t *bits = malloc(sizeof(uint64_t) * (words ? words : 1));
+    if (!bits) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    return bits;
+}
+
+// Function to select the rows whose int field (passed as &ITEM_xxx(0)) lies in [lo, hi]
+void selectIntColumn(const int *first, int lo, int hi, uint64_t *bits) {
+    selectIntRange((const char *)first, COLUMN_STRIDE, itemCount, lo, hi, bits);
+}
+
+// Function to select the rows whose float field lies in [lo, hi]
+void selectFloatColumn(const float *first, float lo, float hi, uint64_t *bits) {
+    selectFloatRange((const char *)first, COLUMN_STRIDE, itemCount, lo, hi, bits);
+}
+
+// Function to intersect one row bitmap with another
+void andBitmaps(uint64_t *bits, const uint64_t *other, int words) {
+    for (int w = 0; w < words; w++) {
+        bits[w] &= other[w];
+    }
+}
+
+// Function to select the live rows matching a filter. One kernel pass per bounded field; the ID pass always
+// runs because it also drops tombstones. category is the filter's category resolved to a code, or -1 for any.
+void selectFilterRows(const BulkFilter *filter, int category, uint64_t *selected) {
+    int words = (itemCount + 63) / 64;
+    selectIntColumn(&ITEM_ID(0), filter->minId > TOMBSTONE_ID ? filter->minId : TOMBSTONE_ID + 1, filter->maxId, selected);
+
+    uint64_t *scratch = newBitmap(words);
+    int passes = 1;
+    if (filter->minQuantity != INT_MIN || filter->maxQuantity != INT_MAX) {
+        selectIntColumn(&ITEM_QUANTITY(0), filter->minQuantity, filter->maxQuantity, scratch);
+        andBitmaps(selected, scratch, words);
+        passes++;
+    }
+    if (filter->minPrice != -FLT_MAX || filter->maxPrice != FLT_MAX) {
+        selectFloatColumn(&ITEM_PRICE(0), filter->minPrice, filter->maxPrice, scratch);
+        andBitmaps(selected, scratch, words);
+        passes++;
+    }
+    noteWork(itemCount, (long long)itemCount * COLUMN_STRIDE * passes);
+    if (category >= 0) {
+        andBitmaps(selected, categoryRows[category], words);
+    }
+    free(scratch);
+}
+
+// Function to reset a filter so that it matches every item
+void initBulkFilter(BulkFilter *filter) {
+    filter->category[0] = '\0';
+    filter->minId = INT_MIN + 1; // INT_MIN is TOMBSTONE_ID
+    filter->maxId = INT_MAX;
+    filter->minQuantity = INT_MIN;
+    filter->maxQuantity = INT_MAX;
+    filter->minPrice = -FLT_MAX;
+    filter->maxPrice = FLT_MAX;
+}
+
+// Function to test one row against a filter and apply the action if it matches; returns 1 on a match.
+// category is the filter's category already resolved to a code, or -1 for any.
+int filteredUpdateRow(const BulkFilter *filter, int category, const BulkAction *action, int row) {
+    int id = ITEM_ID(row);
+    if (id == TOMBSTONE_ID || id < filter->minId || id > filter->maxId ||
+        (category >= 0 && ITEM_CATEGORY(row) != category) ||
+        ITEM_QUANTITY(row) < filter->minQuantity || ITEM_QUANTITY(row) > filter->maxQuantity ||
+        ITEM_PRICE(row) < filter->minPrice || ITEM_PRICE(row) > filter->maxPrice) {
+        return 0;
+    }
+    applyBulkAction(action, row);
+    return 1;
+}
+
+// Function to apply a filtered bulk update's action to one row
+void applyBulkAction(const BulkAction *action, int row) {
+    aggregateRow(row, -1);
+    if (action->quantityMode == BULK_ADD) {
+        ITEM_QUANTITY(row) += action->quantity;
+    } else if (action->quantityMode == BULK_SET) {
+        ITEM_QUANTITY(row) = action->quantity;
+    }
+    if (action->priceMode == BULK_ADD) {
+        ITEM_PRICE(row) += action->price;
+    } else if (action->priceMode == BULK_SET) {
+        ITEM_PRICE(row) = action->price;
+    } else if (action->priceMode == BULK_SCALE) {
+        ITEM_PRICE(row) *= action->price;
+    }
+    aggregateRow(row, 1);
+    trackStock(row);
+}
+
+// Function to apply an action to every item matching a filter in one pass. The candidates come from
+// whichever source is cheapest: the range scan kernels over every row, the category's bitmap, or one
+// index probe per id in the range. Candidates of the last two are checked against the whole filter.
+// Returns the match count.
+int applyFilteredUpdate(const BulkFilter *filter, const BulkAction *action, int *plan, int rank, int size) {
+    int category = -1;
+    if (filter->category[0]) {
+        category = findCategory(filter->category);
+        if (category < 0) {
+            *plan = BULK_PLAN_CATEGORY;
+            return 0;
+        }
+    }
+
+    long long idSpan = filter->maxId >= filter->minId ? (long long)filter->maxId - filter->minId + 1 : 0;
+    long long cost = itemCount;
+    *plan = BULK_PLAN_SCAN;
+    if (category >= 0 && categoryItemCount[category] + itemCount / 64 < cost) {
+        cost = categoryItemCount[category] + itemCount / 64;
+        *plan = BULK_PLAN_CATEGORY;
+    }
+    // Ids other ranks own are skipped before the probe, so this rank probes about idSpan / size of them
+    if (idSpan / size * BULK_PROBE_COST < cost) {
+        *plan = BULK_PLAN_ID;
+    }
+
+    int matched = 0;
+    if (*plan == BULK_PLAN_ID) {
+        for (long long id = filter->minId; id <= filter->maxId; id++) {
+            if (ownerRank((int)id, size) != rank) {
+                continue;
+            }
+            int row = findItemRow((int)id);
+            if (row >= 0) {
+                matched += filteredUpdateRow(filter, category, action, row);
+            }
+        }
+    } else if (*plan == BULK_PLAN_CATEGORY) {
+        int words = (itemCount + 63) / 64;
+        noteWork(categoryItemCount[category], (long long)categoryItemCount[category] * ITEM_BYTES);
+        for (int w = 0; w < words; w++) {
+            for (uint64_t bits = categoryRows[category][w]; bits; bits &= bits - 1) {
+                matched += filteredUpdateRow(filter, category, action, w * 64 + __builtin_ctzll(bits));
+            }
+        }
+    } else {
+        int words = (itemCount + 63) / 64;
+        uint64_t *selected = newBitmap(words);
+        selectFilterRows(filter, category, selected);
+        for (int w = 0; w < words; w++) {
+            for (uint64_t bits = selected[w]; bits; bits &= bits - 1) {
+                applyBulkAction(action, w * 64 + __builtin_ctzll(bits));
+                matched++;
+            }
+        }
+        free(selected);
+    }
+    if (matched) {
+        dropSortedSlice();
+    }
+    return matched;
+}
+
+// Function to read a filter from the user
+void promptBulkFilter(BulkFilter *filter) {
+    int low, high;
+    initBulkFilter(filter);
+    printf("Enter category to match (leave empty for any): ");
+    fgets(filter->category, sizeof(filter->category), stdin);
+    filter->category[strcspn(filter->category, "\n")] = '\0';
+    printf("Enter ID range to match (min max, -1 for no bound): ");
+    scanf("%d %d", &low, &high);
+    if (low >= 0) filter->minId = low;
+    if (high >= 0) filter->maxId = high;
+    printf("Enter quantity range to match (min max, -1 for no bound): ");
+    scanf("%d %d", &low, &high);
+    if (low >= 0) filter->minQuantity = low;
+    if (high >= 0) filter->maxQuantity = high;
+    printf("Enter price range to match (min max, -1 for no bound): ");
+    float lowPrice, highPrice;
+    scanf("%f %f", &lowPrice, &highPrice);
+    if (lowPrice >= 0) filter->minPrice = lowPrice;
+    if (highPrice >= 0) filter->maxPrice = highPrice;
+}
+
+// Function to read a filtered bulk update from the user
+void promptFilteredUpdate(BulkFilter *filter, BulkAction *action) {
+    promptBulkFilter(filter);
+    printf("Enter quantity action (0 keep, 1 add, 2 set) and value: ");
+    scanf("%d %d", &action->quantityMode, &action->quantity);
+    printf("Enter price action (0 keep, 1 add, 2 set, 3 scale) and value: ");
+    scanf("%d %f", &action->priceMode, &action->price);
+}
+
+// Function to run a filtered bulk update on every rank's shard; rank 0 reports the total match count
+void processFilteredUpdate(const BulkFilter *filter, const BulkAction *action, int rank, int size) {
+    const char *planNames[] = {"a full scan", "the category bitmap", "the id index"};
+    double start = MPI_Wtime();
+    int plan;
+    int matched = applyFilteredUpdate(filter, action, &plan, rank, size), totalMatched = 0;
+    double elapsed = MPI_Wtime() - start, slowest = 0;
+
+    walLogFiltered(filter, action); // Every rank logs its own shard
+
+    MPI_Reduce(&matched, &totalMatched, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        printf("\nFiltered bulk update completed: %d items matched (rank 0 used %s).\n", totalMatched, planNames[plan]);
+        printf("Total processing time: %.3f seconds\n", slowest);
+    }
+}
+
+// Function to append a row at items[itemCount], doubling the storage when it is full. The ID index is not touched.
+void appendRow(int id, const char *name, size_t nameLength, int category, int quantity, float price) {
+    if (itemCount >= itemCapacity) {
+        reserveRows(itemCapacity * 2);
+    }
+
+    ITEM_ID(itemCount) = id;
+    items[itemCount].nameOffset = storeName(name, nameLength);
+    ITEM_CATEGORY(itemCount) = (unsigned char)category;
+    ITEM_QUANTITY(itemCount) = quantity;
+    ITEM_PRICE(itemCount) = price;
+    categoryAddRow(itemCount);
+    itemCount++;
+}
+
+// Function to move row src into slot dst. Slot dst must not hold a live row (its category bit must already be clear).
+void moveRow(int dst, int src) {
+    categoryRemoveRow(src);
+    int low = untrackStock(src);
+    items[dst] = items[src];
+#ifdef COLUMNAR_STORE
+    columns.id[dst] = columns.id[src];
+    columns.quantity[dst] = columns.quantity[src];
+    columns.price[dst] = columns.price[src];
+    columns.category[dst] = columns.category[src];
+#endif
+    categoryAddRow(dst);
+    if (low) {
+        lowStockRows[dst >> 6] |= (uint64_t)1 << (dst & 63);
+    }
+}
+
+// Function to release the row storage
+void freeRows() {
+    free(items);
+#ifdef COLUMNAR_STORE
+    free(columns.id);
+    free(columns.quantity);
+    free(columns.price);
+    free(columns.category);
+#endif
+    for (int c = 0; c < categoryCount; c++) {
+        free(categoryRows[c]);
+    }
+    free(lowStockRows);
+    free(nameArena);
+}
+
+// Function to make room for extra more bytes in the name arena, doubling it as needed
+void reserveNames(size_t extra) {
+    if (nameArenaLength + extra > UINT32_MAX) {
+        fprintf(stderr, "Error: item names exceed the 4 GB name arena.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (nameArenaLength + extra <= nameArenaCapacity) {
+        return;
+    }
+    size_t capacity = nameArenaCapacity ? nameArenaCapacity : NAME_ARENA_MIN_BYTES;
+    while (capacity < nameArenaLength + extra) {
+        capacity *= 2;
+    }
+    nameArena = realloc(nameArena, capacity);
+    if (!nameArena) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    nameArenaCapacity = capacity;
+}
+
+// Function to append a name (clipped to NAME_MAX_LENGTH characters) to the name arena. Returns its offset.
+uint32_t storeName(const char *name, size_t length) {
+    if (length > NAME_MAX_LENGTH) {
+        length = NAME_MAX_LENGTH;
+    }
+    reserveNames(length + 1);
+    uint32_t offset = (uint32_t)nameArenaLength;
+    memcpy(nameArena + offset, name, length);
+    nameArena[offset + length] = '\0';
+    nameArenaLength += length + 1;
+    return offset;
+}
+
+// Function to give a row a new name; the old one becomes garbage
+void renameRow(int row, const char *name) {
+    nameArenaGarbage += strlen(ITEM_NAME(row)) + 1;
+    items[row].nameOffset = storeName(name, strlen(name));
+}
+
+// Function to drop the name of a deleted row. A row left behind as a tombstone keeps the terminator, so its name
+// reads as empty.
+void releaseName(int row, int tombstone) {
+    size_t length = strlen(ITEM_NAME(row));
+    if (tombstone) {
+        items[row].nameOffset += (uint32_t)length;
+        nameArenaGarbage += length;
+    } else {
+        nameArenaGarbage += length + 1;
+    }
+}
+
+// Function to rewrite the name arena with just the names of rows [0, itemCount), in row order, so a scan over
+// the rows reads the names sequentially
+void compactNames() {
+    size_t live = nameArenaLength - nameArenaGarbage;
+    size_t capacity = live + live / 2 > NAME_ARENA_MIN_BYTES ? live + live / 2 : NAME_ARENA_MIN_BYTES;
+    char *arena = malloc(capacity);
+    if (!arena) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t length = 0;
+    for (int i = 0; i < itemCount; i++) {
+        size_t size = strlen(ITEM_NAME(i)) + 1;
+        memcpy(arena + length, ITEM_NAME(i), size);
+        items[i].nameOffset = (uint32_t)length;
+        length += size;
+    }
+    free(nameArena);
+    nameArena = arena;
+    nameArenaLength = length;
+    nameArenaCapacity = capacity;
+    nameArenaGarbage = 0;
+}
+
+// Function to compact the name arena once garbage makes up NAME_GARBAGE_PERCENT of it
+void tidyNames() {
+    if (nameArenaGarbage * 100 > nameArenaLength * NAME_GARBAGE_PERCENT) {
+        compactNames();
+    }
+}
+
+// Function to look up a category code by name, or -1 if the category has never been seen
+int findCategory(const char *name) {
+    for (int c = 0; c < categoryCount; c++) {
+        if (strcmp(categoryNames[c], name) == 0) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+// Function to return the code of a category, adding it to the dictionary on first use. Returns -1 when the dictionary is full.
+int internCategory(const char *name) {
+    int code = findCategory(name);
+    if (code >= 0 || categoryCount >= MAX_CATEGORIES) {
+        return code;
+    }
+
+    strncpy(categoryNames[categoryCount], name, sizeof(categoryNames[categoryCount]) - 1);
+    categoryNames[categoryCount][sizeof(categoryNames[categoryCount]) - 1] = '\0';
+    categoryRows[categoryCount] = calloc((itemCapacity + 63) / 64, sizeof(uint64_t));
+    if (!categoryRows[categoryCount]) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    categoryItemCount[categoryCount] = 0;
+    categoryThreshold[categoryCount] = defaultThreshold;
+    return categoryCount++;
+}
+
+// Function to mark a live row in its category's bitmap
+void categoryAddRow(int row) {
+    int code = ITEM_CATEGORY(row);
+    categoryRows[code][row >> 6] |= (uint64_t)1 << (row & 63);
+    categoryItemCount[code]++;
+}
+
+// Function to clear a row from its category's bitmap
+void categoryRemoveRow(int row) {
+    int code = ITEM_CATEGORY(row);
+    categoryRows[code][row >> 6] &= ~((uint64_t)1 << (row & 63));
+    categoryItemCount[code]--;
+}
+
+// Function to rebuild every category bitmap from the rows, used after rows have been permuted in bulk
+void rebuildCategoryBitmaps() {
+    // Clear the whole capacity so bits of rows past a shrunk itemCount go too
+    int words = (itemCapacity + 63) / 64;
+    for (int c = 0; c < categoryCount; c++) {
+        memset(categoryRows[c], 0, sizeof(uint64_t) * words);
+        categoryItemCount[c] = 0;
+    }
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID) {
+            categoryAddRow(i);
+        }
+    }
+}
+
+// Function to return the code of a category given as a name and length (not NUL-terminated), adding it on first use
+int categoryCode(const char *name, int length) {
+    for (int c = 0; c < categoryCount; c++) {
+        if (memcmp(categoryNames[c], name, length) == 0 && categoryNames[c][length] == '\0') {
+            return c;
+        }
+    }
+
+    char copy[50];
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    return internCategory(copy);
+}
 
 void loadDataFromFiles(int rank, int size) {
-    char filenames[20][50];
-    for (int i = 0; i < 20; i++) {
-        sprintf(filenames[i], "warehouse_data_%d.csv", i + 1); 
+    MappedFile *files = malloc(sizeof(MappedFile) * dataFileCount);
+    size_t rows = 0;
+    if (!files) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (int i = 0; i < dataFileCount; i++) {
+        char filename[50];
+        sprintf(filename, "warehouse_data_%d.csv", i + 1);
+        mapFile(filename, &files[i]);
+        // Counting every line of every file on every rank costs a full extra pass, so the row count
+        // is extrapolated from the head of the file; appendRow still grows the rows if it falls short
+        size_t sample = files[i].size < LOAD_SAMPLE_BYTES ? files[i].size : LOAD_SAMPLE_BYTES;
+        size_t sampleRows = countLines(files[i].data, files[i].data + sample);
+        if (sampleRows > 0) rows += (size_t)((double)sampleRows * files[i].size / sample);
+    }
+    // Every rank reads every file and keeps the rows it owns; the hash gives each about rows / size
+    size_t expected = rows / size + rows / (size * 16) + 1;
+    if (itemCount + expected > (size_t)itemCapacity) {
+        reserveRows((int)(itemCount + expected));
+    }
+
+    for (int i = 0; i < dataFileCount; i++) {
+        loadData(files[i].data, files[i].size, rank, size);
+        unmapFile(&files[i]);
+    }
+    free(files);
+
+    buildIndex();
+    buildNameIndex();
+    rebuildAggregates();
+}
+
+// Function to map a whole data file into memory read-only. An empty file maps to data == NULL.
+void mapFile(const char *filename, MappedFile *file) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror("Error reading file size");
+        exit(EXIT_FAILURE);
+    }
+    file->size = (size_t)info.st_size;
+    file->data = NULL;
+    if (file->size > 0) {
+        file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (file->data == MAP_FAILED) {
+            perror("Error mapping file");
+            exit(EXIT_FAILURE);
+        }
+        madvise(file->data, file->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+// Function to release a mapping made by mapFile
+void unmapFile(MappedFile *file) {
+    if (file->data) {
+        munmap(file->data, file->size);
+    }
+}
+
+// Function to count the lines in [begin, end), including a final line with no newline. Used as an upper bound on rows.
+size_t countLines(const char *begin, const char *end) {
+    size_t lines = 0;
+    const char *p = begin;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        lines++;
+        p++;
+    }
+    if (end > begin && end[-1] != '\n') {
+        lines++;
+    }
+    return lines;
+}
+
+// Function to return the start of the first data row, skipping a header line that does not begin with a number
+const char *skipHeader(const char *begin, const char *end) {
+    if (begin < end && *begin != '-' && (*begin < '0' || *begin > '9')) {
+        const char *newline = memchr(begin, '\n', end - begin);
+        return newline ? newline + 1 : end;
+    }
+    return begin;
+}
+
+// Function to parse an optionally negative integer at *p, leaving *p just past it. Returns 0 if there is no valid number.
+int parseIntField(const char **p, const char *end, int *value) {
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && *s == '-') {
+        negative = 1;
+        s++;
+    }
+    if (s == end || *s < '0' || *s > '9') {
+        return 0;
+    }
+
+    long long v = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+        if (v > (long long)INT_MAX + 1) {
+            return 0;
+        }
+    }
+    if (negative) v = -v;
+    if (v > INT_MAX) {
+        return 0;
+    }
+    *value = (int)v;
+    *p = s;
+    return 1;
+}
+
+// Function to parse a plain decimal such as 12.34 or -0.5 at *p, leaving *p just past it
+int parsePriceField(const char **p, const char *end, float *value) {
+    static const double scale[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && *s == '-') {
+        negative = 1;
+        s++;
+    }
+
+    long long mantissa = 0;
+    int digits = 0, fraction = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+        if (digits < 18) mantissa = mantissa * 10 + (*s - '0');
+        else fraction--; // Drop digits a float cannot hold but keep the magnitude
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+            if (digits < 18 && fraction < 9) {
+                mantissa = mantissa * 10 + (*s - '0');
+                fraction++;
+            }
+        }
+    }
+    if (digits == 0) {
+        return 0;
+    }
+
+    double v = fraction >= 0 ? mantissa / scale[fraction] : mantissa * scale[-fraction < 9 ? -fraction : 9];
+    *value = (float)(negative ? -v : v);
+    *p = s;
+    return 1;
+}
+
+// Function to parse one "id,name,category,quantity,price" row from [line, end). Text fields are returned as
+// pointers into the line plus a length; names are clipped to NAME_MAX_LENGTH characters and categories to 49.
+int parseRow(const char *line, const char *end, int *id, const char **name, int *nameLength,
+             const char **category, int *categoryLength, int *quantity, float *price) {
+    const char *p = line;
+    if (!parseIntField(&p, end, id) || p == end || *p++ != ',') {
+        return 0;
+    }
+
+    *name = p;
+    while (p < end && *p != ',') p++;
+    *nameLength = p - *name < NAME_MAX_LENGTH ? (int)(p - *name) : NAME_MAX_LENGTH;
+    if (*nameLength == 0 || p == end || *p++ != ',') {
+        return 0;
+    }
+
+    *category = p;
+    while (p < end && *p != ',') p++;
+    *categoryLength = p - *category < 49 ? (int)(p - *category) : 49;
+    if (*categoryLength == 0 || p == end || *p++ != ',') {
+        return 0;
+    }
+
+    return parseIntField(&p, end, quantity) && p < end && *p++ == ',' && parsePriceField(&p, end, price);
+}
+
+// Function to parse the rows of a mapped CSV file in place and append them to items[]
+void loadData(const char *data, size_t length, int rank, int size) {
+    const char *end = data + length;
+    const char *line = skipHeader(data, end);
+    while (line < end) {
+        const char *lineEnd = memchr(line, '\n', end - line);
+        if (!lineEnd) lineEnd = end;
+
+        // Only the id is parsed first; rows another rank owns are skipped without touching the other fields
+        const char *field = line;
+        int id, quantity, nameLength, categoryLength;
+        const char *name, *category;
+        float price;
+        if (parseIntField(&field, lineEnd, &id) && ownerRank(id, size) == rank &&
+            parseRow(line, lineEnd, &id, &name, &nameLength, &category, &categoryLength, &quantity, &price)) {
+            int code = categoryCode(category, categoryLength);
+            if (code >= 0) {
+                appendRow(id, name, nameLength, code, quantity, price);
+            }
+        }
+        line = lineEnd + 1;
+    }
+}
+
+// Function to map an item ID to its home slot (Fibonacci hashing keeps sequential IDs spread out)
+unsigned int hashId(int id) {
+    return ((unsigned int)id * 2654435769u) >> idIndexShift;
+}
+
+// Function to allocate an empty index with the given power-of-two capacity
+void indexAllocate(int capacity) {
+    IndexSlot *slots = malloc(sizeof(IndexSlot) * capacity);
+    if (!slots) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < capacity; i++) {
+        slots[i].row = INDEX_EMPTY;
+    }
+
+    free(idIndex);
+    idIndex = slots;
+    idIndexCapacity = capacity;
+    idIndexShift = 32;
+    while (capacity > 1) {
+        capacity >>= 1;
+        idIndexShift--;
+    }
+    idIndexCount = 0;
+}
+
+// Function to double the index capacity and rehash every entry
+void indexGrow() {
+    IndexSlot *old = idIndex;
+    int oldCapacity = idIndexCapacity;
+
+    idIndex = NULL;
+    indexAllocate(oldCapacity * 2);
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].row != INDEX_EMPTY) {
+            indexInsert(old[i].id, old[i].row);
+        }
+    }
+    free(old);
+}
+
+// Function to find the row of an item by ID, or INDEX_EMPTY if it is not stored
+int findItemRow(int id) {
+    unsigned int mask = idIndexCapacity - 1;
+    for (unsigned int slot = hashId(id); ; slot = (slot + 1) & mask) {
+        if (idIndex[slot].row == INDEX_EMPTY) {
+            return INDEX_EMPTY;
+        }
+        if (idIndex[slot].id == id) {
+            noteWork(1, ITEM_BYTES);
+            return idIndex[slot].row;
+        }
+    }
+}
+
+// Function to add an ID to the index. Returns 0 (and changes nothing) if the ID is already present.
+int indexInsert(int id, int row) {
+    // Keep the load factor under 70% so probe sequences stay short
+    if ((long long)(idIndexCount + 1) * 10 > (long long)idIndexCapacity * 7) {
+        indexGrow();
+    }
+
+    unsigned int mask = idIndexCapacity - 1;
+    unsigned int slot = hashId(id);
+    while (idIndex[slot].row != INDEX_EMPTY) {
+        if (idIndex[slot].id == id) {
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+    idIndex[slot].id = id;
+    idIndex[slot].row = row;
+    idIndexCount++;
+    return 1;
+}
+
+// Function to remove an ID from the index using backward-shift deletion (no tombstones needed)
+void indexRemove(int id) {
+    unsigned int mask = idIndexCapacity - 1;
+    unsigned int hole = hashId(id);
+    while (idIndex[hole].row != INDEX_EMPTY && idIndex[hole].id != id) {
+        hole = (hole + 1) & mask;
+    }
+    if (idIndex[hole].row == INDEX_EMPTY) {
+        return;
+    }
+
+    // Pull later entries of the probe run back into the hole unless that would move them before their home slot
+    for (unsigned int next = (hole + 1) & mask; idIndex[next].row != INDEX_EMPTY; next = (next + 1) & mask) {
+        unsigned int home = hashId(idIndex[next].id);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            idIndex[hole] = idIndex[next];
+            hole = next;
+        }
+    }
+    idIndex[hole].row = INDEX_EMPTY;
+    idIndexCount--;
+}
+
+// Function to point an indexed ID at a new row after the item has been moved
+void indexSetRow(int id, int row) {
+    unsigned int mask = idIndexCapacity - 1;
+    for (unsigned int slot = hashId(id); idIndex[slot].row != INDEX_EMPTY; slot = (slot + 1) & mask) {
+        if (idIndex[slot].id == id) {
+            idIndex[slot].row = row;
+            return;
+        }
+    }
+}
+
+// Function to (re)build the ID index from items[]. Rows whose ID was already seen are dropped.
+void buildIndex() {
+    int capacity = MIN_INDEX_CAPACITY;
+    while ((long long)itemCount * 10 > (long long)capacity * 7) {
+        capacity *= 2;
+    }
+    indexAllocate(capacity);
+
+    int kept = 0;
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID) {
+            nameArenaGarbage++; // The terminator its empty name kept
+            continue;
+        }
+        if (!indexInsert(ITEM_ID(i), kept)) {
+            categoryRemoveRow(i);
+            releaseName(i, 0);
+            continue;
+        }
+        if (kept != i) {
+            moveRow(kept, i);
+        }
+        kept++;
+    }
+
+    if (kept + tombstoneCount != itemCount) {
+        printf("Skipped %d rows with duplicate or reserved IDs.\n", itemCount - tombstoneCount - kept);
+    }
+    itemCount = kept;
+    tombstoneCount = 0;
+}
+
+// Function to squeeze tombstoned slots out of items[] while keeping live rows in their current order
+void compactItems() {
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES);
+    int kept = 0;
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID) {
+            continue;
+        }
+        if (kept != i) {
+            moveRow(kept, i);
+            indexSetRow(ITEM_ID(kept), kept);
+        }
+        kept++;
+    }
+    nameArenaGarbage += itemCount - kept; // The terminators the tombstones' empty names still held
+    itemCount = kept;
+    tombstoneCount = 0;
+}
+
+// Function to report the outcome of a mutation
+void reportResult(int result, int id, const char *success) {
+    switch (result) {
+        case RESULT_OK:
+            printf("\n%s\n", success);
+            break;
+        case RESULT_NOT_FOUND:
+            printf("\nError: Item with ID %d not found.\n", id);
+            break;
+        case RESULT_EXISTS:
+            printf("\nError: Item with ID %d already exists.\n", id);
+            break;
+        case RESULT_RESERVED_ID:
+            printf("\nError: Item ID %d is reserved.\n", id);
+            break;
+        case RESULT_TOO_MANY_CATEGORIES:
+            printf("\nError: Too many categories (at most %d).\n", MAX_CATEGORIES);
+            break;
+    }
+}
+
+// Function to find the rank that owns an id. Items are partitioned by a hash of the id that is mixed
+// independently of the index hash, so each rank's ids still spread evenly over its own index.
+int ownerRank(int id, int size) {
+    unsigned int h = (unsigned int)id;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (int)(((uint64_t)h * (unsigned int)size) >> 32);
+}
+
+// Function to bring the outcome of a point command, and any text it produced, from the owning rank to
+// rank 0. Only those two ranks take part; when rank 0 is the owner there is nothing to send.
+void routeReply(int owner, int rank, int *result, TextBuffer *text) {
+    if (owner == 0) {
+        return;
+    }
+    if (rank == owner) {
+        int header[2] = {*result, (int)text->length};
+        MPI_Send(header, 2, MPI_INT, 0, ROUTE_REPLY_TAG, MPI_COMM_WORLD);
+        MPI_Send(text->data, header[1], MPI_CHAR, 0, ROUTE_REPLY_TAG, MPI_COMM_WORLD);
+    } else if (rank == 0) {
+        int header[2];
+        MPI_Recv(header, 2, MPI_INT, owner, ROUTE_REPLY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        *result = header[0];
+        text->length = 0;
+        textReserve(text, header[1]);
+        MPI_Recv(text->data, header[1], MPI_CHAR, owner, ROUTE_REPLY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        text->length = header[1];
+    }
+}
+
+// Function to print text produced by every rank on rank 0, in rank order
+void printGathered(const TextBuffer *text, int rank, int size) {
+    writeGathered(text, stdout, rank, size);
+}
+
+// Function to write text produced by every rank to out on rank 0, in rank order
+void writeGathered(const TextBuffer *text, FILE *out, int rank, int size) {
+    int length = (int)text->length, total = 0;
+    int *lengths = NULL, *offsets = NULL;
+    TextBuffer gathered = {0};
+    if (rank == 0) {
+        lengths = malloc(sizeof(int) * size);
+        offsets = malloc(sizeof(int) * size);
+        if (!lengths || !offsets) {
+            perror("Memory allocation failed");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    MPI_Gather(&length, 1, MPI_INT, lengths, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            offsets[r] = total;
+            total += lengths[r];
+        }
+        textReserve(&gathered, total);
+    }
+    MPI_Gatherv(text->data, length, MPI_CHAR, gathered.data, lengths, offsets, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        fwrite(gathered.data, 1, total, out);
+    }
+    free(lengths);
+    free(offsets);
+    free(gathered.data);
+}
+
+// Function to add an item to the dataset and log it. Returns RESULT_OK or the reason the item was rejected.
+int applyAddItem(int id, const char *name, const char *category, int quantity, float price) {
+    if (id == TOMBSTONE_ID) {
+        return RESULT_RESERVED_ID;
+    }
+    if (findItemRow(id) != INDEX_EMPTY) {
+        return RESULT_EXISTS;
+    }
+    dropSortedSlice();
+
+    int code = internCategory(category);
+    if (code < 0) {
+        return RESULT_TOO_MANY_CATEGORIES;
+    }
+
+    indexInsert(id, itemCount);
+    appendRow(id, name, strlen(name), code, quantity, price);
+    indexName(id, ITEM_NAME(itemCount - 1));
+    aggregateRow(itemCount - 1, 1);
+    trackStock(itemCount - 1);
+    walLogItem(WAL_RECORD_ADD, id, name, category, quantity, price);
+    return RESULT_OK;
+}
+
+// Function to add an item to the dataset
+void addItem(int id, const char *name, const char *category, int quantity, float price, int rank, int size) {
+    int owner = ownerRank(id, size), result = RESULT_OK;
+    TextBuffer text = {0};
+    if (rank == owner) {
+        result = applyAddItem(id, name, category, quantity, price);
+    }
+    routeReply(owner, rank, &result, &text);
+    if (rank == 0) {
+        reportResult(result, id, "Item added successfully.");
+    }
+}
+
+// Function to delete an item by ID in O(1): the slot is either tombstoned or refilled with the last row
+int applyDeleteItem(int id) {
+    int i = findItemRow(id);
+    if (i == INDEX_EMPTY) {
+        return RESULT_NOT_FOUND;
+    }
+    dropSortedSlice();
+
+    unindexName(ITEM_NAME(i));
+    aggregateRow(i, -1);
+    untrackStock(i);
+    indexRemove(id);
+    categoryRemoveRow(i);
+    releaseName(i, i != itemCount - 1 && deleteMode != DELETE_MODE_SWAP);
+    if (i == itemCount - 1) {
+        itemCount--;
+    } else if (deleteMode == DELETE_MODE_SWAP) {
+        moveRow(i, itemCount - 1);
+        indexSetRow(ITEM_ID(i), i);
+        itemCount--;
+    } else {
+        // Clear the payload as well; every scan skips rows whose ID is TOMBSTONE_ID
+        ITEM_ID(i) = TOMBSTONE_ID;
+        ITEM_QUANTITY(i) = 0;
+        ITEM_PRICE(i) = 0;
+        tombstoneCount++;
+        if ((long long)tombstoneCount * 100 > (long long)itemCount * AUTO_COMPACT_PERCENT) {
+            compactItems();
+        }
+    }
+    walLogDelete(id);
+    tidyNameIndex();
+    tidyNames();
+    return RESULT_OK;
+}
+
+// Function to delete an item by ID
+void deleteItem(int id, int rank, int size) {
+    int owner = ownerRank(id, size), result = RESULT_OK;
+    TextBuffer text = {0};
+    if (rank == owner) {
+        result = applyDeleteItem(id);
+    }
+    routeReply(owner, rank, &result, &text);
+    if (rank == 0) {
+        reportResult(result, id, "Item deleted successfully.");
+    }
+}
+
+void retrieveItem(int id, int rank, int size) {
+    int owner = ownerRank(id, size), result = RESULT_NOT_FOUND;
+    TextBuffer text = {0};
+    if (rank == owner) {
+        int i = findItemRow(id);
+        if (i != INDEX_EMPTY) {
+            textAppend(&text, "\nItem Details:\n");
+            textAppend(&text, "ID: %d\nName: %s\nCategory: %s\nQuantity: %d\nPrice: %.2f\n", 
+                       ITEM_ID(i), ITEM_NAME(i), ITEM_CATEGORY_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
+            result = RESULT_OK;
+        }
+    }
+    routeReply(owner, rank, &result, &text);
+    if (rank == 0) {
+        if (result == RESULT_OK) {
+            fwrite(text.data, 1, text.length, stdout);
+        } else {
+            printf("\nError: Item with ID %d not found.\n", id);
+        }
+    }
+    free(text.data);
+}
+
+// Function to update the given fields of an item (NULL or negative leaves a field unchanged) and log it
+int applyUpdateItem(int id, const char *name, const char *category, int quantity, float price) {
+    int i = findItemRow(id);
+    if (i == INDEX_EMPTY) {
+        return RESULT_NOT_FOUND;
+    }
+    dropSortedSlice();
+
+    int code = category ? internCategory(category) : -1;
+    if (category && code < 0) {
+        return RESULT_TOO_MANY_CATEGORIES;
+    }
+
+    aggregateRow(i, -1);
+    if (name && strncmp(ITEM_NAME(i), name, NAME_MAX_LENGTH) != 0) {
+        unindexName(ITEM_NAME(i));
+        renameRow(i, name);
+        indexName(id, ITEM_NAME(i));
+        tidyNameIndex();
+        tidyNames();
+    }
+    if (category) {
+        categoryRemoveRow(i);
+        ITEM_CATEGORY(i) = (unsigned char)code;
+        categoryAddRow(i);
+    }
+    if (quantity >= 0) ITEM_QUANTITY(i) = quantity;
+    if (price >= 0) ITEM_PRICE(i) = price;
+    aggregateRow(i, 1);
+    trackStock(i);
+    walLogItem(WAL_RECORD_UPDATE, id, name, category, quantity, price);
+    return RESULT_OK;
+}
+
+// Function to update an item
+void updateItem(int id, const char *name, const char *category, int quantity, float price, int rank, int size) {
+    int owner = ownerRank(id, size), result = RESULT_OK;
+    TextBuffer text = {0};
+    if (rank == owner) {
+        result = applyUpdateItem(id, name, category, quantity, price);
+    }
+    routeReply(owner, rank, &result, &text);
+    if (rank == 0) {
+        reportResult(result, id, "Item updated successfully.");
+    }
+}
+
+// Function to add the deltas to rows [begin, end). Each field gets its own loop so that under
+// COLUMNAR_STORE both are straight passes over one contiguous column, which the compiler vectorizes.
+void bulkUpdateRows(int begin, int end, int quantityDelta, float priceDelta) {
+    noteWork(end - begin, (long long)(end - begin) * COLUMN_STRIDE * (priceDelta != 0.0f ? 2 : 1));
+    for (int i = begin; i < end; i++) {
+        ITEM_QUANTITY(i) += quantityDelta;
+    }
+    if (priceDelta != 0.0f) {
+        for (int i = begin; i < end; i++) {
+            ITEM_PRICE(i) += priceDelta;
+        }
+    }
+}
+
+// Function to apply a bulk update to every row, one chunk at a time
+void applyBulkUpdate(int quantityDelta, float priceDelta, int reportProgress) {
+    dropSortedSlice();
+    for (int begin = 0; begin < itemCount; begin += BULK_CHUNK_ROWS) {
+        int end = begin + BULK_CHUNK_ROWS < itemCount ? begin + BULK_CHUNK_ROWS : itemCount;
+        aggregateRows(begin, end, -1);
+        bulkUpdateRows(begin, end, quantityDelta, priceDelta);
+        aggregateRows(begin, end, 1);
+        trackStockRows(begin, end);
+        if (reportProgress && begin / BULK_PROGRESS_ROWS != end / BULK_PROGRESS_ROWS) {
+            printf("Processing done for %d items.\n", end);
+        }
+    }
+}
+
+// Function to apply a bulk update on every rank's shard; rank 0 reports its own progress and the slowest rank's time
+void processBulkUpdates(int quantityDelta, float priceDelta, int rank) {
+    double start = MPI_Wtime();
+    applyBulkUpdate(quantityDelta, priceDelta, rank == 0);
+    double elapsed = MPI_Wtime() - start, slowest = 0;
+
+    walLogBulk(quantityDelta, priceDelta); // Every rank logs its own shard
+
+    MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        printf("\nBulk update completed: Incremented all quantities by %d", quantityDelta);
+        if (priceDelta != 0.0f) {
+            printf(" and all prices by %.2f", priceDelta);
+        }
+        printf(".\nTotal processing time: %.3f seconds\n", slowest);
+    }
+}
+
+// Function to list the index buckets of a name's trigrams. With anchored set the name is read as if it began
+// with two GRAM_ANCHOR bytes, which gives its first one and two characters grams of their own.
+int nameGrams(const char *name, int anchored, unsigned int *buckets) {
+    unsigned char text[NAME_MAX_LENGTH + 2];
+    int length = 0;
+    if (anchored) {
+        text[length++] = GRAM_ANCHOR;
+        text[length++] = GRAM_ANCHOR;
+    }
+    while (*name && length < (int)sizeof(text)) {
+        text[length++] = (unsigned char)*name++;
+    }
+
+    int count = 0;
+    for (int i = 0; i + 2 < length; i++) {
+        unsigned int gram = (unsigned int)text[i] << 16 | (unsigned int)text[i + 1] << 8 | text[i + 2];
+        buckets[count++] = (gram * 2654435769u) >> (32 - GRAM_BUCKET_BITS);
+    }
+    return count;
+}
+
+// Function to add an item's name to the trigram index
+void indexName(int id, const char *name) {
+    unsigned int buckets[NAME_MAX_LENGTH + 2];
+    int count = nameGrams(name, 1, buckets);
+    for (int g = 0; g < count; g++) {
+        GramList *list = &gramLists[buckets[g]];
+        if (list->count && list->ids[list->count - 1] == id) {
+            continue; // Two grams of this name share a bucket
+        }
+        if (list->count == list->capacity) {
+            list->capacity = list->capacity ? list->capacity * 2 : 16;
+            list->ids = realloc(list->ids, sizeof(int) * list->capacity);
+            if (!list->ids) {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+        list->ids[list->count++] = id;
+        gramEntries++;
+    }
+}
+
+// Function to retire a name that is about to be overwritten or deleted. Its entries stay in the lists until the next rebuild.
+void unindexName(const char *name) {
+    unsigned int buckets[NAME_MAX_LENGTH + 2];
+    gramStale += nameGrams(name, 1, buckets);
+}
+
+// Function to (re)build the trigram index from the live rows
+void buildNameIndex() {
+    for (int b = 0; b < GRAM_BUCKETS; b++) {
+        gramLists[b].count = 0;
+    }
+    gramEntries = 0;
+    gramStale = 0;
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID) {
+            indexName(ITEM_ID(i), ITEM_NAME(i));
+        }
+    }
+}
+
+// Function to rebuild the trigram index once stale entries outnumber live ones
+void tidyNameIndex() {
+    if (gramStale * 2 > gramEntries) {
+        buildNameIndex();
+    }
+}
+
+// Function to release the trigram index
+void freeNameIndex() {
+    for (int b = 0; b < GRAM_BUCKETS; b++) {
+        free(gramLists[b].ids);
+        gramLists[b].ids = NULL;
+        gramLists[b].count = gramLists[b].capacity = 0;
+    }
+}
+
+// Function to test a name against a search keyword: a substring match, or with prefix set a match at the start
+int nameMatches(const char *name, const char *keyword, int prefix) {
+    return prefix ? strncmp(name, keyword, strlen(keyword)) == 0 : strstr(name, keyword) != NULL;
+}
+
+// Function to order row numbers for qsort()
+int compareRows(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to find the live rows whose name contains pattern, in storage order. A pattern ending in '*' matches
+// names that start with the rest. The rarest trigram of the pattern supplies the candidates when its list is
+// short enough to beat a scan; patterns without a trigram (under three characters) always scan.
+// Returns the number of rows stored in *rows, which the caller frees.
+int findNameRows(const char *pattern, int **rows) {
+    char keyword[NAME_MAX_LENGTH + 2]; // Room for a whole name plus the '*' of a prefix pattern
+    strncpy(keyword, pattern, sizeof(keyword) - 1);
+    keyword[sizeof(keyword) - 1] = '\0';
+    size_t length = strlen(keyword);
+    int prefix = length > 0 && keyword[length - 1] == '*';
+    if (prefix) {
+        keyword[length - 1] = '\0';
+    }
+
+    unsigned int buckets[NAME_MAX_LENGTH + 2];
+    int grams = nameGrams(keyword, prefix, buckets);
+    const GramList *best = NULL;
+    for (int g = 0; g < grams; g++) {
+        if (!best || gramLists[buckets[g]].count < best->count) {
+            best = &gramLists[buckets[g]];
+        }
+    }
+
+    int found = 0;
+    if (best && (long long)best->count * GRAM_PROBE_COST < itemCount) {
+        *rows = malloc(sizeof(int) * (best->count ? best->count : 1));
+        if (!*rows) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        for (int c = 0; c < best->count; c++) {
+            int i = findItemRow(best->ids[c]);
+            if (i != INDEX_EMPTY && nameMatches(ITEM_NAME(i), keyword, prefix)) {
+                (*rows)[found++] = i;
+            }
+        }
+        // An ID is listed again after it is renamed back or re-added, so sort and drop repeats
+        qsort(*rows, found, sizeof(int), compareRows);
+        int unique = 0;
+        for (int r = 0; r < found; r++) {
+            if (unique == 0 || (*rows)[unique - 1] != (*rows)[r]) {
+                (*rows)[unique++] = (*rows)[r];
+            }
+        }
+        return unique;
+    }
+
+    int capacity = 256;
+    *rows = malloc(sizeof(int) * capacity);
+    if (!*rows) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    noteWork(itemCount, (long long)itemCount * sizeof(Item) + (long long)(nameArenaLength - nameArenaGarbage));
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID || !nameMatches(ITEM_NAME(i), keyword, prefix)) continue;
+        if (found == capacity) {
+            capacity *= 2;
+            *rows = realloc(*rows, sizeof(int) * capacity);
+            if (!*rows) {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+        (*rows)[found++] = i;
+    }
+    return found;
+}
+
+void searchItems(const char *keyword, int rank, int size) {
+    if (rank == 0) {
+        printf("\nSearch Results for '%s':\n", keyword);
+    }
+    TextBuffer text = {0};
+    int *rows, totalFound = 0;
+    int found = findNameRows(keyword, &rows);
+    for (int r = 0; r < found; r++) {
+        int i = rows[r];
+        textAppend(&text, "ID: %d | Name: %s | Category: %s | Quantity: %d | Price: %.2f\n", 
+                   ITEM_ID(i), ITEM_NAME(i), ITEM_CATEGORY_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
+    }
+    free(rows);
+    printGathered(&text, rank, size);
+    MPI_Reduce(&found, &totalFound, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0 && !totalFound) {
+        printf("No items found matching '%s'.\n", keyword);
+    }
+    free(text.data);
+}
+
+// Function to map a float onto an unsigned key with the same ordering (flip all bits of negatives, the sign bit of positives)
+unsigned int floatSortKey(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Function to compute the radix key of a row for a numeric sort column
+unsigned int rowSortKey(int row, int column) {
+    switch (column) {
+        case SORT_BY_QUANTITY: return (unsigned int)ITEM_QUANTITY(row) ^ 0x80000000u;
+        case SORT_BY_ID:       return (unsigned int)ITEM_ID(row) ^ 0x80000000u;
+        default:               return floatSortKey(ITEM_PRICE(row));
+    }
+}
+
+// Function to decide whether entry x belongs before entry y. Ties fall back to the row number so every sort is stable.
+int entryBefore(const SortEntry *x, const SortEntry *y, int byName, int descending) {
+    if (byName) {
+        int cmp = strcmp(ITEM_NAME(x->row), ITEM_NAME(y->row));
+        if (cmp != 0) return descending ? cmp > 0 : cmp < 0;
+    } else if (x->key != y->key) {
+        return x->key < y->key; // Numeric keys are already inverted for descending sorts
+    }
+    return x->row < y->row;
+}
+
+// Function to LSD radix sort entries on their 32-bit key, one byte per pass. Passes where every key shares the same byte are skipped.
+void radixSortEntries(SortEntry *entries, SortEntry *scratch, int n) {
+    int counts[4][256] = {{0}};
+    for (int i = 0; i < n; i++) {
+        unsigned int key = entries[i].key;
+        counts[0][key & 0xFF]++;
+        counts[1][(key >> 8) & 0xFF]++;
+        counts[2][(key >> 16) & 0xFF]++;
+        counts[3][key >> 24]++;
+    }
+
+    SortEntry *src = entries, *dst = scratch;
+    for (int pass = 0; pass < 4; pass++) {
+        int shift = pass * 8;
+        if (n == 0 || counts[pass][(src[0].key >> shift) & 0xFF] == n) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            int count = counts[pass][digit];
+            counts[pass][digit] = offset;
+            offset += count;
+        }
+        for (int i = 0; i < n; i++) {
+            dst[counts[pass][(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+
+        SortEntry *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != entries) {
+        memcpy(entries, src, sizeof(SortEntry) * n);
+    }
+}
+
+// Function to merge two sorted runs into out
+void mergeEntries(const SortEntry *a, int na, const SortEntry *b, int nb, SortEntry *out, int byName, int descending) {
+    int i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        out[k++] = entryBefore(&b[j], &a[i], byName, descending) ? b[j++] : a[i++];
+    }
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
+
+// Function to sort entries by item name: insertion-sorted runs followed by bottom-up merges
+void mergeSortByName(SortEntry *entries, SortEntry *scratch, int n, int descending) {
+    for (int start = 0; start < n; start += NAME_RUN_LENGTH) {
+        int end = start + NAME_RUN_LENGTH < n ? start + NAME_RUN_LENGTH : n;
+        for (int i = start + 1; i < end; i++) {
+            SortEntry entry = entries[i];
+            int j = i - 1;
+            while (j >= start && entryBefore(&entry, &entries[j], 1, descending)) {
+                entries[j + 1] = entries[j];
+                j--;
+            }
+            entries[j + 1] = entry;
+        }
+    }
+
+    SortEntry *src = entries, *dst = scratch;
+    for (int width = NAME_RUN_LENGTH; width < n; width *= 2) {
+        for (int start = 0; start < n; start += 2 * width) {
+            int mid = start + width < n ? start + width : n;
+            int end = start + 2 * width < n ? start + 2 * width : n;
+            mergeEntries(src + start, mid - start, src + mid, end - mid, dst + start, 1, descending);
+        }
+        SortEntry *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != entries) {
+        memcpy(entries, src, sizeof(SortEntry) * n);
+    }
+}
+
+// Function to reorder items[] by a sorted permutation with a single gather, then repoint the ID index
+void applySortOrder(const SortEntry *entries, int n) {
+    Item *sorted = malloc(sizeof(Item) * itemCapacity);
+    if (!sorted) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+        sorted[i] = items[entries[i].row];
+    }
+    free(items);
+    items = sorted;
+
+#ifdef COLUMNAR_STORE
+    int *sortedId = malloc(sizeof(int) * itemCapacity);
+    int *sortedQuantity = malloc(sizeof(int) * itemCapacity);
+    float *sortedPrice = malloc(sizeof(float) * itemCapacity);
+    unsigned char *sortedCategory = malloc(sizeof(unsigned char) * itemCapacity);
+    if (!sortedId || !sortedQuantity || !sortedPrice || !sortedCategory) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+        int row = entries[i].row;
+        sortedId[i] = columns.id[row];
+        sortedQuantity[i] = columns.quantity[row];
+        sortedPrice[i] = columns.price[row];
+        sortedCategory[i] = columns.category[row];
+    }
+    free(columns.id);
+    free(columns.quantity);
+    free(columns.price);
+    free(columns.category);
+    columns.id = sortedId;
+    columns.quantity = sortedQuantity;
+    columns.price = sortedPrice;
+    columns.category = sortedCategory;
+#endif
+    rebuildCategoryBitmaps();
+    rebuildLowStockRows();
+    compactNames();
+
+    for (int i = 0; i < n; i++) {
+        indexSetRow(ITEM_ID(i), i);
+    }
+}
+
+// Function to sort this rank's items by any column. Only an 8-byte (key, row) permutation is sorted; the rows move once at the end.
+void sortItems(int column, int descending) {
+    compactItems();
+    int n = itemCount;
+    SortEntry *entries = malloc(sizeof(SortEntry) * (n > 0 ? n : 1));
+    SortEntry *scratch = malloc(sizeof(SortEntry) * (n > 0 ? n : 1));
+    if (!entries || !scratch) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    int byName = column == SORT_BY_NAME;
+    for (int i = 0; i < n; i++) {
+        entries[i].row = i;
+        entries[i].key = byName ? 0 : rowSortKey(i, column);
+        if (descending) entries[i].key = ~entries[i].key;
+    }
+
+    if (byName) {
+        mergeSortByName(entries, scratch, n, descending);
+    } else {
+        radixSortEntries(entries, scratch, n);
+    }
+    applySortOrder(entries, n);
+    noteWork(n, (long long)n * ITEM_BYTES);
+
+    free(entries);
+    free(scratch);
+}
+
+// Function to copy a row into a record, with its sort key for the given order
+void fillRecord(ItemRecord *record, int row, int column, int descending) {
+    record->key = column == SORT_BY_NAME ? 0 : rowSortKey(row, column);
+    if (descending) record->key = ~record->key;
+    record->id = ITEM_ID(row);
+    record->quantity = ITEM_QUANTITY(row);
+    record->price = ITEM_PRICE(row);
+    strcpy(record->name, ITEM_NAME(row));
+    memcpy(record->category, ITEM_CATEGORY_NAME(row), sizeof(record->category));
+}
+
+// Function to decide whether record x belongs strictly before record y
+int recordBefore(const ItemRecord *x, const ItemRecord *y, int byName, int descending) {
+    if (byName) {
+        int cmp = strcmp(x->name, y->name);
+        return descending ? cmp > 0 : cmp < 0;
+    }
+    return x->key < y->key; // Numeric keys are already inverted for descending orders
+}
+
+// Function to merge sorted runs of records into out. Ties go to the earlier run, so rank order is kept.
+void mergeRecordRuns(const ItemRecord *records, const int *counts, const int *offsets, int runs,
+                     ItemRecord *out, int byName, int descending) {
+    int *next = calloc(runs > 0 ? runs : 1, sizeof(int));
+    if (!next) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (int n = 0; ; n++) {
+        int best = -1;
+        for (int r = 0; r < runs; r++) {
+            if (next[r] < counts[r] &&
+                (best < 0 || recordBefore(&records[offsets[r] + next[r]], &records[offsets[best] + next[best]], byName, descending))) {
+                best = r;
+            }
+        }
+        if (best < 0) break;
+        out[n] = records[offsets[best] + next[best]++];
+    }
+    free(next);
+}
+
+// Function to describe ItemRecord to MPI; the caller frees the type
+MPI_Datatype recordDatatype() {
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(ItemRecord), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+// Function to sort every rank's items into one global order with a sample sort. Each rank sorts its shard,
+// offers size - 1 evenly spaced samples, and all ranks pick the same size - 1 splitters from the pooled samples.
+// Rank r then receives every item between splitters r - 1 and r and merges the sorted runs it got. Items stay
+// owned by their shard; the records returned (*count of them) are this rank's slice of the global order.
+ItemRecord *sampleSortRecords(int column, int descending, int rank, int size, int *count) {
+    int byName = column == SORT_BY_NAME;
+    MPI_Datatype recordType = recordDatatype();
+    sortItems(column, descending); // Compacts, so rows 0..itemCount-1 are live and in order
+    int n = itemCount;
+
+    ItemRecord *local = malloc(sizeof(ItemRecord) * (n > 0 ? n : 1));
+    ItemRecord *samples = malloc(sizeof(ItemRecord) * size * (size > 1 ? size - 1 : 1));
+    int *sendCounts = calloc(size, sizeof(int)), *sendOffsets = malloc(sizeof(int) * size);
+    int *recvCounts = malloc(sizeof(int) * size), *recvOffsets = malloc(sizeof(int) * size);
+    if (!local || !samples || !sendCounts || !sendOffsets || !recvCounts || !recvOffsets) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+        fillRecord(&local[i], i, column, descending);
+    }
+
+    // Pool the samples everywhere and sort them; there are at most size * (size - 1), so insertion sort will do
+    int sampleCount = n > 0 ? size - 1 : 0, total = 0;
+    ItemRecord *mine = samples + rank * (size - 1);
+    for (int s = 0; s < sampleCount; s++) {
+        mine[s] = local[(long long)n * (s + 1) / size];
+    }
+    MPI_Allgather(&sampleCount, 1, MPI_INT, recvCounts, 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        recvOffsets[r] = total;
+        total += recvCounts[r];
+    }
+    ItemRecord *pooled = malloc(sizeof(ItemRecord) * (total > 0 ? total : 1));
+    if (!pooled) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Allgatherv(mine, sampleCount, recordType, pooled, recvCounts, recvOffsets, recordType, MPI_COMM_WORLD);
+    for (int i = 1; i < total; i++) {
+        ItemRecord sample = pooled[i];
+        int j = i;
+        for (; j > 0 && recordBefore(&sample, &pooled[j - 1], byName, descending); j--) {
+            pooled[j] = pooled[j - 1];
+        }
+        pooled[j] = sample;
+    }
+    int splitterCount = total > 0 ? size - 1 : 0;
+    for (int s = 0; s < splitterCount; s++) {
+        samples[s] = pooled[(long long)total * (s + 1) / size];
+    }
+    free(pooled);
+
+    // The shard is sorted, so bucket boundaries only move forward
+    for (int i = 0, bucket = 0; i < n; i++) {
+        while (bucket < splitterCount && !recordBefore(&local[i], &samples[bucket], byName, descending)) {
+            bucket++;
+        }
+        sendCounts[bucket]++;
+    }
+    MPI_Alltoall(sendCounts, 1, MPI_INT, recvCounts, 1, MPI_INT, MPI_COMM_WORLD);
+    int sent = 0, received = 0;
+    for (int r = 0; r < size; r++) {
+        sendOffsets[r] = sent;
+        sent += sendCounts[r];
+        recvOffsets[r] = received;
+        received += recvCounts[r];
+    }
+    ItemRecord *runs = malloc(sizeof(ItemRecord) * (received > 0 ? received : 1));
+    ItemRecord *slice = malloc(sizeof(ItemRecord) * (received > 0 ? received : 1));
+    if (!runs || !slice) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_Alltoallv(local, sendCounts, sendOffsets, recordType, runs, recvCounts, recvOffsets, recordType, MPI_COMM_WORLD);
+    mergeRecordRuns(runs, recvCounts, recvOffsets, size, slice, byName, descending);
+
+    free(local);
+    free(samples);
+    free(runs);
+    free(sendCounts);
+    free(sendOffsets);
+    free(recvCounts);
+    free(recvOffsets);
+    MPI_Type_free(&recordType);
+    *count = received;
+    return slice;
+}
+
+// Function to sample sort every shard into the given order and keep this rank's slice for printItems
+void sortAllShards(int column, int descending, int rank, int size) {
+    dropSortedSlice();
+    sortedSlice = sampleSortRecords(column, descending, rank, size, &sortedSliceCount);
+    listColumn = column;
+    listDescending = descending;
+}
+
+// Function to forget the kept slice of the global order after a write; the next listing sorts again
+void dropSortedSlice() {
+    free(sortedSlice);
+    sortedSlice = NULL;
+    sortedSliceCount = 0;
+}
+
+// Function to restore the max-heap property below slot i. The heap keeps the k best rows seen so far with
+// the worst of them on top, so a new row only has to beat the top to get in.
+void siftTopEntry(SortEntry *heap, int n, int i) {
+    for (;;) {
+        int worst = i, left = 2 * i + 1, right = left + 1;
+        if (left < n && heap[left].key > heap[worst].key) worst = left;
+        if (right < n && heap[right].key > heap[worst].key) worst = right;
+        if (worst == i) return;
+        SortEntry tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
+    }
+}
+
+// Function to find this rank's k best rows in one pass over a key column. They are left in heap[0..count-1]
+// in order, best first; returns count, which is below k only when the shard has fewer live rows.
+int selectTopRows(int column, int descending, int k, SortEntry *heap) {
+    int count = 0;
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+        unsigned int key = rowSortKey(i, column);
+        if (descending) key = ~key;
+        if (count < k) {
+            heap[count].key = key;
+            heap[count].row = i;
+            count++;
+            if (count == k) {
+                for (int j = k / 2 - 1; j >= 0; j--) {
+                    siftTopEntry(heap, k, j);
+                }
+            }
+        } else if (key < heap[0].key) {
+            heap[0].key = key;
+            heap[0].row = i;
+            siftTopEntry(heap, k, 0);
+        }
+    }
+    if (count < k) {
+        for (int j = count / 2 - 1; j >= 0; j--) {
+            siftTopEntry(heap, count, j);
+        }
+    }
+
+    // Heap sort in place: repeatedly move the worst remaining row to the end
+    for (int n = count - 1; n > 0; n--) {
+        SortEntry tmp = heap[0];
+        heap[0] = heap[n];
+        heap[n] = tmp;
+        siftTopEntry(heap, n, 0);
+    }
+    return count;
+}
+
+// Function to print the k lowest (or highest) items by price or quantity over all shards. Every rank keeps
+// its own best k in one scan; rank 0 gathers those candidates and merges them.
+void topItems(int column, int descending, int k, int rank, int size) {
+    double start = MPI_Wtime();
+    MPI_Datatype recordType = recordDatatype();
+    int limit = k < itemCount ? k : itemCount;
+    SortEntry *heap = malloc(sizeof(SortEntry) * (limit > 0 ? limit : 1));
+    ItemRecord *local = malloc(sizeof(ItemRecord) * (limit > 0 ? limit : 1));
+    if (!heap || !local) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    int count = selectTopRows(column, descending, limit, heap);
+    noteWork(itemCount, (long long)itemCount * COLUMN_STRIDE);
+    for (int i = 0; i < count; i++) {
+        fillRecord(&local[i], heap[i].row, column, descending);
+    }
+
+    int *counts = NULL, *offsets = NULL, total = 0;
+    ItemRecord *candidates = NULL, *merged = NULL;
+    if (rank == 0) {
+        counts = malloc(sizeof(int) * size);
+        offsets = malloc(sizeof(int) * size);
+        if (!counts || !offsets) {
+            perror("Memory allocation failed");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            offsets[r] = total;
+            total += counts[r];
+        }
+        candidates = malloc(sizeof(ItemRecord) * (total > 0 ? total : 1));
+        merged = malloc(sizeof(ItemRecord) * (total > 0 ? total : 1));
+        if (!candidates || !merged) {
+            perror("Memory allocation failed");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    MPI_Gatherv(local, count, recordType, candidates, counts, offsets, recordType, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        mergeRecordRuns(candidates, counts, offsets, size, merged, 0, descending);
+        int shown = total < k ? total : k;
+        printf("\n%s %d items by %s:\n", descending ? "Highest" : "Lowest", shown,
+               column == SORT_BY_QUANTITY ? "quantity" : "price");
+        printf("| %-5s | %-15s | %-15s | %-10s | %-10s |\n", "ID", "Name", "Category", "Quantity", "Price");
+        printf("|----------------------------------------------------------|\n");
+        for (int i = 0; i < shown; i++) {
+            printf("| %-5d | %-15s | %-15s | %-10d | %-10.2f |\n",
+                   merged[i].id, merged[i].name, merged[i].category, merged[i].quantity, merged[i].price);
+        }
+        printf("===========================================================\n");
+        printf("Found in %.3f seconds from %d candidates on %d ranks.\n", MPI_Wtime() - start, total, size);
+    }
+    free(heap);
+    free(local);
+    free(counts);
+    free(offsets);
+    free(candidates);
+    free(merged);
+    MPI_Type_free(&recordType);
+}
+
+// Function to checksum one WAL record body (FNV-1a), so a torn or corrupt tail is detected on replay
+uint32_t walChecksum(const unsigned char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Function to write every buffered WAL record to the log file
+void walFlush() {
+    size_t written = 0;
+    while (written < walBuffered) {
+        ssize_t n = write(walFd, walBuffer + written, walBuffered - written);
+        if (n < 0) {
+            perror("Error writing WAL");
+            exit(EXIT_FAILURE);
+        }
+        written += (size_t)n;
+    }
+    walBuffered = 0;
+}
+
+// Function to append a record with the next LSN to the WAL buffer. Does nothing while no WAL is open (or during replay).
+void walAppend(int type, const unsigned char *payload, size_t size) {
+    if (walFd < 0) {
+        return;
+    }
+
+    uint32_t length = (uint32_t)(sizeof(uint64_t) + 1 + size);
+    if (walBuffered + 2 * sizeof(uint32_t) + length > WAL_BUFFER_BYTES) {
+        walFlush();
+    }
+
+    unsigned char *record = walBuffer + walBuffered;
+    unsigned char *body = record + 2 * sizeof(uint32_t);
+    uint64_t lsn = ++walSequence;
+    memcpy(body, &lsn, sizeof(lsn));
+    body[sizeof(lsn)] = (unsigned char)type;
+    memcpy(body + sizeof(lsn) + 1, payload, size);
+
+    uint32_t checksum = walChecksum(body, length);
+    memcpy(record, &length, sizeof(length));
+    memcpy(record + sizeof(length), &checksum, sizeof(checksum));
+    walBuffered += 2 * sizeof(uint32_t) + length;
+}
+
+// Function to log an added or updated item. Payload: id, flags, quantity, price, then name and category
+// each as a length byte plus characters. flags says which fields an update changes.
+void walLogItem(int type, int id, const char *name, const char *category, int quantity, float price) {
+    unsigned char payload[2 * sizeof(int) + sizeof(float) + 3 + NAME_MAX_LENGTH + 49];
+    unsigned char flags = 0;
+    if (name) flags |= WAL_FIELD_NAME;
+    if (category) flags |= WAL_FIELD_CATEGORY;
+    if (type == WAL_RECORD_ADD || quantity >= 0) flags |= WAL_FIELD_QUANTITY;
+    if (type == WAL_RECORD_ADD || price >= 0) flags |= WAL_FIELD_PRICE;
+
+    size_t size = 0;
+    memcpy(payload + size, &id, sizeof(id));
+    size += sizeof(id);
+    payload[size++] = flags;
+    memcpy(payload + size, &quantity, sizeof(quantity));
+    size += sizeof(quantity);
+    memcpy(payload + size, &price, sizeof(price));
+    size += sizeof(price);
+
+    const char *text[2] = {name ? name : "", category ? category : ""};
+    for (int t = 0; t < 2; t++) {
+        size_t limit = t == 0 ? NAME_MAX_LENGTH : 49;
+        size_t length = strlen(text[t]) < limit ? strlen(text[t]) : limit;
+        payload[size++] = (unsigned char)length;
+        memcpy(payload + size, text[t], length);
+        size += length;
+    }
+    walAppend(type, payload, size);
+}
+
+// Function to log a deleted item
+void walLogDelete(int id) {
+    walAppend(WAL_RECORD_DELETE, (const unsigned char *)&id, sizeof(id));
+}
+
+// Function to log a bulk update
+void walLogBulk(int quantityDelta, float priceDelta) {
+    unsigned char payload[sizeof(int) + sizeof(float)];
+    memcpy(payload, &quantityDelta, sizeof(quantityDelta));
+    memcpy(payload + sizeof(quantityDelta), &priceDelta, sizeof(priceDelta));
+    walAppend(WAL_RECORD_BULK, payload, sizeof(payload));
+}
+
+// Function to log a filtered bulk update; the category travels by name, so replay does not depend on codes
+void walLogFiltered(const BulkFilter *filter, const BulkAction *action) {
+    unsigned char payload[sizeof(BulkFilter) + sizeof(BulkAction)];
+    memcpy(payload, filter, sizeof(BulkFilter));
+    memcpy(payload + sizeof(BulkFilter), action, sizeof(BulkAction));
+    walAppend(WAL_RECORD_FILTERED, payload, sizeof(payload));
+}
+
+// Function to end a group of mutations: write the buffered records with one write() and fdatasync()
+// once every walSyncEvery commits. Records are safe from a process crash as soon as this returns.
+void walCommit() {
+    if (walFd < 0 || walBuffered == 0) {
+        return;
+    }
+
+    walFlush();
+    if (walSyncEvery > 0 && ++walUnsynced >= walSyncEvery) {
+        fdatasync(walFd);
+        walUnsynced = 0;
+    }
+}
+
+// Function to flush, sync and close the WAL on a clean exit
+void walClose() {
+    if (walFd < 0) {
+        return;
+    }
+
+    walFlush();
+    fdatasync(walFd);
+    close(walFd);
+    walFd = -1;
+}
+
+// Function to apply one logged mutation during replay
+void walReplay(int type, const unsigned char *payload, size_t bytes, int rank, int size) {
+    int id, quantity;
+    float price;
+    char text[2][NAME_MAX_LENGTH + 1];
+
+    if (type == WAL_RECORD_DELETE && bytes == sizeof(int)) {
+        memcpy(&id, payload, sizeof(id));
+        applyDeleteItem(id);
+    } else if (type == WAL_RECORD_BULK && bytes == sizeof(int) + sizeof(float)) {
+        memcpy(&quantity, payload, sizeof(quantity));
+        memcpy(&price, payload + sizeof(int), sizeof(price));
+        applyBulkUpdate(quantity, price, 0);
+    } else if (type == WAL_RECORD_FILTERED && bytes == sizeof(BulkFilter) + sizeof(BulkAction)) {
+        BulkFilter filter;
+        BulkAction action;
+        int plan;
+        memcpy(&filter, payload, sizeof(filter));
+        memcpy(&action, payload + sizeof(filter), sizeof(action));
+        filter.category[sizeof(filter.category) - 1] = '\0';
+        applyFilteredUpdate(&filter, &action, &plan, rank, size);
+    } else if ((type == WAL_RECORD_ADD || type == WAL_RECORD_UPDATE) && bytes >= 2 * sizeof(int) + sizeof(float) + 3) {
+        size_t p = 0;
+        memcpy(&id, payload + p, sizeof(id));
+        p += sizeof(id);
+        unsigned char flags = payload[p++];
+        memcpy(&quantity, payload + p, sizeof(quantity));
+        p += sizeof(quantity);
+        memcpy(&price, payload + p, sizeof(price));
+        p += sizeof(price);
+        for (int t = 0; t < 2; t++) {
+            size_t length = p < bytes ? payload[p++] : 0;
+            if (length > (t == 0 ? NAME_MAX_LENGTH : 49) || p + length > bytes) {
+                return;
+            }
+            memcpy(text[t], payload + p, length);
+            text[t][length] = '\0';
+            p += length;
+        }
+
+        if (type == WAL_RECORD_ADD) {
+            applyAddItem(id, text[0], text[1], quantity, price);
+        } else {
+            applyUpdateItem(id, (flags & WAL_FIELD_NAME) ? text[0] : NULL, (flags & WAL_FIELD_CATEGORY) ? text[1] : NULL,
+                            (flags & WAL_FIELD_QUANTITY) ? quantity : -1, (flags & WAL_FIELD_PRICE) ? price : -1);
+        }
+    }
+}
+
+// Function to replay the WAL on top of the loaded table and open it for appending. Records at or below
+// walSequence (already contained in the snapshot) are skipped; an incomplete tail is cut off.
+void walOpen(const char *filename, int rank, int size) {
+    int fd = open(filename, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Error opening WAL");
+        exit(EXIT_FAILURE);
+    }
+
+    MappedFile log;
+    mapFile(filename, &log);
+    const unsigned char *data = (const unsigned char *)log.data;
+    size_t offset = 0;
+    int replayed = 0, skipped = 0;
+    while (log.size - offset >= 2 * sizeof(uint32_t)) {
+        uint32_t length, checksum;
+        memcpy(&length, data + offset, sizeof(length));
+        memcpy(&checksum, data + offset + sizeof(length), sizeof(checksum));
+        const unsigned char *body = data + offset + 2 * sizeof(uint32_t);
+        if (length <= sizeof(uint64_t) || length > log.size - offset - 2 * sizeof(uint32_t)
+            || walChecksum(body, length) != checksum) {
+            break;
+        }
+
+        uint64_t lsn;
+        memcpy(&lsn, body, sizeof(lsn));
+        if (lsn > walSequence) {
+            walReplay(body[sizeof(lsn)], body + sizeof(lsn) + 1, length - sizeof(lsn) - 1, rank, size);
+            walSequence = lsn;
+            replayed++;
+        } else {
+            skipped++;
+        }
+        offset += 2 * sizeof(uint32_t) + length;
+    }
+
+    if (offset < log.size) {
+        printf("Discarding %zu bytes of incomplete WAL data.\n", log.size - offset);
+        if (ftruncate(fd, (off_t)offset) != 0) {
+            perror("Error truncating WAL");
+            exit(EXIT_FAILURE);
+        }
+    }
+    unmapFile(&log);
+    lseek(fd, (off_t)offset, SEEK_SET);
+    walFd = fd;
+    if (replayed || skipped) {
+        printf("Replayed %d WAL records (%d were already in the snapshot).\n", replayed, skipped);
+    }
+}
+
+// Function to write value in decimal at out. Returns the characters written.
+int formatInt(char *out, long long value) {
+    char digits[20];
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    int count = 0, length = 0;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) out[length++] = '-';
+    while (count) out[length++] = digits[--count];
+    return length;
+}
+
+// Function to write price exactly as "%.2f" would, without going through printf. A float times 100 is exact in a
+// double, so the cents and any exact half are known precisely; halves round to even, as printf rounds them.
+int formatPrice(char *out, float price) {
+    double cents = (double)price * 100;
+    if (!(cents > -1e15 && cents < 1e15)) {
+        return sprintf(out, "%.2f", price); // Huge values, infinities and NaN
+    }
+    double magnitude = cents < 0 ? -cents : cents;
+    long long whole = (long long)magnitude;
+    double fraction = magnitude - (double)whole;
+    if (fraction > 0.5 || (fraction == 0.5 && (whole & 1))) {
+        whole++;
+    }
+    int length = 0;
+    if (__builtin_signbit(price)) out[length++] = '-';
+    length += formatInt(out + length, whole / 100);
+    out[length++] = '.';
+    out[length++] = (char)('0' + whole / 10 % 10);
+    out[length++] = (char)('0' + whole % 10);
+    return length;
+}
+
+// Function to format the rows set in words [firstWord, endWord) of a selection bitmap into buffer, which must hold
+// EXPORT_ROW_BYTES per row. Returns the bytes written; a block without rows writes nothing.
+size_t formatExportBlock(int format, const uint64_t *selected, int firstWord, int endWord, char *buffer) {
+    int rows[EXPORT_BLOCK_WORDS * 64], count = 0;
+    for (int w = firstWord; w < endWord; w++) {
+        for (uint64_t bits = selected[w]; bits; bits &= bits - 1) {
+            rows[count++] = w * 64 + __builtin_ctzll(bits);
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    char *p = buffer;
+    if (format == EXPORT_CSV) {
+        for (int k = 0; k < count; k++) {
+            int i = rows[k];
+            size_t nameLength = strlen(ITEM_NAME(i)), categoryLength = strlen(ITEM_CATEGORY_NAME(i));
+            p += formatInt(p, ITEM_ID(i));
+            *p++ = ',';
+            memcpy(p, ITEM_NAME(i), nameLength);
+            p += nameLength;
+            *p++ = ',';
+            memcpy(p, ITEM_CATEGORY_NAME(i), categoryLength);
+            p += categoryLength;
+            *p++ = ',';
+            p += formatInt(p, ITEM_QUANTITY(i));
+            *p++ = ',';
+            p += formatPrice(p, ITEM_PRICE(i));
+            *p++ = '\n';
+        }
+        return p - buffer;
+    }
+
+    // Binary: the block's rows column by column; names as a column of length bytes, then the names back to back
+    uint32_t rowCount = (uint32_t)count;
+    memcpy(p, &rowCount, sizeof(rowCount));
+    p += sizeof(rowCount);
+    for (int k = 0; k < count; k++, p += sizeof(int)) memcpy(p, &ITEM_ID(rows[k]), sizeof(int));
+    for (int k = 0; k < count; k++, p += sizeof(int)) memcpy(p, &ITEM_QUANTITY(rows[k]), sizeof(int));
+    for (int k = 0; k < count; k++, p += sizeof(float)) memcpy(p, &ITEM_PRICE(rows[k]), sizeof(float));
+    for (int k = 0; k < count; k++) *p++ = (char)ITEM_CATEGORY(rows[k]);
+    unsigned char *lengths = (unsigned char *)p;
+    for (int k = 0; k < count; k++) *p++ = (char)strlen(ITEM_NAME(rows[k]));
+    for (int k = 0; k < count; k++) {
+        memcpy(p, ITEM_NAME(rows[k]), lengths[k]);
+        p += lengths[k];
+    }
+    return p - buffer;
+}
+
+// Function to write a whole buffer to fd, retrying short writes. Returns 0, or -1 with errno set.
+int writeAll(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            return -1;
+        }
+        p += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+// Function to open an export target for writing. A name ending in ".gz" is written through a gzip child process,
+// which compresses on another core while this process formats; *compressor is then its pid, otherwise 0.
+// Returns the descriptor to write to, or -1 with errno set.
+int openExportFile(const char *filename, pid_t *compressor) {
+    *compressor = 0;
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    size_t length = strlen(filename);
+    if (fd < 0 || length < 3 || strcmp(filename + length - 3, ".gz") != 0) {
+        return fd;
+    }
+
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+        close(fd);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN); // A compressor that dies shows up as a failed write instead of killing us
+    fflush(stdout);
+    *compressor = fork();
+    if (*compressor < 0) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        close(fd);
+        return -1;
+    }
+    if (*compressor == 0) {
+        dup2(pipeFds[0], STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        close(fd);
+        execlp("gzip", "gzip", "-c", (char *)NULL);
+        _exit(127);
+    }
+    close(pipeFds[0]);
+    close(fd);
+    return pipeFds[1];
+}
+
+// Function to finish an export: close the descriptor and wait for the compressor, if any. Returns 0 on success.
+int closeExportFile(int fd, pid_t compressor) {
+    int failed = close(fd) != 0;
+    if (compressor > 0) {
+        int status;
+        failed |= waitpid(compressor, &status, 0) != compressor || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to write the header and category names that start a binary export of rows rows
+int writeExportHeader(int fd, long long rows) {
+    ExportHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXPORT_MAGIC, sizeof(header.magic));
+    header.version = EXPORT_VERSION;
+    header.rowCount = (uint32_t)rows;
+    header.categoryCount = (uint32_t)categoryCount;
+    header.blockRows = EXPORT_BLOCK_WORDS * 64;
+    if (writeAll(fd, &header, sizeof(header)) != 0) {
+        return -1;
+    }
+    return writeAll(fd, categoryNames, sizeof(categoryNames[0]) * categoryCount);
+}
+
+// Function to stream the rows set in selected to filename. Rows are formatted a block at a time into one buffer,
+// which goes out with a single write(), so no copy of the selection is ever built. Returns the rows written, or -1.
+long long exportRows(const char *filename, int format, const uint64_t *selected, int words) {
+    pid_t compressor;
+    int fd = openExportFile(filename, &compressor);
+    char *buffer = malloc(EXPORT_BLOCK_WORDS * 64 * EXPORT_ROW_BYTES);
+    if (fd < 0 || !buffer) {
+        perror("Error exporting data");
+        if (fd >= 0) closeExportFile(fd, compressor);
+        free(buffer);
+        return -1;
+    }
+
+    long long rows = 0;
+    for (int w = 0; w < words; w++) {
+        rows += __builtin_popcountll(selected[w]);
+    }
+    noteWork(rows, rows * ITEM_BYTES);
+    int failed = format == EXPORT_BINARY && writeExportHeader(fd, rows) != 0;
+    for (int w = 0; w < words && !failed; w += EXPORT_BLOCK_WORDS) {
+        int end = w + EXPORT_BLOCK_WORDS < words ? w + EXPORT_BLOCK_WORDS : words;
+        failed = writeAll(fd, buffer, formatExportBlock(format, selected, w, end, buffer)) != 0;
+    }
+    if (failed) {
+        perror("Error exporting data");
+    }
+    free(buffer);
+    if (closeExportFile(fd, compressor) != 0 && !failed) {
+        fprintf(stderr, "Error exporting data: could not finish writing %s\n", filename);
+        failed = 1;
+    }
+    return failed ? -1 : rows;
+}
+
+// Function to name this rank's shard of an export: "<filename>.<rank>", keeping a ".gz" suffix last.
+// Returns 0 if the name does not fit in size bytes.
+int exportShardName(const char *filename, int rank, char *shardName, size_t size) {
+    size_t length = strlen(filename);
+    int written;
+    if (length >= 3 && strcmp(filename + length - 3, ".gz") == 0) {
+        written = snprintf(shardName, size, "%.*s.%d.gz", (int)(length - 3), filename, rank);
+    } else {
+        written = snprintf(shardName, size, "%s.%d", filename, rank);
+    }
+    return written >= 0 && (size_t)written < size;
+}
+
+// Function to export the items matching a filter (initBulkFilter matches every item) as CSV or binary columns.
+// Every rank writes its own shard (see exportShardName), so the ranks write in parallel without passing rows
+// around. Returns on rank 0 the rows written by all ranks, or -1 if any rank failed.
+long long exportData(const char *filename, int format, const BulkFilter *filter, int rank) {
+    // A shard name that does not fit fails the export on every rank, before any rank writes
+    char shardName[PATH_MAX];
+    int named = exportShardName(filename, rank, shardName, sizeof(shardName)), allNamed = 0;
+    MPI_Allreduce(&named, &allNamed, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!allNamed) {
+        if (rank == 0) fprintf(stderr, "Error exporting data: file name too long: %s\n", filename);
+        return -1;
+    }
+
+    int category = filter->category[0] ? findCategory(filter->category) : -1;
+    int words = (itemCount + 63) / 64;
+    uint64_t *selected = newBitmap(words);
+    if (filter->category[0] && category < 0) {
+        memset(selected, 0, sizeof(uint64_t) * words); // Unknown category on this rank: nothing matches
+    } else {
+        selectFilterRows(filter, category, selected);
+    }
+    long long rows = exportRows(shardName, format, selected, words), totalRows = 0;
+    free(selected);
+
+    int succeeded = rows >= 0, allSucceeded = 0;
+    if (rows < 0) rows = 0;
+    MPI_Reduce(&rows, &totalRows, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&succeeded, &allSucceeded, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+    return rank != 0 || allSucceeded ? totalRows : -1;
+}
+
+// Function to fold size bytes (a multiple of 8) into a running snapshot checksum
+uint64_t snapshotChecksum(uint64_t checksum, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        checksum = (checksum ^ word) * 0x9E3779B97F4A7C15ULL;
+        checksum ^= checksum >> 29;
+    }
+    return checksum;
+}
+
+// Function to round a section size up to the 8-byte alignment every snapshot section starts on
+size_t snapshotPadded(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// Function to check that a snapshot's name lengths walk its name section exactly, every name ending in its terminator
+int snapshotNamesValid(const unsigned char *lengths, const char *names, size_t n, uint64_t nameBytes) {
+    uint64_t offset = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (offset + lengths[k] >= nameBytes || memchr(names + offset, '\0', lengths[k] + 1) != names + offset + lengths[k]) {
+            return 0;
+        }
+        offset += lengths[k] + 1;
+    }
+    return offset == nameBytes;
+}
+
+// Function to append bytes to the snapshot being written, zero-padding a final partial word
+void writeSnapshotSection(FILE *file, const void *data, size_t size, uint64_t *checksum) {
+    size_t whole = size & ~(size_t)7;
+    fwrite(data, 1, size, file);
+    *checksum = snapshotChecksum(*checksum, data, whole);
+    if (size > whole) {
+        uint64_t tail = 0;
+        memcpy(&tail, (const char *)data + whole, size - whole);
+        fwrite((const char *)&tail + (size - whole), 1, 8 - (size - whole), file);
+        *checksum = snapshotChecksum(*checksum, &tail, sizeof(tail));
+    }
+}
+
+// Function to copy one field of rows [start, start + count) into buffer in snapshot (columnar) order.
+// Returns the number of bytes written.
+size_t gatherSnapshotBlock(int field, int start, int count, char *buffer) {
+    switch (field) {
+        case SNAPSHOT_FIELD_ID:
+            for (int k = 0; k < count; k++) ((int *)buffer)[k] = ITEM_ID(start + k);
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_QUANTITY:
+            for (int k = 0; k < count; k++) ((int *)buffer)[k] = ITEM_QUANTITY(start + k);
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_PRICE:
+            for (int k = 0; k < count; k++) ((float *)buffer)[k] = ITEM_PRICE(start + k);
+            return sizeof(float) * count;
+        case SNAPSHOT_FIELD_CATEGORY:
+            for (int k = 0; k < count; k++) ((unsigned char *)buffer)[k] = ITEM_CATEGORY(start + k);
+            return count;
+        default:
+            for (int k = 0; k < count; k++) ((unsigned char *)buffer)[k] = (unsigned char)strlen(ITEM_NAME(start + k));
+            return count;
+    }
+}
+
+// Function to copy one field of rows [start, start + count) back out of a snapshot section. Returns the bytes consumed.
+size_t scatterSnapshotBlock(int field, int start, int count, const char *data) {
+    switch (field) {
+        case SNAPSHOT_FIELD_ID:
+            for (int k = 0; k < count; k++) memcpy(&ITEM_ID(start + k), data + sizeof(int) * k, sizeof(int));
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_QUANTITY:
+            for (int k = 0; k < count; k++) memcpy(&ITEM_QUANTITY(start + k), data + sizeof(int) * k, sizeof(int));
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_PRICE:
+            for (int k = 0; k < count; k++) memcpy(&ITEM_PRICE(start + k), data + sizeof(float) * k, sizeof(float));
+            return sizeof(float) * count;
+        case SNAPSHOT_FIELD_CATEGORY:
+            for (int k = 0; k < count; k++) ITEM_CATEGORY(start + k) = (unsigned char)data[k];
+            return count;
+        default: {
+            // The names themselves follow in the name section and are appended to the arena next, back to back
+            size_t offset = nameArenaLength;
+            for (int k = 0; k < count; k++) {
+                items[start + k].nameOffset = (uint32_t)offset;
+                offset += (unsigned char)data[k] + 1;
+            }
+            return count;
+        }
+    }
+}
+
+// Function to save the whole table (rows, category dictionary and bitmaps, ID index) as a binary snapshot.
+// Deleted slots are compacted away first so the index and bitmaps can be stored exactly as they are in memory.
+void saveSnapshot(const char *filename, int rank, int size) {
+    char shardName[PATH_MAX], tempName[PATH_MAX];
+    // Every rank keeps its own shard
+    if (snprintf(shardName, sizeof(shardName), "%s.%d", filename, rank) >= (int)sizeof(shardName)
+        || snprintf(tempName, sizeof(tempName), "%s.tmp", shardName) >= (int)sizeof(tempName)) {
+        fprintf(stderr, "Error exporting snapshot: file name too long: %s\n", filename);
+        return;
+    }
+    compactItems();
+    compactNames();
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES + (long long)nameArenaLength);
+
+    FILE *file = fopen(tempName, "wb");
+    char *buffer = malloc(sizeof(int) * SNAPSHOT_BLOCK_ROWS);
+    if (!file || !buffer) {
+        perror("Error exporting snapshot");
+        if (file) fclose(file);
+        free(buffer);
+        return;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.itemCount = itemCount;
+    header.categoryCount = categoryCount;
+    header.indexCapacity = idIndexCapacity;
+    header.shard = rank;
+    header.walSequence = walSequence;
+    header.nameBytes = nameArenaLength;
+    header.shardCount = size;
+    fwrite(&header, sizeof(header), 1, file); // Rewritten with the checksum at the end
+
+    uint64_t checksum = SNAPSHOT_CHECKSUM_SEED;
+    writeSnapshotSection(file, categoryNames, sizeof(categoryNames[0]) * categoryCount, &checksum);
+    writeSnapshotSection(file, categoryItemCount, sizeof(int) * categoryCount, &checksum);
+    for (int field = 0; field < SNAPSHOT_FIELDS; field++) {
+        for (int start = 0; start < itemCount; start += SNAPSHOT_BLOCK_ROWS) {
+            int count = itemCount - start < SNAPSHOT_BLOCK_ROWS ? itemCount - start : SNAPSHOT_BLOCK_ROWS;
+            writeSnapshotSection(file, buffer, gatherSnapshotBlock(field, start, count, buffer), &checksum);
+        }
+    }
+    writeSnapshotSection(file, nameArena, nameArenaLength, &checksum);
+    for (int c = 0; c < categoryCount; c++) {
+        writeSnapshotSection(file, categoryRows[c], sizeof(uint64_t) * ((itemCount + 63) / 64), &checksum);
+    }
+    writeSnapshotSection(file, idIndex, sizeof(IndexSlot) * idIndexCapacity, &checksum);
+    free(buffer);
+
+    header.checksum = checksum;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    if (ferror(file) | fclose(file) || rename(tempName, shardName) != 0) {
+        perror("Error exporting snapshot");
+        remove(tempName);
+        return;
+    }
+    printf("\nSnapshot of %d items written to %s.\n", itemCount, shardName);
+}
+
+// Function to map a snapshot and check its header, size and checksum without touching the table.
+// Returns 1 if the snapshot can be restored, otherwise prints why and returns 0.
+int openSnapshot(const char *filename, MappedFile *snapshot, int rank, int size) {
+    char shardName[PATH_MAX];
+    // Every rank keeps its own shard
+    if (snprintf(shardName, sizeof(shardName), "%s.%d", filename, rank) >= (int)sizeof(shardName)) {
+        fprintf(stderr, "Cannot use snapshot %s: file name too long.\n", filename);
+        return 0;
+    }
+    if (access(shardName, R_OK) != 0) {
+        perror("Error opening snapshot");
+        return 0;
+    }
+    mapFile(shardName, snapshot);
+
+    const SnapshotHeader *header = (const SnapshotHeader *)snapshot->data;
+    const char *problem = NULL;
+    if (snapshot->size < sizeof(SnapshotHeader) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a snapshot file";
+    } else if (header->version != SNAPSHOT_VERSION) {
+        problem = "unsupported snapshot version";
+    } else if (header->shard != (uint32_t)rank || header->shardCount != (uint32_t)size) {
+        problem = "snapshot was written by a different shard layout";
+    } else if (header->categoryCount > MAX_CATEGORIES || header->itemCount > MAX_ITEMS
+               || header->indexCapacity < MIN_INDEX_CAPACITY || (header->indexCapacity & (header->indexCapacity - 1))
+               || header->indexCapacity <= header->itemCount
+               || header->nameBytes > (uint64_t)header->itemCount * (NAME_MAX_LENGTH + 1)) {
+        problem = "corrupt snapshot header";
+    } else {
+        size_t n = header->itemCount;
+        size_t lengthsAt = sizeof(SnapshotHeader)
+            + snapshotPadded(sizeof(categoryNames[0]) * header->categoryCount)
+            + snapshotPadded(sizeof(int) * header->categoryCount)
+            + snapshotPadded(sizeof(int) * n) * 2 + snapshotPadded(sizeof(float) * n) + snapshotPadded(n);
+        size_t namesAt = lengthsAt + snapshotPadded(n);
+        size_t expected = namesAt + snapshotPadded(header->nameBytes)
+            + sizeof(uint64_t) * ((n + 63) / 64) * header->categoryCount
+            + sizeof(IndexSlot) * header->indexCapacity;
+        if (snapshot->size != expected) {
+            problem = "truncated snapshot";
+        } else if (snapshotChecksum(SNAPSHOT_CHECKSUM_SEED, snapshot->data + sizeof(SnapshotHeader),
+                                    snapshot->size - sizeof(SnapshotHeader)) != header->checksum) {
+            problem = "snapshot checksum mismatch";
+        } else if (!snapshotNamesValid((const unsigned char *)snapshot->data + lengthsAt, snapshot->data + namesAt, n,
+                                       header->nameBytes)) {
+            problem = "corrupt snapshot names";
+        }
+    }
+
+    if (problem) {
+        fprintf(stderr, "Cannot use snapshot %s: %s.\n", shardName, problem);
+        unmapFile(snapshot);
+        return 0;
+    }
+    return 1;
+}
+
+// Function to fill the (empty) table from a snapshot accepted by openSnapshot, then unmap it
+void restoreSnapshot(MappedFile *snapshot) {
+    const SnapshotHeader *header = (const SnapshotHeader *)snapshot->data;
+    const char *p = snapshot->data + sizeof(SnapshotHeader);
+    int n = (int)header->itemCount;
+    if (n > itemCapacity) {
+        reserveRows(n);
+    }
+
+    const char (*names)[50] = (const char (*)[50])p;
+    for (int c = 0; c < (int)header->categoryCount; c++) {
+        char name[50];
+        memcpy(name, names[c], sizeof(name));
+        name[sizeof(name) - 1] = '\0';
+        internCategory(name);
+    }
+    p += snapshotPadded(sizeof(categoryNames[0]) * header->categoryCount);
+    memcpy(categoryItemCount, p, sizeof(int) * header->categoryCount);
+    p += snapshotPadded(sizeof(int) * header->categoryCount);
+
+    for (int field = 0; field < SNAPSHOT_FIELDS; field++) {
+        p += snapshotPadded(scatterSnapshotBlock(field, 0, n, p));
+    }
+    reserveNames(header->nameBytes);
+    memcpy(nameArena + nameArenaLength, p, header->nameBytes);
+    nameArenaLength += header->nameBytes;
+    p += snapshotPadded(header->nameBytes);
+    for (int c = 0; c < categoryCount; c++) {
+        memcpy(categoryRows[c], p, sizeof(uint64_t) * ((n + 63) / 64));
+        p += sizeof(uint64_t) * ((n + 63) / 64);
+    }
+
+    indexAllocate((int)header->indexCapacity);
+    memcpy(idIndex, p, sizeof(IndexSlot) * idIndexCapacity);
+    idIndexCount = n;
+    itemCount = n;
+    tombstoneCount = 0;
+    walSequence = header->walSequence;
+    unmapFile(snapshot);
+    buildNameIndex();
+    rebuildAggregates();
+}
+
+void stockAlert(int rank, int size) {
+    if (rank == 0) {
+        printf("\nLow Stock Alert:\n");
+    }
+    // The writes keep lowStockRows current, so each rank only walks its set bits
+    TextBuffer text = {0};
+    int found = 0, totalFound = 0, words = (itemCount + 63) / 64;
+    noteWork(lowStockCount, (long long)lowStockCount * ITEM_BYTES);
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = lowStockRows[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            textAppend(&text, "ID: %d | Name: %s | Category: %s | Quantity: %d | Threshold: %d\n", 
+                       ITEM_ID(i), ITEM_NAME(i), ITEM_CATEGORY_NAME(i), ITEM_QUANTITY(i), categoryThreshold[ITEM_CATEGORY(i)]);
+            found++;
+        }
+    }
+    printGathered(&text, rank, size);
+    MPI_Reduce(&found, &totalFound, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0 && !totalFound) {
+        printf("No items with low stock.\n");
+    }
+    free(text.data);
+}
+
+void printItems(int rank, int size) {
+    if (rank == 0) {
+        printf("\n================= Current Warehouse Items =================\n");
+        printf("| %-5s | %-15s | %-15s | %-10s | %-10s |\n", "ID", "Name", "Category", "Quantity", "Price");
+        printf("|----------------------------------------------------------|\n");
+    }
+    TextBuffer text = {0};
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES);
+    if (listColumn >= 0) {
+        // After a sort, list every shard merged into one order; rank r holds the r-th slice of it. A write
+        // lands on one rank but can move rows between any slices, so all ranks sort again if one dropped its slice.
+        int kept = sortedSlice != NULL;
+        MPI_Allreduce(MPI_IN_PLACE, &kept, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (!kept) {
+            sortAllShards(listColumn, listDescending, rank, size);
+        }
+        for (int i = 0; i < sortedSliceCount; i++) {
+            textAppend(&text, "| %-5d | %-15s | %-15s | %-10d | %-10.2f |\n", 
+                       sortedSlice[i].id, sortedSlice[i].name, sortedSlice[i].category, sortedSlice[i].quantity,
+                       sortedSlice[i].price);
+        }
+    } else {
+        for (int i = 0; i < itemCount; i++) {
+            if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+            textAppend(&text, "| %-5d | %-15s | %-15s | %-10d | %-10.2f |\n", 
+                       ITEM_ID(i), ITEM_NAME(i), ITEM_CATEGORY_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
+        }
+    }
+    printGathered(&text, rank, size);
+    if (rank == 0) {
+        printf("===========================================================\n");
+    }
+    free(text.data);
+}
+
+// Function to return a live row's value (quantity * price) in fixed-point aggregate units
+long long rowValueUnits(int row) {
+    double value = (double)ITEM_QUANTITY(row) * ITEM_PRICE(row) * VALUE_SCALE;
+    return (long long)(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+// Function to add (sign 1) or remove (sign -1) a live row's share of the running aggregates
+void aggregateRow(int row, int sign) {
+    long long value = sign * rowValueUnits(row);
+    totalValueUnits += value;
+    categoryValueUnits[ITEM_CATEGORY(row)] += value;
+    lowStockCount += sign * isLowStock(row);
+}
+
+// Function to add or remove the share of every live row in [begin, end); bulk updates call it around each chunk
+void aggregateRows(int begin, int end, int sign) {
+    for (int i = begin; i < end; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID) {
+            aggregateRow(i, sign);
+        }
+    }
+}
+
+// Function to compute the aggregates with a full rescan of the table
+void sumAggregates(long long *total, long long *categoryValues, int *lowStock) {
+    *total = 0;
+    *lowStock = 0;
+    memset(categoryValues, 0, sizeof(long long) * MAX_CATEGORIES);
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES);
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+        long long value = rowValueUnits(i);
+        *total += value;
+        categoryValues[ITEM_CATEGORY(i)] += value;
+        *lowStock += isLowStock(i);
+    }
+}
+
+// Function to read the running aggregates
+void readAggregates(long long *total, long long *categoryValues, int *lowStock) {
+    *total = totalValueUnits;
+    memcpy(categoryValues, categoryValueUnits, sizeof(long long) * MAX_CATEGORIES);
+    *lowStock = lowStockCount;
+}
+
+// Function to recompute the running aggregates from the rows, after loading or restoring a table
+void rebuildAggregates() {
+    sumAggregates(&totalValueUnits, categoryValueUnits, &lowStockCount);
+    rebuildLowStockRows();
+}
+
+// Function to cross-check the running aggregates against a full rescan, reporting and repairing any difference.
+// Returns 1 when they agreed.
+int checkAggregates() {
+    long long total, categoryValues[MAX_CATEGORIES], expectedTotal, expectedValues[MAX_CATEGORIES];
+    int lowStock, expectedLowStock;
+    readAggregates(&total, categoryValues, &lowStock);
+    sumAggregates(&expectedTotal, expectedValues, &expectedLowStock);
+
+    int agreed = total == expectedTotal && lowStock == expectedLowStock;
+    for (int c = 0; c < categoryCount; c++) {
+        if (categoryValues[c] != expectedValues[c]) {
+            printf("Aggregate mismatch: category '%s' value %.4f, rescan %.4f\n", categoryNames[c],
+                   (double)categoryValues[c] / VALUE_SCALE, (double)expectedValues[c] / VALUE_SCALE);
+            agreed = 0;
+        }
+    }
+    if (total != expectedTotal) {
+        printf("Aggregate mismatch: total value %.4f, rescan %.4f\n", (double)total / VALUE_SCALE, (double)expectedTotal / VALUE_SCALE);
+    }
+    if (lowStock != expectedLowStock) {
+        printf("Aggregate mismatch: low stock count %d, rescan %d\n", lowStock, expectedLowStock);
+    }
+    if (!agreed) {
+        rebuildAggregates();
+    }
+    return agreed;
+}
+
+// Function to tell whether a live row is below its category's reorder threshold
+int isLowStock(int row) {
+    return ITEM_QUANTITY(row) < categoryThreshold[ITEM_CATEGORY(row)];
+}
+
+// Function to queue an alert for a row that just crossed its threshold (low set) or came back above it
+void queueStockAlert(int row, int low) {
+    if (alertCount++ >= ALERT_QUEUE_SIZE) {
+        return;
+    }
+    StockAlert *alert = &alertQueue[alertCount - 1];
+    alert->id = ITEM_ID(row);
+    strcpy(alert->name, ITEM_NAME(row));
+    alert->quantity = ITEM_QUANTITY(row);
+    alert->threshold = categoryThreshold[ITEM_CATEGORY(row)];
+    alert->low = low;
+}
+
+// Function to bring a live row's low-stock bit in line with the row after a write, queueing an alert if it flips
+void trackStock(int row) {
+    uint64_t bit = (uint64_t)1 << (row & 63);
+    int low = isLowStock(row);
+    if (low != ((lowStockRows[row >> 6] & bit) != 0)) {
+        lowStockRows[row >> 6] ^= bit;
+        queueStockAlert(row, low);
+    }
+}
+
+// Function to track every live row in [begin, end); bulk updates call it after each chunk
+void trackStockRows(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID) {
+            trackStock(i);
+        }
+    }
+}
+
+// Function to clear a row's low-stock bit without an alert, when the row is deleted or moved. Returns the old bit.
+int untrackStock(int row) {
+    uint64_t bit = (uint64_t)1 << (row & 63);
+    int low = (lowStockRows[row >> 6] & bit) != 0;
+    lowStockRows[row >> 6] &= ~bit;
+    return low;
+}
+
+// Function to recompute the low-stock set from the rows, without alerts
+void rebuildLowStockRows() {
+    // Clear the whole capacity so bits of rows past a shrunk itemCount go too
+    memset(lowStockRows, 0, sizeof(uint64_t) * ((itemCapacity + 63) / 64));
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID && isLowStock(i)) {
+            lowStockRows[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+    }
+}
+
+// Function to change a category's reorder threshold on this rank. Only the category's own rows are visited,
+// and those that cross the new threshold either way are alerted like any other write.
+void setCategoryThreshold(int code, int threshold) {
+    int words = (itemCount + 63) / 64;
+    noteWork(categoryItemCount[code], (long long)categoryItemCount[code] * ITEM_BYTES);
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = categoryRows[code][w]; bits; bits &= bits - 1) {
+            aggregateRow(w * 64 + __builtin_ctzll(bits), -1);
+        }
+    }
+    categoryThreshold[code] = threshold;
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = categoryRows[code][w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            aggregateRow(i, 1);
+            trackStock(i);
+        }
+    }
+}
+
+// Function to show every rank's alert queue on rank 0 and empty them. Every rank must call it.
+void printStockAlerts(FILE *out, int rank, int size) {
+    TextBuffer text = {0};
+    for (int a = 0; a < alertCount && a < ALERT_QUEUE_SIZE; a++) {
+        StockAlert *alert = &alertQueue[a];
+        if (alert->low) {
+            textAppend(&text, "Stock alert: item %d (%s) is at %d, below its reorder threshold of %d.\n",
+                       alert->id, alert->name, alert->quantity, alert->threshold);
+        } else {
+            textAppend(&text, "Restocked: item %d (%s) is at %d, back at or above its reorder threshold of %d.\n",
+                       alert->id, alert->name, alert->quantity, alert->threshold);
+        }
+    }
+    if (alertCount > ALERT_QUEUE_SIZE) {
+        textAppend(&text, "...and %d more threshold crossings; see View Stock Alerts for the current list.\n", alertCount - ALERT_QUEUE_SIZE);
+    }
+    writeGathered(&text, out, rank, size);
+    free(text.data);
+    discardStockAlerts();
+}
+
+// Function to empty the alert queue without showing it, e.g. after a WAL replay re-applied old writes
+void discardStockAlerts() {
+    alertCount = 0;
+}
+
+// Function to display the dashboard: total value, item and low-stock counts, and value and count per category
+void calculateTotalValue(int rank, int size) {
+    // Every rank reads its shard's running aggregates, so no rank scans; rank 0 combines them
+    long long value, categoryValues[MAX_CATEGORIES], totalValue = 0;
+    int lowStock, totalLowStock = 0, totalItems = 0;
+    readAggregates(&value, categoryValues, &lowStock);
+    MPI_Reduce(&value, &totalValue, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&lowStock, &totalLowStock, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&idIndexCount, &totalItems, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    CategoryTotal local[MAX_CATEGORIES];
+    int localCount = 0;
+    for (int c = 0; c < categoryCount; c++) {
+        if (categoryItemCount[c] > 0) {
+            memset(local[localCount].name, 0, sizeof(local[localCount].name));
+            strcpy(local[localCount].name, categoryNames[c]);
+            local[localCount].count = categoryItemCount[c];
+            local[localCount].threshold = categoryThreshold[c];
+            local[localCount].value = categoryValues[c];
+            localCount++;
+        }
     }
-
-    for (int i = rank; i < 20; i += size) {
-        loadData(filenames[i]);
+    int bytes = localCount * (int)sizeof(CategoryTotal), totalBytes = 0;
+    int *lengths = NULL, *offsets = NULL;
+    CategoryTotal *gathered = NULL;
+    if (rank == 0) {
+        lengths = malloc(sizeof(int) * size);
+        offsets = malloc(sizeof(int) * size);
+        if (!lengths || !offsets) {
+            perror("Memory allocation failed");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
     }
-}
-
-void loadData(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
+    MPI_Gather(&bytes, 1, MPI_INT, lengths, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            offsets[r] = totalBytes;
+            totalBytes += lengths[r];
+        }
+        gathered = malloc(totalBytes ? totalBytes : 1);
+        if (!gathered) {
+            perror("Memory allocation failed");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
     }
+    MPI_Gatherv(local, bytes, MPI_BYTE, gathered, lengths, offsets, MPI_BYTE, 0, MPI_COMM_WORLD);
 
-    char line[MAX_LINE_LENGTH];
-    while (fgets(line, sizeof(line), file)) {
-        Item item;
-        if (sscanf(line, "%d,%49[^,],%49[^,],%d,%f", &item.id, item.name, item.category, &item.quantity, &item.price) == 5) {
-            if (itemCount >= itemCapacity) {
-                itemCapacity *= 2;
-                items = realloc(items, sizeof(Item) * itemCapacity);
-                if (!items) {
-                    perror("Memory allocation failed");
-                    exit(EXIT_FAILURE);
-                }
+    if (rank == 0) {
+        // Fold the ranks' entries into the first one seen for each name
+        CategoryTotal merged[MAX_CATEGORIES];
+        int mergedCount = 0;
+        for (int g = 0; g < totalBytes / (int)sizeof(CategoryTotal); g++) {
+            int m = 0;
+            while (m < mergedCount && strcmp(merged[m].name, gathered[g].name) != 0) m++;
+            if (m == mergedCount) {
+                if (mergedCount == MAX_CATEGORIES) continue;
+                merged[mergedCount++] = gathered[g];
+            } else {
+                merged[m].count += gathered[g].count;
+                merged[m].value += gathered[g].value;
             }
-            items[itemCount++] = item;
         }
-    }
-    fclose(file);
-}
 
-void addItem(int id, const char *name, const char *category, int quantity, float price) {
-    if (itemCount >= itemCapacity) {
-        itemCapacity *= 2;
-        items = realloc(items, sizeof(Item) * itemCapacity);
-        if (!items) {
-            perror("Memory allocation failed");
-            exit(EXIT_FAILURE);
+        printf("\nTotal value of all items: %.2f\n", (double)totalValue / VALUE_SCALE);
+        printf("Items: %d | Low stock (below reorder threshold): %d\n", totalItems, totalLowStock);
+        printf("| %-15s | %-10s | %-15s | %-10s |\n", "Category", "Items", "Value", "Threshold");
+        printf("|-----------------------------------------------------------|\n");
+        for (int m = 0; m < mergedCount; m++) {
+            printf("| %-15s | %-10d | %-15.2f | %-10d |\n", merged[m].name, merged[m].count,
+                   (double)merged[m].value / VALUE_SCALE, merged[m].threshold);
         }
     }
+    free(lengths);
+    free(offsets);
+    free(gathered);
 
-    items[itemCount].id = id;
-    strncpy(items[itemCount].name, name, sizeof(items[itemCount].name) - 1);
-    strncpy(items[itemCount].category, category, sizeof(items[itemCount].category) - 1);
-    items[itemCount].quantity = quantity;
-    items[itemCount].price = price;
-    itemCount++;
-    printf("\nItem added successfully.\n");
+    if (verifyAggregates) {
+        // Each rank rescans its own shard in parallel with the others
+        double start = MPI_Wtime();
+        int agreed = checkAggregates(), allAgreed = 0;
+        double elapsed = MPI_Wtime() - start, slowest = 0;
+        MPI_Reduce(&agreed, &allAgreed, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            printf("%s (rescan took %.3f seconds)\n", allAgreed ? "Aggregates match a full rescan on every rank" : "Aggregates rebuilt from a full rescan",
+                   slowest);
+        }
+    }
 }
 
-void deleteItem(int id) {
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].id == id) {
-            for (int j = i; j < itemCount - 1; j++) {
-                items[j] = items[j + 1];
+void viewItemsByCategory(const char *category, int rank, int size) {
+    // Walk the category's bitmap one word at a time so rows of other categories are never touched;
+    // each rank lists its own shard and the counts and values are summed on rank 0
+    TextBuffer text = {0};
+    long long value = 0, totalValue = 0;
+    int count = 0, totalCount = 0;
+    int code = findCategory(category);
+    if (code >= 0) {
+        int words = (itemCount + 63) / 64;
+        noteWork(categoryItemCount[code], (long long)categoryItemCount[code] * ITEM_BYTES);
+        for (int w = 0; w < words; w++) {
+            uint64_t bits = categoryRows[code][w];
+            while (bits) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                textAppend(&text, "| %-5d | %-15s | %-10d | %-10.2f |\n", 
+                           ITEM_ID(i), ITEM_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
             }
-            itemCount--;
-            printf("\nItem deleted successfully.\n");
-            return;
         }
+        count = categoryItemCount[code];
+        value = categoryValueUnits[code];
     }
-    printf("\nError: Item with ID %d not found.\n", id);
-}
+    MPI_Reduce(&count, &totalCount, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&value, &totalValue, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&totalCount, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-void retrieveItem(int id) {
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].id == id) {
-            printf("\nItem Details:\n");
-            printf("ID: %d\nName: %s\nCategory: %s\nQuantity: %d\nPrice: %.2f\n", 
-                   items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-            return;
+    if (totalCount == 0) {
+        if (rank == 0) {
+            printf("\nNo items found in category '%s'.\n", category);
+            printf("===========================================================\n");
         }
+        free(text.data);
+        return;
+    }
+    if (rank == 0) {
+        printf("\nItems in Category '%s':\n", category);
+        printf("| %-5s | %-15s | %-10s | %-10s |\n", "ID", "Name", "Quantity", "Price");
+        printf("|----------------------------------------------------------|\n");
     }
-    printf("\nError: Item with ID %d not found.\n", id);
+    printGathered(&text, rank, size);
+    if (rank == 0) {
+        printf("|----------------------------------------------------------|\n");
+        printf("%d items, total value %.2f\n", totalCount, (double)totalValue / VALUE_SCALE);
+        printf("===========================================================\n");
+    }
+    free(text.data);
 }
 
-void updateItem(int id, const char *name, const char *category, int quantity, float price) {
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].id == id) {
-            if (name) strncpy(items[i].name, name, sizeof(items[i].name) - 1);
-            if (category) strncpy(items[i].category, category, sizeof(items[i].category) - 1);
-            if (quantity >= 0) items[i].quantity = quantity;
-            if (price >= 0) items[i].price = price;
-            printf("\nItem updated successfully.\n");
-            return;
-        }
-    }
-    printf("\nError: Item with ID %d not found.\n", id);
+// Function to read the monotonic clock in nanoseconds
+uint64_t monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
 }
 
-void processBulkUpdates(int increment) {
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+// Function to charge the operation being timed with rows scanned and bytes of row storage touched
+void noteWork(long long rows, long long bytes) {
+    workRows += rows;
+    workBytes += bytes;
+}
 
-    clock_t start_time, end_time;
-    double processing_time;
-    double sleep_time = 0.0;
+// Function to start timing an operation
+OpTimer startOp(int op) {
+    OpTimer timer = {op, monotonicNs(), workRows, workBytes};
+    return timer;
+}
 
-    // Load balancing: Divide the items among processes
-    int itemsPerProcess = itemCount / size;
-    int startItem = rank * itemsPerProcess;
-    int endItem = (rank == size - 1) ? itemCount : startItem + itemsPerProcess;
-    
+// Function to map a latency onto its histogram bucket
+int latencyBucket(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (int)ns;
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    int bucket = (exponent - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS +
+                 (int)((ns >> (exponent - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
 
-    start_time = clock();
+// Function to return the largest latency that falls into a bucket
+uint64_t bucketHighest(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    return ((uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS + 1) << shift) - 1;
+}
 
-    // Update quantities for assigned items
-    for (int i = startItem; i < endItem; i++) {
-        items[i].quantity += increment;
+// Function to record the end of an operation in the calling rank's metrics
+void finishOp(const OpTimer *timer) {
+    if (timer->op == OP_NONE) {
+        return;
+    }
+    uint64_t ns = monotonicNs() - timer->startNs;
+    OpMetrics *metrics = &opMetrics[timer->op];
+    metrics->count++;
+    metrics->totalNs += ns;
+    if (ns > metrics->maxNs) metrics->maxNs = ns;
+    metrics->rows += workRows - timer->rows;
+    metrics->bytes += workBytes - timer->bytes;
+    metrics->buckets[latencyBucket(ns)]++;
+}
 
-        if (i % 100000 == 0) {
-            sleep_time += 2.0;
-            printf("\nProcessing done for %d items.\n", i);
-            sleep(2);
+// Function to return the latency that permille thousandths of an operation's calls stayed within: the upper
+// bound of the bucket holding that rank, capped at the slowest call
+uint64_t latencyPercentile(const OpMetrics *metrics, int permille) {
+    uint64_t rank = (metrics->count * permille + 999) / 1000, seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += metrics->buckets[b];
+        if (seen > 0 && seen >= rank) {
+            uint64_t highest = bucketHighest(b);
+            return highest < metrics->maxNs ? highest : metrics->maxNs;
         }
     }
+    return metrics->maxNs;
+}
 
-    // Synchronize all processes before calculating time
-    MPI_Barrier(MPI_COMM_WORLD);
+// Function to copy this rank's metrics of every operation into merged[OP_COUNT]
+void mergeMetrics(OpMetrics *merged) {
+    memcpy(merged, opMetrics, sizeof(opMetrics));
+}
 
-    end_time = clock();
+// Function to sum every rank's metrics into merged[OP_COUNT] on rank 0. A command that runs on every rank is
+// counted once per rank; the slowest call is the largest of the ranks' maxima.
+void gatherMetrics(OpMetrics *merged, int rank) {
+    uint64_t maxNs[OP_COUNT], slowest[OP_COUNT];
+    for (int op = 0; op < OP_COUNT; op++) {
+        maxNs[op] = opMetrics[op].maxNs;
+    }
+    MPI_Reduce(opMetrics, merged, OP_COUNT * (int)(sizeof(OpMetrics) / sizeof(uint64_t)), MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(maxNs, slowest, OP_COUNT, MPI_UINT64_T, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int op = 0; op < OP_COUNT; op++) {
+            merged[op].maxNs = slowest[op];
+        }
+    }
+}
 
-    processing_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
-    double total_time = processing_time + sleep_time;
+// Function to append one CSV line per operation timed so far (prefix, then operation,count,mean_us,p50_us,p99_us,
+// max_us,rows_scanned,bytes_touched). Returns the number of lines.
+int formatStats(const OpMetrics *merged, const char *prefix, TextBuffer *out) {
+    int listed = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        const OpMetrics *metrics = &merged[op];
+        if (metrics->count == 0) continue;
+        textAppend(out, "%s%s,%llu,%.3f,%.3f,%.3f,%.3f,%llu,%llu\n", prefix, opNames[op], (unsigned long long)metrics->count,
+                   metrics->totalNs / 1e3 / metrics->count, latencyPercentile(metrics, 500) / 1e3,
+                   latencyPercentile(metrics, 990) / 1e3, metrics->maxNs / 1e3, (unsigned long long)metrics->rows,
+                   (unsigned long long)metrics->bytes);
+        listed++;
+    }
+    return listed;
+}
 
+// Function to print the count, latency percentiles and work of every operation timed so far, summed over the ranks
+void showStats(int rank, int size) {
+    OpMetrics *merged = malloc(sizeof(OpMetrics) * OP_COUNT);
+    if (!merged) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    gatherMetrics(merged, rank);
     if (rank == 0) {
-        printf("\nBulk update completed: Incremented all quantities by %d.\n", increment);
-        printf("Total processing time: %.2f seconds\n", total_time);
+        printf("\n======================================= Operation Stats =======================================\n");
+        printf("| %-15s | %8s | %10s | %10s | %10s | %12s | %14s |\n", "Operation", "Count", "p50 (us)", "p99 (us)",
+               "Max (us)", "Rows scanned", "Bytes touched");
+        printf("|---------------------------------------------------------------------------------------------|\n");
+        int listed = 0;
+        for (int op = 0; op < OP_COUNT; op++) {
+            const OpMetrics *metrics = &merged[op];
+            if (metrics->count == 0) continue;
+            printf("| %-15s | %8llu | %10.1f | %10.1f | %10.1f | %12llu | %14llu |\n", opNames[op],
+                   (unsigned long long)metrics->count, latencyPercentile(metrics, 500) / 1e3,
+                   latencyPercentile(metrics, 990) / 1e3, metrics->maxNs / 1e3, (unsigned long long)metrics->rows,
+                   (unsigned long long)metrics->bytes);
+            listed++;
+        }
+        if (!listed) {
+            printf("No operations timed yet.\n");
+        }
+        printf("===============================================================================================\n");
+        printf("Counts include every rank's part of an operation (%d ranks).\n", size);
     }
+    free(merged);
 }
 
-void searchItems(const char *keyword) {
-    printf("\nSearch Results for '%s':\n", keyword);
-    int found = 0;
-    for (int i = 0; i < itemCount; i++) {
-        if (strstr(items[i].name, keyword)) {
-            printf("ID: %d | Name: %s | Category: %s | Quantity: %d | Price: %.2f\n", 
-                   items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-            found = 1;
-        }
+// Function to create this rank's --stats-file (FILE.rank) and write its header
+void openStatsFile(int rank) {
+    char statsName[PATH_MAX];
+    if (snprintf(statsName, sizeof(statsName), "%s.%d", statsFile, rank) >= (int)sizeof(statsName)) {
+        fprintf(stderr, "Error: --stats-file name too long: %s\n", statsFile);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    if (!found) {
-        printf("No items found matching '%s'.\n", keyword);
+    statsOutput = fopen(statsName, "w");
+    if (!statsOutput) {
+        perror("Error opening stats file");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
+    fputs("elapsed_seconds,operation,count,mean_us,p50_us,p99_us,max_us,rows_scanned,bytes_touched\n", statsOutput);
+    lastStatsDump = MPI_Wtime();
 }
 
-void sortItemsByPrice() {
-    for (int i = 0; i < itemCount - 1; i++) {
-        for (int j = 0; j < itemCount - i - 1; j++) {
-            if (items[j].price > items[j + 1].price) {
-                Item temp = items[j];
-                items[j] = items[j + 1];
-                items[j + 1] = temp;
-            }
-        }
+// Function to append this rank's metrics to its --stats-file, one line per operation, once statsInterval seconds
+// have passed since the last dump (or right away when force is set). Counters are cumulative since the start.
+// Ranks dump on their own clocks, so no rank ever waits for another here.
+void dumpStats(int force) {
+    double now = MPI_Wtime();
+    if (!statsOutput || (!force && now - lastStatsDump < statsInterval)) {
+        return;
+    }
+    lastStatsDump = now;
+
+    OpMetrics *merged = malloc(sizeof(OpMetrics) * OP_COUNT);
+    if (!merged) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    mergeMetrics(merged);
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%.3f,", now - statsStart);
+    TextBuffer text = {0};
+    formatStats(merged, prefix, &text);
+    if (text.length) {
+        fwrite(text.data, 1, text.length, statsOutput);
     }
-    printf("\nItems sorted by price.\n");
+    fflush(statsOutput);
+    free(text.data);
+    free(merged);
 }
 
-void logOperation(const char *operation, const char *details) {
-    FILE *logFile = fopen("warehouse_log.txt", "a");
-    if (!logFile) {
-        perror("Error opening log file");
-        return;
+// Function to write a final dump and close this rank's --stats-file
+void closeStatsFile() {
+    if (statsOutput) {
+        dumpStats(1);
+        fclose(statsOutput);
+        statsOutput = NULL;
     }
-    fprintf(logFile, "%s: %s\n", operation, details);
-    fclose(logFile);
 }
 
-void exportData(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        perror("Error exporting data");
+void displayMenu() {
+    printf("\n============= Warehouse Management System =============\n");
+    printf("1. Add Item\n");
+    printf("2. Delete Item\n");
+    printf("3. Retrieve Item\n");
+    printf("4. Update Item\n");
+    printf("5. Process Bulk Updates\n");
+    printf("6. Search for Item\n");
+    printf("7. Sort Items\n");
+    printf("8. View Stock Alerts\n");
+    printf("9. Print All Items\n");
+    printf("10. Export Data\n");
+    printf("11. View Items by Category\n");
+    printf("12. Calculate Total Value of All Items\n");
+    printf("13. Exit\n");
+    printf("14. Compact Deleted Slots\n");
+    printf("15. Export Snapshot\n");
+    printf("16. Filtered Bulk Update\n");
+    printf("17. Show Lowest/Highest Items\n");
+    printf("18. Set Reorder Threshold\n");
+    printf("19. Show Operation Stats\n");
+    printf("=========================================================\n");
+}
+
+// Function to make room for extra more bytes (plus a terminator) at the end of a buffer
+void textReserve(TextBuffer *buffer, size_t extra) {
+    if (buffer->length + extra < buffer->capacity) {
         return;
     }
 
-    for (int i = 0; i < itemCount; i++) {
-        fprintf(file, "%d,%s,%s,%d,%.2f\n", items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity <= buffer->length + extra) {
+        capacity *= 2;
+    }
+    buffer->data = realloc(buffer->data, capacity);
+    if (!buffer->data) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
     }
-    fclose(file);
-    printf("\nData exported successfully to %s.\n", filename);
+    buffer->capacity = capacity;
 }
 
-void stockAlert() {
-    printf("\nLow Stock Alert:\n");
-    int found = 0;
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].quantity < LOW_STOCK_THRESHOLD) {
-            printf("ID: %d | Name: %s | Category: %s | Quantity: %d\n", 
-                   items[i].id, items[i].name, items[i].category, items[i].quantity);
-            found = 1;
+// Function to append printf-style text to a buffer, growing it as needed
+void textAppend(TextBuffer *buffer, const char *format, ...) {
+    for (;;) {
+        size_t room = buffer->capacity - buffer->length;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer->data ? buffer->data + buffer->length : NULL, room, format, args);
+        va_end(args);
+        if (n < 0) {
+            return;
+        }
+        if ((size_t)n < room) {
+            buffer->length += (size_t)n;
+            return;
         }
+        textReserve(buffer, (size_t)n);
     }
-    if (!found) {
-        printf("No items with low stock.\n");
+}
+
+// Function to append raw bytes to a buffer
+void textAppendBytes(TextBuffer *buffer, const void *data, size_t size) {
+    textReserve(buffer, size);
+    if (size) {
+        memcpy(buffer->data + buffer->length, data, size);
     }
+    buffer->length += size;
+    buffer->data[buffer->length] = '\0';
 }
 
-void printItems() {
-    printf("\n================= Current Warehouse Items =================\n");
-    printf("| %-5s | %-15s | %-15s | %-10s | %-10s |\n", "ID", "Name", "Category", "Quantity", "Price");
-    printf("|----------------------------------------------------------|\n");
-    for (int i = 0; i < itemCount; i++) {
-        printf("| %-5d | %-15s | %-15s | %-10d | %-10.2f |\n", 
-               items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
+// Function to append one row to a buffer in the same CSV layout as the data files
+void appendItemText(TextBuffer *buffer, int row) {
+    textAppend(buffer, "%d,%s,%s,%d,%.2f\n", ITEM_ID(row), ITEM_NAME(row), ITEM_CATEGORY_NAME(row),
+               ITEM_QUANTITY(row), ITEM_PRICE(row));
+}
+
+// Function to copy a text field up to the next comma into out (clipped to size - 1 characters). Returns where the field ended.
+const char *copyBatchField(const char *p, const char *end, char *out, size_t size) {
+    const char *start = p;
+    while (p < end && *p != ',') p++;
+    size_t length = (size_t)(p - start) < size - 1 ? (size_t)(p - start) : size - 1;
+    memcpy(out, start, length);
+    out[length] = '\0';
+    return p;
+}
+
+// Function to parse one line of a batch stream. Returns 0 for blank and '#' comment lines, which produce no result.
+// Lines that cannot be parsed become BATCH_INVALID commands so they are still reported.
+int parseBatchCommand(const char *line, int lineNumber, BatchCommand *command) {
+    const char *end = line + strcspn(line, "\r\n");
+    if (line == end || *line == '#') {
+        return 0;
+    }
+
+    memset(command, 0, sizeof(*command));
+    command->line = lineNumber;
+    command->op = BATCH_INVALID;
+    const char *p = memchr(line, ',', end - line);
+    size_t opLength = (p ? p : end) - line;
+    p = p ? p + 1 : end;
+
+    if (opLength == 3 && strncmp(line, "add", 3) == 0) {
+        const char *name, *category;
+        int nameLength, categoryLength;
+        if (parseRow(p, end, &command->id, &name, &nameLength, &category, &categoryLength, &command->quantity, &command->price)) {
+            memcpy(command->name, name, nameLength);
+            memcpy(command->category, category, categoryLength);
+            command->op = BATCH_ADD;
+        }
+    } else if ((opLength == 3 && strncmp(line, "get", 3) == 0) || (opLength == 6 && strncmp(line, "delete", 6) == 0)) {
+        if (parseIntField(&p, end, &command->id) && p == end) {
+            command->op = line[0] == 'g' ? BATCH_GET : BATCH_DELETE;
+        }
+    } else if (opLength == 6 && strncmp(line, "search", 6) == 0) {
+        if (p < end) {
+            copyBatchField(p, end, command->name, sizeof(command->name));
+            command->op = BATCH_SEARCH;
+        }
+    } else if (opLength == 6 && strncmp(line, "update", 6) == 0) {
+        // update,ID,NAME,CATEGORY,QUANTITY,PRICE where an empty field keeps the current value
+        command->quantity = -1;
+        command->price = -1;
+        if (!parseIntField(&p, end, &command->id) || p == end || *p++ != ',') {
+            return 1;
+        }
+        p = copyBatchField(p, end, command->name, sizeof(command->name));
+        if (p == end || *p++ != ',') {
+            return 1;
+        }
+        p = copyBatchField(p, end, command->category, sizeof(command->category));
+        if (p == end || *p++ != ',') {
+            return 1;
+        }
+        if (p < end && *p != ',' && !parseIntField(&p, end, &command->quantity)) {
+            return 1;
+        }
+        if (p == end || *p++ != ',') {
+            return 1;
+        }
+        if (p < end && !parsePriceField(&p, end, &command->price)) {
+            return 1;
+        }
+        command->op = BATCH_UPDATE;
+    } else if (opLength == 5 && strncmp(line, "total", 5) == 0) {
+        command->op = p == end ? BATCH_TOTAL : BATCH_INVALID;
+    } else if (opLength == 4 && strncmp(line, "sort", 4) == 0) {
+        // sort,price|quantity|id|name[,desc]
+        static const char *columns[] = {"price", "quantity", "id", "name"};
+        char column[50];
+        p = copyBatchField(p, end, column, sizeof(column));
+        command->descending = end - p == 5 && strncmp(p, ",desc", 5) == 0;
+        if (p < end && !command->descending) {
+            return 1;
+        }
+        for (int c = 0; c < 4; c++) {
+            if (strcmp(column, columns[c]) == 0) {
+                command->mode = c;
+                command->op = BATCH_SORT;
+            }
+        }
+    } else if (opLength == 4 && strncmp(line, "bulk", 4) == 0) {
+        if (parseBatchBulk(p, end, &command->filter, &command->action)) {
+            command->op = BATCH_BULK;
+        }
+    } else if (opLength == 6 && strncmp(line, "export", 6) == 0) {
+        // export,FILENAME,csv|binary
+        p = copyBatchField(p, end, command->name, sizeof(command->name));
+        if (command->name[0] && end - p == 4 && strncmp(p, ",csv", 4) == 0) {
+            command->mode = EXPORT_CSV;
+            command->op = BATCH_EXPORT;
+        } else if (command->name[0] && end - p == 7 && strncmp(p, ",binary", 7) == 0) {
+            command->mode = EXPORT_BINARY;
+            command->op = BATCH_EXPORT;
+        }
+    } else if (opLength == 4 && strncmp(line, "time", 4) == 0) {
+        // time,LABEL reports the wall time since the previous time command (or since the program started)
+        copyBatchField(p, end, command->name, sizeof(command->name));
+        command->op = BATCH_TIME;
+    } else if (opLength == 5 && strncmp(line, "stats", 5) == 0) {
+        command->op = p == end ? BATCH_STATS : BATCH_INVALID;
     }
-    printf("===========================================================\n");
+    return 1;
 }
 
-void calculateTotalValue() {
-    clock_t start_time, end_time;
-    double processing_time;
+// Function to parse the fields of a bulk command:
+// bulk,CATEGORY,MIN_ID,MAX_ID,MIN_QUANTITY,MAX_QUANTITY,MIN_PRICE,MAX_PRICE,QUANTITY_MODE,QUANTITY,PRICE_MODE,PRICE
+// Bounds and modes read as in the filtered update menu: an empty category or a -1 bound matches anything.
+// Returns 0 if the fields are malformed.
+int parseBatchBulk(const char *p, const char *end, BulkFilter *filter, BulkAction *action) {
+    int bounds[4];
+    float priceBounds[2];
+    initBulkFilter(filter);
+    p = copyBatchField(p, end, filter->category, sizeof(filter->category));
+    for (int k = 0; k < 4; k++) {
+        if (p == end || *p++ != ',' || !parseIntField(&p, end, &bounds[k])) return 0;
+    }
+    for (int k = 0; k < 2; k++) {
+        if (p == end || *p++ != ',' || !parsePriceField(&p, end, &priceBounds[k])) return 0;
+    }
+    if (p == end || *p++ != ',' || !parseIntField(&p, end, &action->quantityMode)
+        || p == end || *p++ != ',' || !parseIntField(&p, end, &action->quantity)
+        || p == end || *p++ != ',' || !parseIntField(&p, end, &action->priceMode)
+        || p == end || *p++ != ',' || !parsePriceField(&p, end, &action->price) || p != end) {
+        return 0;
+    }
 
-    start_time = clock(); 
+    if (bounds[0] >= 0) filter->minId = bounds[0];
+    if (bounds[1] >= 0) filter->maxId = bounds[1];
+    if (bounds[2] >= 0) filter->minQuantity = bounds[2];
+    if (bounds[3] >= 0) filter->maxQuantity = bounds[3];
+    if (priceBounds[0] >= 0) filter->minPrice = priceBounds[0];
+    if (priceBounds[1] >= 0) filter->maxPrice = priceBounds[1];
+    return action->quantityMode >= BULK_KEEP && action->quantityMode <= BULK_SET
+        && action->priceMode >= BULK_KEEP && action->priceMode <= BULK_SCALE;
+}
 
-    float totalValue = 0.0;
-    for (int i = 0; i < itemCount; i++) {
-        totalValue += items[i].quantity * items[i].price;
+// Function to run one batch command, leaving its outcome in command->result and any rows in command->output.
+// Every rank runs a whole-table command together and rank 0 alone reports it; the others mark it skipped.
+void runBatchCommand(BatchCommand *command, int rank, int size) {
+    static const int batchOps[] = {OP_NONE, OP_ADD, OP_DELETE, OP_UPDATE, OP_RETRIEVE, OP_SEARCH, OP_TOTAL, OP_SORT,
+                                   OP_FILTERED_UPDATE, OP_EXPORT, OP_NONE, OP_NONE};
+    OpTimer timer = startOp(batchOps[command->op]);
+    switch (command->op) {
+        case BATCH_ADD:
+            command->result = applyAddItem(command->id, command->name, command->category, command->quantity, command->price);
+            break;
+        case BATCH_DELETE:
+            command->result = applyDeleteItem(command->id);
+            break;
+        case BATCH_UPDATE:
+            command->result = applyUpdateItem(command->id, command->name[0] ? command->name : NULL,
+                                              command->category[0] ? command->category : NULL, command->quantity, command->price);
+            break;
+        case BATCH_GET: {
+            int i = findItemRow(command->id);
+            command->result = i == INDEX_EMPTY ? RESULT_NOT_FOUND : RESULT_OK;
+            if (i != INDEX_EMPTY) {
+                appendItemText(&command->output, i);
+                command->matches = 1;
+            }
+            break;
+        }
+        case BATCH_SEARCH: {
+            int *rows;
+            int found = findNameRows(command->name, &rows);
+            command->result = RESULT_OK;
+            for (int r = 0; r < found; r++) {
+                appendItemText(&command->output, rows[r]);
+            }
+            command->matches = found;
+            free(rows);
+            break;
+        }
+        case BATCH_TOTAL: {
+            long long value, categoryValues[MAX_CATEGORIES], totalValue = 0;
+            int lowStock, totalItems = 0;
+            readAggregates(&value, categoryValues, &lowStock);
+            MPI_Reduce(&value, &totalValue, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce(&idIndexCount, &totalItems, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+            textAppend(&command->output, "%.2f %d\n", (double)totalValue / VALUE_SCALE, totalItems);
+            command->result = RESULT_OK;
+            break;
+        }
+        case BATCH_SORT:
+            sortAllShards(command->mode, command->descending, rank, size); // As after a menu sort
+            command->result = RESULT_OK;
+            break;
+        case BATCH_BULK: {
+            int plan, totalMatched = 0;
+            int matched = applyFilteredUpdate(&command->filter, &command->action, &plan, rank, size);
+            walLogFiltered(&command->filter, &command->action);
+            MPI_Reduce(&matched, &totalMatched, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+            textAppend(&command->output, "%d\n", totalMatched);
+            command->result = RESULT_OK;
+            break;
+        }
+        case BATCH_EXPORT: {
+            BulkFilter everything;
+            initBulkFilter(&everything);
+            long long rows = exportData(command->name, command->mode, &everything, rank);
+            command->result = rows < 0 ? RESULT_WRITE_FAILED : RESULT_OK;
+            if (rows >= 0) {
+                textAppend(&command->output, "%lld\n", rows);
+            }
+            break;
+        }
+        case BATCH_TIME: {
+            MPI_Barrier(MPI_COMM_WORLD); // The slowest rank sets the time
+            double now = MPI_Wtime();
+            textAppend(&command->output, "%s %.6f\n", command->name, now - batchMark);
+            batchMark = now;
+            command->result = RESULT_OK;
+            break;
+        }
+        case BATCH_STATS: {
+            OpMetrics *merged = malloc(sizeof(OpMetrics) * OP_COUNT);
+            if (!merged) {
+                perror("Memory allocation failed");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            gatherMetrics(merged, rank);
+            if (rank == 0) {
+                command->matches = formatStats(merged, "", &command->output);
+            }
+            command->result = RESULT_OK;
+            free(merged);
+            break;
+        }
+        default:
+            command->result = RESULT_INVALID_COMMAND;
+    }
+    finishOp(&timer);
+    if (command->op >= BATCH_TOTAL && rank != 0) {
+        command->result = -1;
+        command->output.length = 0;
     }
+}
 
-    end_time = clock(); 
-    processing_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
+// Function to print a command's outcome: "<line> OK" or "<line> ERROR <reason>". A get adds the row to the
+// OK line; a search adds its match count and is followed by one line per match. A total adds the value and item
+// count, a bulk update its match count, an export its row count and a time command its label and seconds.
+// A stats command adds the number of operations timed so far, followed by one formatStats() line for each.
+void printBatchResult(const BatchCommand *command) {
+    static const char *reasons[] = {"", "not found", "already exists", "reserved id", "too many categories", "invalid command",
+                                    "write failed"};
+    if (command->result != RESULT_OK) {
+        printf("%d ERROR %s\n", command->line, reasons[command->result]);
+    } else if (command->op == BATCH_SEARCH || command->op == BATCH_STATS) {
+        printf("%d OK %d\n", command->line, command->matches);
+        if (command->output.length) {
+            fwrite(command->output.data, 1, command->output.length, stdout);
+        }
+    } else if (command->output.length) {
+        printf("%d OK %.*s", command->line, (int)command->output.length, command->output.data);
+    } else {
+        printf("%d OK\n", command->line);
+    }
+}
 
-    printf("\nTotal value of all items: %.2f\n", totalValue);
-    printf("Processing time: %.2f seconds\n", processing_time);
+// Function to execute a group of batch commands in order. A point command runs only on the rank that owns
+// its id; the other ranks mark it with a negative result, which the merge on rank 0 skips. Searches and
+// whole-table commands run on every rank.
+void runBatchGroup(BatchCommand *commands, int count, int rank, int size) {
+    for (int c = 0; c < count; c++) {
+        int op = commands[c].op;
+        if (op != BATCH_SEARCH && op != BATCH_INVALID && op < BATCH_TOTAL && ownerRank(commands[c].id, size) != rank) {
+            commands[c].result = -1;
+            continue;
+        }
+        runBatchCommand(&commands[c], rank, size);
+    }
 }
 
-void viewItemsByCategory() {
-    char category[50];
-    printf("Enter category name: ");
-    if (!fgets(category, sizeof(category), stdin)) {
-        printf("Invalid input.\n");
-        return;
+// Function to run a command stream under MPI. Rank 0 reads each group of lines and broadcasts it, point
+// commands run on the rank owning their id and searches on every rank, and rank 0 gathers the per-command
+// outcomes and prints them merged: a search returns the rows found by every rank, in rank order.
+void runBatch(const char *filename, int rank, int size) {
+    FILE *input = NULL;
+    if (rank == 0) {
+        input = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+        if (!input) {
+            perror("Error opening batch file");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    BatchCommand *commands = malloc(sizeof(BatchCommand) * BATCH_GROUP_LINES);
+    char *text = malloc((size_t)BATCH_GROUP_LINES * MAX_LINE_LENGTH + 1);
+    int *lengths = malloc(sizeof(int) * size);
+    int *offsets = malloc(sizeof(int) * size);
+    if (!commands || !text || !lengths || !offsets) {
+        perror("Memory allocation failed");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    strtok(category, "\n"); 
+    TextBuffer packed = {0}, gathered = {0};
 
-    int found = 0;
-    printf("\nItems in Category '%s':\n", category);
-    printf("| %-5s | %-15s | %-10s | %-10s |\n", "ID", "Name", "Quantity", "Price");
-    printf("|----------------------------------------------------------|\n");
-    for (int i = 0; i < itemCount; i++) {
-        if (strcmp(items[i].category, category) == 0) {
-            printf("| %-5d | %-15s | %-10d | %-10.2f |\n", 
-                   items[i].id, items[i].name, items[i].quantity, items[i].price);
-            found = 1;
+    int lineNumber = 0, total = 0, failed = 0, more = 1;
+    double start = MPI_Wtime();
+    while (more) {
+        int group[2] = {0, 1}; // Bytes of text read, and whether input remains
+        if (rank == 0) {
+            for (int lines = 0; lines < BATCH_GROUP_LINES; lines++) {
+                if (!fgets(text + group[0], MAX_LINE_LENGTH, input)) {
+                    group[1] = 0;
+                    break;
+                }
+                group[0] += strlen(text + group[0]);
+            }
+        }
+        MPI_Bcast(group, 2, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Bcast(text, group[0], MPI_CHAR, 0, MPI_COMM_WORLD);
+        text[group[0]] = '\0';
+        more = group[1];
+
+        int count = 0;
+        for (const char *line = text; *line; ) {
+            if (parseBatchCommand(line, ++lineNumber, &commands[count])) {
+                count++;
+            }
+            const char *newline = strchr(line, '\n');
+            line = newline ? newline + 1 : line + strlen(line);
+        }
+        runBatchGroup(commands, count, rank, size);
+        walCommit();
+        dumpStats(0);
+        printStockAlerts(stderr, rank, size); // Keeps stdout to one result line per command
+
+        // Pack [result][matches][length][rows] per command and gather every rank's pack on rank 0
+        packed.length = 0;
+        for (int c = 0; c < count; c++) {
+            int header[3] = {commands[c].result, commands[c].matches, (int)commands[c].output.length};
+            textAppendBytes(&packed, header, sizeof(header));
+            textAppendBytes(&packed, commands[c].output.data, commands[c].output.length);
+        }
+        int packedLength = (int)packed.length;
+        MPI_Gather(&packedLength, 1, MPI_INT, lengths, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            int gatheredLength = 0;
+            for (int r = 0; r < size; r++) {
+                offsets[r] = gatheredLength;
+                gatheredLength += lengths[r];
+            }
+            gathered.length = 0;
+            textReserve(&gathered, gatheredLength);
+        }
+        MPI_Gatherv(packed.data, packedLength, MPI_CHAR, gathered.data, lengths, offsets, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+        if (rank == 0) {
+            for (int c = 0; c < count; c++) {
+                commands[c].result = -1;
+                commands[c].matches = 0;
+                commands[c].output.length = 0;
+            }
+            for (int r = 0; r < size; r++) {
+                const char *p = gathered.data + offsets[r];
+                for (int c = 0; c < count; c++) {
+                    int header[3];
+                    memcpy(header, p, sizeof(header));
+                    p += sizeof(header);
+                    if (header[0] == RESULT_OK) {
+                        commands[c].result = RESULT_OK;
+                        commands[c].matches += header[1];
+                        textAppendBytes(&commands[c].output, p, header[2]);
+                    } else if (header[0] > 0 && commands[c].result < 0) {
+                        commands[c].result = header[0];
+                    }
+                    p += header[2];
+                }
+            }
+            for (int c = 0; c < count; c++) {
+                printBatchResult(&commands[c]);
+                failed += commands[c].result != RESULT_OK;
+            }
         }
+        for (int c = 0; c < count; c++) {
+            free(commands[c].output.data);
+        }
+        total += count;
     }
-    if (!found) {
-        printf("No items found in category '%s'.\n", category);
+
+    if (rank == 0) {
+        fprintf(stderr, "Batch finished: %d commands (%d failed) in %.3f seconds.\n", total, failed, MPI_Wtime() - start);
+        if (input != stdin) fclose(input);
     }
-    printf("===========================================================\n");
+    free(commands);
+    free(text);
+    free(lengths);
+    free(offsets);
+    free(packed.data);
+    free(gathered.data);
 }
 
-void displayMenu() {
-    printf("\n============= Warehouse Management System =============\n");
-    printf("1. Add Item\n");
-    printf("2. Delete Item\n");
-    printf("3. Retrieve Item\n");
-    printf("4. Update Item\n");
-    printf("5. Process Bulk Updates\n");
-    printf("6. Search for Item\n");
-    printf("7. Sort Items by Price\n");
-    printf("8. View Stock Alerts\n");
-    printf("9. Print All Items\n");
-    printf("10. Export Data to CSV\n");
-    printf("11. View Items by Category\n");
-    printf("12. Calculate Total Value of All Items\n");
-    printf("13. Exit\n");
-    printf("=========================================================\n");
+// Function to parse command-line options
+void parseOptions(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--delete-mode=swap") == 0) {
+            deleteMode = DELETE_MODE_SWAP;
+        } else if (strcmp(argv[i], "--delete-mode=tombstone") == 0) {
+            deleteMode = DELETE_MODE_TOMBSTONE;
+        } else if (strncmp(argv[i], "--snapshot=", 11) == 0 && argv[i][11] != '\0') {
+            snapshotFile = argv[i] + 11;
+        } else if (strncmp(argv[i], "--wal=", 6) == 0 && argv[i][6] != '\0') {
+            walFile = argv[i] + 6;
+        } else if (strncmp(argv[i], "--wal-sync=", 11) == 0 && argv[i][11] >= '0' && argv[i][11] <= '9') {
+            walSyncEvery = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--files=", 8) == 0 && argv[i][8] >= '1' && argv[i][8] <= '9') {
+            dataFileCount = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--batch=", 8) == 0 && argv[i][8] != '\0') {
+            batchFile = argv[i] + 8;
+        } else if (strncmp(argv[i], "--reorder-threshold=", 20) == 0 && argv[i][20] != '\0') {
+            defaultThreshold = atoi(argv[i] + 20);
+        } else if (strcmp(argv[i], "--verify-aggregates") == 0) {
+            verifyAggregates = 1;
+        } else if (strncmp(argv[i], "--stats-file=", 13) == 0 && argv[i][13] != '\0') {
+            statsFile = argv[i] + 13;
+        } else if (strncmp(argv[i], "--stats-interval=", 17) == 0 && argv[i][17] >= '0' && argv[i][17] <= '9') {
+            statsInterval = atoi(argv[i] + 17);
+        } else if (strcmp(argv[i], "--scan-kernel=scalar") == 0) {
+            scanKernel = SCAN_SCALAR;
+        } else if (strcmp(argv[i], "--scan-kernel=sse2") == 0) {
+            scanKernel = SCAN_SSE2;
+        } else if (strcmp(argv[i], "--scan-kernel=avx2") == 0) {
+            scanKernel = SCAN_AVX2;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--delete-mode=tombstone|swap] [--snapshot=FILE] [--wal=FILE] [--wal-sync=N] [--batch=FILE|-] [--files=N] [--scan-kernel=scalar|sse2|avx2] [--reorder-threshold=N] [--verify-aggregates] [--stats-file=FILE] [--stats-interval=SECONDS]\n", argv[0]);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
 }
 
 int main(int argc, char *argv[]) {
     MPI_Init(&argc, &argv);
+    batchMark = MPI_Wtime();
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
+    statsStart = batchMark;
+    parseOptions(argc, argv);
+    if (statsFile) {
+        openStatsFile(rank); // Every rank dumps its own metrics
+    }
 
-    items = malloc(sizeof(Item) * itemCapacity);
-    if (!items) {
-        perror("Memory allocation failed");
-        exit(EXIT_FAILURE);
+    reserveRows(itemCapacity);
+
+    // Every rank must be able to use its shard of the snapshot, otherwise all ranks load the CSV files
+    MappedFile snapshot;
+    double loadStart = MPI_Wtime();
+    int snapshotOpened = snapshotFile ? openSnapshot(snapshotFile, &snapshot, rank, size) : 0, allOpened = 0;
+    MPI_Allreduce(&snapshotOpened, &allOpened, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (allOpened) {
+        restoreSnapshot(&snapshot);
+        printf("Loaded %d items from snapshot %s.%d in %.3f seconds.\n", itemCount, snapshotFile, rank, MPI_Wtime() - loadStart);
+    } else {
+        if (snapshotOpened) {
+            unmapFile(&snapshot);
+        }
+        if (rank == 0) {
+            printf("Loading data from warehouse data files...\n");
+        }
+        loadDataFromFiles(rank, size);
+        int totalItems = 0;
+        MPI_Reduce(&itemCount, &totalItems, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            printf("Data loaded successfully: %d items across %d ranks.\n", totalItems, size);
+        }
+    }
+    if (walFile) {
+        char walName[PATH_MAX];
+        // Every rank logs its own shard
+        if (snprintf(walName, sizeof(walName), "%s.%d", walFile, rank) >= (int)sizeof(walName)) {
+            fprintf(stderr, "Error: --wal file name too long: %s\n", walFile);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        walOpen(walName, rank, size);
+        discardStockAlerts(); // Replayed writes were alerted before the restart
     }
 
-    printf("Loading data from warehouse data files...\n");
-    loadDataFromFiles(rank, size);
-    printf("Data loaded successfully.\n");
+    if (batchFile) {
+        runBatch(batchFile, rank, size);
+        walClose();
+        closeStatsFile();
+        freeRows();
+        free(idIndex);
+        freeNameIndex();
+        MPI_Finalize();
+        return 0;
+    }
 
     int choice;
     do {
@@ -343,11 +4343,12 @@ int main(int argc, char *argv[]) {
         }
         MPI_Bcast(&choice, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
+        OpTimer timer = {OP_NONE, 0, 0, 0}; // Each case starts it once its input is read
         switch (choice) {
             case 1: {
                 int id, quantity;
                 float price;
-                char name[50], category[50];
+                char name[NAME_MAX_LENGTH + 1], category[50];
 
                 if (rank == 0) {
                     printf("Enter item ID: ");
@@ -365,12 +4366,13 @@ int main(int argc, char *argv[]) {
                     scanf("%f", &price);
                 }
                 MPI_Bcast(&id, 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Bcast(name, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
+                MPI_Bcast(name, sizeof(name), MPI_CHAR, 0, MPI_COMM_WORLD);
                 MPI_Bcast(category, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
                 MPI_Bcast(&quantity, 1, MPI_INT, 0, MPI_COMM_WORLD);
                 MPI_Bcast(&price, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
 
-                addItem(id, name, category, quantity, price);
+                timer = startOp(OP_ADD);
+                addItem(id, name, category, quantity, price, rank, size);
                 break;
             }
             case 2: {
@@ -380,7 +4382,8 @@ int main(int argc, char *argv[]) {
                     scanf("%d", &id);
                 }
                 MPI_Bcast(&id, 1, MPI_INT, 0, MPI_COMM_WORLD);
-                deleteItem(id);
+                timer = startOp(OP_DELETE);
+                deleteItem(id, rank, size);
                 break;
             }
             case 3: {
@@ -390,13 +4393,14 @@ int main(int argc, char *argv[]) {
                     scanf("%d", &id);
                 }
                 MPI_Bcast(&id, 1, MPI_INT, 0, MPI_COMM_WORLD);
-                retrieveItem(id);
+                timer = startOp(OP_RETRIEVE);
+                retrieveItem(id, rank, size);
                 break;
             }
             case 4: {
                 int id, quantity;
                 float price;
-                char name[50], category[50];
+                char name[NAME_MAX_LENGTH + 1], category[50];
 
                 if (rank == 0) {
                     printf("Enter item ID to update: ");
@@ -414,74 +4418,236 @@ int main(int argc, char *argv[]) {
                     scanf("%f", &price);
                 }
                 MPI_Bcast(&id, 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Bcast(name, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
+                MPI_Bcast(name, sizeof(name), MPI_CHAR, 0, MPI_COMM_WORLD);
                 MPI_Bcast(category, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
                 MPI_Bcast(&quantity, 1, MPI_INT, 0, MPI_COMM_WORLD);
                 MPI_Bcast(&price, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
 
-                updateItem(id, name[0] ? name : NULL, category[0] ? category : NULL, quantity >= 0 ? quantity : -1, price >= 0 ? price : -1);
+                timer = startOp(OP_UPDATE);
+                updateItem(id, name[0] ? name : NULL, category[0] ? category : NULL, quantity >= 0 ? quantity : -1, price >= 0 ? price : -1, rank, size);
                 break;
             }
             case 5: {
                 int increment;
+                float priceChange;
                 if (rank == 0) {
                     printf("Enter increment value for bulk update: ");
                     scanf("%d", &increment);
+                    printf("Enter price change for bulk update (0 to keep prices): ");
+                    scanf("%f", &priceChange);
                 }
                 MPI_Bcast(&increment, 1, MPI_INT, 0, MPI_COMM_WORLD);
-                processBulkUpdates(increment);
+                MPI_Bcast(&priceChange, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_BULK_UPDATE);
+                processBulkUpdates(increment, priceChange, rank);
                 break;
             }
             case 6: {
-                char keyword[50];
+                char keyword[NAME_MAX_LENGTH + 1];
                 if (rank == 0) {
-                    printf("Enter keyword to search: ");
+                    printf("Enter keyword to search (end it with * to match name prefixes): ");
                     fgets(keyword, sizeof(keyword), stdin);
                     strtok(keyword, "\n");
                 }
-                MPI_Bcast(keyword, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
-                searchItems(keyword);
+                MPI_Bcast(keyword, sizeof(keyword), MPI_CHAR, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_SEARCH);
+                searchItems(keyword, rank, size);
                 break;
             }
-            case 7:
-                sortItemsByPrice();
+            case 7: {
+                int column, order;
+                if (rank == 0) {
+                    printf("Sort by (1 = Price, 2 = Quantity, 3 = ID, 4 = Name): ");
+                    scanf("%d", &column);
+                    printf("Order (1 = Ascending, 2 = Descending): ");
+                    scanf("%d", &order);
+                }
+                MPI_Bcast(&column, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                MPI_Bcast(&order, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                if (column < 1 || column > 4) {
+                    if (rank == 0) printf("Invalid sort column.\n");
+                    break;
+                }
+                static const char *columnNames[] = {"price", "quantity", "ID", "name"};
+                timer = startOp(OP_SORT);
+                double start = MPI_Wtime(), elapsed, slowest = 0;
+                sortAllShards(column - 1, order == 2, rank, size); // Listings now print this global order
+                elapsed = MPI_Wtime() - start;
+                MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+                if (rank == 0) {
+                    printf("\nItems sorted by %s (%s) on %d ranks in %.3f seconds.\n", columnNames[column - 1],
+                           order == 2 ? "descending" : "ascending", size, slowest);
+                }
                 break;
+            }
             case 8:
-                stockAlert();
+                timer = startOp(OP_STOCK_ALERT);
+                stockAlert(rank, size);
                 break;
             case 9:
-                printItems();
+                timer = startOp(OP_PRINT);
+                printItems(rank, size);
                 break;
             case 10: {
-                char filename[50];
+                char filename[50], answer;
+                int format;
+                BulkFilter filter;
+                initBulkFilter(&filter);
                 if (rank == 0) {
-                    printf("Enter filename to export data: ");
+                    printf("Enter filename to export data (end it with .gz to compress): ");
                     fgets(filename, sizeof(filename), stdin);
                     strtok(filename, "\n");
+                    printf("Format (1 = CSV, 2 = Binary columns): ");
+                    scanf("%d", &format);
+                    printf("Export only items matching a filter? (y/n): ");
+                    scanf(" %c", &answer);
+                    getchar();
+                    if (answer == 'y' || answer == 'Y') {
+                        promptBulkFilter(&filter);
+                    }
                 }
                 MPI_Bcast(filename, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
-                exportData(filename);
+                MPI_Bcast(&format, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                MPI_Bcast(&filter, sizeof(filter), MPI_BYTE, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_EXPORT);
+                double start = MPI_Wtime();
+                long long rows = exportData(filename, format == 2 ? EXPORT_BINARY : EXPORT_CSV, &filter, rank);
+                if (rank == 0) {
+                    char shardName[PATH_MAX];
+                    exportShardName(filename, 0, shardName, sizeof(shardName));
+                    if (rows >= 0) {
+                        printf("\nData exported successfully: %lld items across %d ranks (rank 0 wrote %s) in %.3f seconds.\n", rows, size, shardName, MPI_Wtime() - start);
+                    } else {
+                        printf("\nExport failed on at least one rank.\n");
+                    }
+                }
                 break;
             }
-            case 11:
-                viewItemsByCategory();
+            case 11: {
+                char category[50] = "";
+                if (rank == 0) {
+                    printf("Enter category name: ");
+                    if (fgets(category, sizeof(category), stdin)) {
+                        category[strcspn(category, "\n")] = '\0';
+                    }
+                }
+                MPI_Bcast(category, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_CATEGORY_VIEW);
+                viewItemsByCategory(category, rank, size);
                 break;
+            }
             case 12:
-                calculateTotalValue();
+                timer = startOp(OP_TOTAL);
+                calculateTotalValue(rank, size);
                 break;
             case 13:
                 if (rank == 0) {
                     printf("See you another time. Bye ! \n");
                 }
                 break;
+            case 14: {
+                timer = startOp(OP_COMPACT);
+                int reclaimed = tombstoneCount, totalReclaimed = 0;
+                compactItems();
+                MPI_Reduce(&reclaimed, &totalReclaimed, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+                if (rank == 0) {
+                    printf("\nCompaction done: reclaimed %d deleted slots.\n", totalReclaimed);
+                }
+                break;
+            }
+            case 15: {
+                char filename[50];
+                if (rank == 0) {
+                    printf("Enter filename for the snapshot: ");
+                    fgets(filename, sizeof(filename), stdin);
+                    strtok(filename, "\n");
+                }
+                MPI_Bcast(filename, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_SNAPSHOT);
+                saveSnapshot(filename, rank, size);
+                break;
+            }
+            case 16: {
+                BulkFilter filter;
+                BulkAction action;
+                if (rank == 0) {
+                    promptFilteredUpdate(&filter, &action);
+                }
+                MPI_Bcast(&filter, sizeof(filter), MPI_BYTE, 0, MPI_COMM_WORLD);
+                MPI_Bcast(&action, sizeof(action), MPI_BYTE, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_FILTERED_UPDATE);
+                processFilteredUpdate(&filter, &action, rank, size);
+                break;
+            }
+            case 17: {
+                int column, order, k;
+                if (rank == 0) {
+                    printf("Rank by (1 = Price, 2 = Quantity): ");
+                    scanf("%d", &column);
+                    printf("Order (1 = Lowest first, 2 = Highest first): ");
+                    scanf("%d", &order);
+                    printf("How many items: ");
+                    scanf("%d", &k);
+                }
+                MPI_Bcast(&column, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                MPI_Bcast(&order, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                MPI_Bcast(&k, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                if (column < 1 || column > 2 || k < 1) {
+                    if (rank == 0) printf("Invalid choice.\n");
+                    break;
+                }
+                timer = startOp(OP_TOP_K);
+                topItems(column == 1 ? SORT_BY_PRICE : SORT_BY_QUANTITY, order == 2, k, rank, size);
+                break;
+            }
+            case 18: {
+                char category[50];
+                int threshold;
+                if (rank == 0) {
+                    printf("Enter category: ");
+                    fgets(category, sizeof(category), stdin);
+                    strtok(category, "\n");
+                    printf("Enter reorder threshold (items below it are low on stock): ");
+                    scanf("%d", &threshold);
+                }
+                MPI_Bcast(category, 50, MPI_CHAR, 0, MPI_COMM_WORLD);
+                MPI_Bcast(&threshold, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                timer = startOp(OP_SET_THRESHOLD);
+                // Ranks that have not seen the category yet add it, so it keeps the threshold when items arrive
+                int known = findCategory(category) >= 0, anyKnown = 0;
+                MPI_Allreduce(&known, &anyKnown, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+                int code = anyKnown ? internCategory(category) : -1;
+                if (code >= 0) {
+                    setCategoryThreshold(code, threshold);
+                }
+                if (rank == 0) {
+                    if (!anyKnown) {
+                        printf("\nError: Category '%s' not found.\n", category);
+                    } else {
+                        printf("\nReorder threshold of '%s' set to %d.\n", category, threshold);
+                    }
+                }
+                break;
+            }
+            case 19:
+                showStats(rank, size);
+                break;
             default:
                 if (rank == 0) {
                     printf("Invalid choice, please try again.\n");
                 }
         }
+        finishOp(&timer);
+        printStockAlerts(stdout, rank, size);
+        walCommit(); // One write per command covers every record it produced
+        dumpStats(0);
     } while (choice != 13);
+    walClose();
+    closeStatsFile();
 
-    free(items);
+    freeRows();
+    free(idIndex);
+    freeNameIndex();
     MPI_Finalize();
     return 0;
 }
@@ -3,297 +3,3625 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <limits.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1 // SSE2 and AVX2 scan kernels are compiled in; which one runs is decided at run time
+#endif
 #include <omp.h>
 
 #define INITIAL_SIZE 1000
 #define MAX_LINE_LENGTH 1024
-#define LOW_STOCK_THRESHOLD 10
+#define DATA_FILES 20 // Default count of warehouse_data_N.csv files loaded, as writedatatofile writes by default
+#define LOW_STOCK_THRESHOLD 10 // Default reorder threshold; --reorder-threshold=N overrides it for every category
+#define ALERT_QUEUE_SIZE 256 // Threshold crossings kept between two displays; later ones are only counted
+#define VALUE_SCALE 10000 // Fixed-point units per currency unit in the running aggregates
 #define MAX_ITEMS 10000000
+#define INDEX_EMPTY -1
+#define MIN_INDEX_CAPACITY 1024
+#define TOMBSTONE_ID INT_MIN // ID stored in a deleted slot until the next compaction
+#define DELETE_MODE_TOMBSTONE 0
+#define DELETE_MODE_SWAP 1
+#define AUTO_COMPACT_PERCENT 50 // Compact automatically once this share of slots are tombstones
+#define SORT_BY_PRICE 0
+#define SORT_BY_QUANTITY 1
+#define SORT_BY_ID 2
+#define SORT_BY_NAME 3
+#define NAME_RUN_LENGTH 32 // Runs insertion-sorted before merging when sorting by name
+#define MAX_CATEGORIES 256 // Category codes must fit in an unsigned char
+#define GRAM_BUCKET_BITS 16 // The name index hashes trigrams into 1 << GRAM_BUCKET_BITS posting lists
+#define GRAM_BUCKETS (1 << GRAM_BUCKET_BITS)
+#define GRAM_ANCHOR 1 // Byte standing for "start of name" in the two grams that make prefix lookups indexable
+#define GRAM_PROBE_COST 4 // Rough cost of checking one index candidate, in sequentially scanned rows
+#define LOAD_CHUNK_BYTES (4 << 20) // Target size of the newline-aligned pieces the loader parses in parallel
+#define LOCK_STRIPES 64 // Writer locks for in-place updates; an id always maps to the same stripe
+#define READER_SLOTS 64 // Shared-mode counters, one cache line each, indexed by thread number
+#define SNAPSHOT_MAGIC "WHSNAP\0" // First 8 bytes of every snapshot file
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_CHECKSUM_SEED 0x5748534E41503031ULL
+#define SNAPSHOT_BLOCK_ROWS 65536 // Rows staged per write when saving a snapshot
+#define SNAPSHOT_FIELD_ID 0
+#define SNAPSHOT_FIELD_QUANTITY 1
+#define SNAPSHOT_FIELD_PRICE 2
+#define SNAPSHOT_FIELD_CATEGORY 3
+#define SNAPSHOT_FIELD_NAME_LENGTH 4
+#define SNAPSHOT_FIELDS 5
+#define EXPORT_CSV 0 // Export formats
+#define EXPORT_BINARY 1
+#define EXPORT_BLOCK_WORDS 256 // Selection bitmap words (64 rows each) formatted into one buffer and written at once
+#define EXPORT_ROW_BYTES 384 // Room for one formatted row in either format
+#define EXPORT_MAGIC "WHCOLS\0" // First 8 bytes of a binary export
+#define EXPORT_VERSION 2
+#define NAME_MAX_LENGTH 255 // Longest item name kept; the WAL stores a name's length in one byte
+#define NAME_ARENA_MIN_BYTES 65536 // First allocation of the name arena
+#define NAME_GARBAGE_PERCENT 50 // Compact the name arena once this share of its bytes belong to no row
+#define OP_NONE -1 // Operations timed by the metrics layer, one latency histogram each
+#define OP_ADD 0
+#define OP_DELETE 1
+#define OP_RETRIEVE 2
+#define OP_UPDATE 3
+#define OP_BULK_UPDATE 4
+#define OP_SEARCH 5
+#define OP_SORT 6
+#define OP_STOCK_ALERT 7
+#define OP_PRINT 8
+#define OP_EXPORT 9
+#define OP_CATEGORY_VIEW 10
+#define OP_TOTAL 11
+#define OP_COMPACT 12
+#define OP_SNAPSHOT 13
+#define OP_FILTERED_UPDATE 14
+#define OP_SET_THRESHOLD 15
+#define OP_COUNT 16
+#define LATENCY_SUB_BUCKETS 16 // Histogram buckets per power of two, so a bucket is never wider than 1/16 of its values
+#define LATENCY_SUB_BITS 4     // log2(LATENCY_SUB_BUCKETS)
+#define LATENCY_BUCKETS 592    // Covers latencies up to 2^40 ns (about 18 minutes); slower ones land in the last bucket
+#define STATS_INTERVAL 10      // Default seconds between two dumps to --stats-file
+#define RESULT_OK 0
+#define RESULT_NOT_FOUND 1
+#define RESULT_EXISTS 2
+#define RESULT_RESERVED_ID 3
+#define RESULT_TOO_MANY_CATEGORIES 4
+#define RESULT_INVALID_COMMAND 5
+#define RESULT_WRITE_FAILED 6
+#define BATCH_GROUP_LINES 1024 // Batch commands read (and under MPI broadcast) together; the WAL is committed once per group
+#define BATCH_INVALID 0
+#define BATCH_ADD 1
+#define BATCH_DELETE 2
+#define BATCH_UPDATE 3
+#define BATCH_GET 4
+#define BATCH_SEARCH 5
+#define BATCH_TOTAL 6 // Commands from here on work on the whole table rather than one ID
+#define BATCH_SORT 7
+#define BATCH_BULK 8
+#define BATCH_EXPORT 9
+#define BATCH_TIME 10
+#define BATCH_STATS 11
+#define BULK_CHUNK_ROWS 65536 // Rows a bulk update applies between progress checks
+#define BULK_PROGRESS_ROWS 1000000 // A progress line is printed each time this many more rows are done
+#define BULK_KEEP 0 // Filtered bulk update actions
+#define BULK_ADD 1
+#define BULK_SET 2
+#define BULK_SCALE 3 // Prices only
+#define BULK_PLAN_SCAN 0 // How a filtered bulk update finds its candidate rows
+#define BULK_PLAN_CATEGORY 1
+#define BULK_PLAN_ID 2
+#define BULK_PROBE_COST 4 // Rough cost of one id index probe, in sequentially scanned rows
+#define SCAN_SCALAR 0 // Range scan kernel levels
+#define SCAN_SSE2 1
+#define SCAN_AVX2 2
+#define SCAN_BLOCK_WORDS 1024 // Bitmap words (64 rows each) one thread scans at a time
+#define RESULT_PAGE_ROWS 100 // Default rows printed before asking whether to show more; --page-rows=N overrides
+#define QUERY_ALL 0 // Row predicates of collectRows()
+#define QUERY_NAME 1
+#define QUERY_PREFIX 2
+#define ROW_FORMAT_FULL 0 // Line layouts of printRows()
+#define ROW_FORMAT_NO_CATEGORY 1
+#define WAL_BUFFER_BYTES 65536 // Records are gathered here and written with one write() per commit
+#define WAL_SYNC_EVERY 16 // Default commits per fdatasync(); --wal-sync=N overrides, 0 leaves syncing to the OS
+#define WAL_RECORD_ADD 1
+#define WAL_RECORD_DELETE 2
+#define WAL_RECORD_UPDATE 3
+#define WAL_RECORD_BULK 4
+#define WAL_RECORD_FILTERED 5
+#define WAL_FIELD_NAME 1 // Update record flags: which fields the update changes
+#define WAL_FIELD_CATEGORY 2
+#define WAL_FIELD_QUANTITY 4
+#define WAL_FIELD_PRICE 8
 
+// Build with -DCOLUMNAR_STORE to keep id, quantity, price and category in separate contiguous columns
+// instead of inside each Item; scans over numeric fields then stream only the columns they read.
 typedef struct {
+#ifndef COLUMNAR_STORE
     int id;
-    char name[50];
-    char category[50];
+#endif
+    uint32_t nameOffset; // Start of the item's NUL-terminated name in nameArena
+#ifndef COLUMNAR_STORE
+    unsigned char category; // Code into categoryNames[]
     int quantity;
     float price;
+#endif
 } Item;
 
+#ifdef COLUMNAR_STORE
+// Numeric fields stored column-wise; row i of every column belongs with the name in items[i]
+typedef struct {
+    int *id;
+    int *quantity;
+    float *price;
+    unsigned char *category;
+} ItemColumns;
+
+#define ITEM_ID(i) (columns.id[i])
+#define ITEM_QUANTITY(i) (columns.quantity[i])
+#define ITEM_PRICE(i) (columns.price[i])
+#define ITEM_CATEGORY(i) (columns.category[i])
+#define COLUMN_STRIDE sizeof(int) // Bytes from one row's id, quantity or price to the next row's
+#else
+#define ITEM_ID(i) (items[i].id)
+#define ITEM_QUANTITY(i) (items[i].quantity)
+#define ITEM_PRICE(i) (items[i].price)
+#define ITEM_CATEGORY(i) (items[i].category)
+#define COLUMN_STRIDE sizeof(Item)
+#endif
+#define ITEM_NAME(i) (nameArena + items[i].nameOffset)
+#define ITEM_CATEGORY_NAME(i) (categoryNames[ITEM_CATEGORY(i)])
+#ifdef COLUMNAR_STORE
+#define ITEM_BYTES (sizeof(Item) + 3 * sizeof(int) + 1) // Bytes one row occupies across items[] and the columns
+#else
+#define ITEM_BYTES sizeof(Item)
+#endif
+
+// One slot of the open-addressing index that maps an item ID to its row in items[]
+typedef struct {
+    int id;
+    int row; // INDEX_EMPTY marks a free slot
+} IndexSlot;
+
+// A data file mapped into memory by mapFile()
+typedef struct {
+    char *data;
+    size_t size;
+} MappedFile;
+
+// A newline-aligned piece of a mapped file, parsed by one thread straight into items[firstRow...]
+typedef struct {
+    const char *begin;
+    const char *end;
+    int firstRow;
+    int rows;         // Line count before parsing, rows actually parsed afterwards
+    size_t firstName; // Start of the chunk's stretch of nameArena, as long as the chunk itself
+    size_t nameBytes; // Name bytes parsed into it
+} LoadChunk;
+
+// Fixed header at the start of a snapshot file. It is followed by 8-byte aligned sections: category names,
+// category row counts, then the id, quantity, price, category and name length columns, the names, the category
+// bitmaps and the ID index.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t itemCount;
+    uint32_t categoryCount;
+    uint32_t indexCapacity;
+    uint32_t shard;       // Rank that wrote the file (always 0 outside MPI)
+    uint32_t shardCount;
+    uint64_t walSequence; // LSN of the last WAL record included; replay starts after it
+    uint64_t nameBytes;   // Size of the name section
+    uint64_t checksum;    // Of every byte after the header
+} SnapshotHeader;
+
+// Fixed header at the start of a binary export. It is followed by the category names, then blocks of at most
+// blockRows rows, each [uint32 row count][ids][quantities][prices][category codes][name lengths][names].
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowCount;
+    uint32_t categoryCount;
+    uint32_t blockRows;
+} ExportHeader;
+
+// Growable buffer for output that is produced before it is printed
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+// Row indices of a query result, in storage order
+typedef struct {
+    int *rows;
+    int count;
+    int capacity;
+} RowList;
+
+// Predicate of a filtered bulk update; all bounds are inclusive
+typedef struct {
+    char category[50]; // Empty matches every category
+    int minId, maxId;
+    int minQuantity, maxQuantity;
+    float minPrice, maxPrice;
+} BulkFilter;
+
+// Action of a filtered bulk update: a BULK_* mode and its operand for each field
+typedef struct {
+    int quantityMode;
+    int quantity;
+    int priceMode;
+    float price;
+} BulkAction;
+
+// Shared-mode counter of one thread, padded to its own cache line so that readers never contend
+typedef struct {
+    int active;
+    char pad[60];
+} ReaderSlot;
+
+// A consistent copy of one row, taken by readers without locking
+typedef struct {
+    int id;
+    const char *name; // Points into nameArena, which only changes in exclusive mode
+    unsigned char category;
+    int quantity;
+    float price;
+} RowCopy;
+
+// One thread's share of the running aggregates, on cache lines of its own; the aggregates are the sums over all slots
+typedef struct {
+    long long value;
+    long long categoryValue[MAX_CATEGORIES];
+    int lowStock;
+    char pad[60];
+} AggregateSlot;
+
+// A threshold crossing queued by a write: the item as it was right after the change
+typedef struct {
+    int id;
+    char name[NAME_MAX_LENGTH + 1];
+    int quantity;
+    int threshold;
+    int low; // 1 when the item dropped below its threshold, 0 when it was restocked
+} StockAlert;
+
+// One parsed line of a batch command stream (see parseBatchCommand for the syntax)
+typedef struct {
+    int line;
+    int op;             // BATCH_* code
+    int id;
+    int quantity;       // Negative keeps the current value in an update
+    float price;        // Negative keeps the current value in an update
+    char name[NAME_MAX_LENGTH + 1]; // Empty keeps the current value in an update; the keyword of a search
+    char category[50];
+    int result;         // RESULT_* code once the command has run
+    int matches;        // Rows returned by a get or search
+    TextBuffer output;  // Those rows, one CSV line each
+    int mode;           // Sort column or export format
+    int descending;     // Sort order
+    BulkFilter filter;  // Filter and action of a bulk update
+    BulkAction action;
+} BatchCommand;
+
+// One entry of a sort permutation: an order-preserving 32-bit key and the row it was taken from
+typedef struct {
+    unsigned int key;
+    int row;
+} SortEntry;
+
+// Latency histogram and work counters of one operation. Buckets are log-linear as in an HDR histogram:
+// one per nanosecond below LATENCY_SUB_BUCKETS, then LATENCY_SUB_BUCKETS equal buckets per power of two.
+typedef struct {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t rows;  // Rows scanned
+    uint64_t bytes; // Bytes of row storage touched
+    uint64_t buckets[LATENCY_BUCKETS];
+} OpMetrics;
+
+// An operation being timed: when it started and the work counters at that moment
+typedef struct {
+    int op; // OP_* code, or OP_NONE when nothing is timed
+    uint64_t startNs;
+    uint64_t rows;
+    uint64_t bytes;
+    uint64_t pausedNs; // Pager wait so far when it started
+} OpTimer;
+
+// Posting list of the name index: IDs of the items whose name contains one of the bucket's trigrams
+typedef struct {
+    int *ids;
+    int count;
+    int capacity;
+} GramList;
+
 
 
 Item *items = NULL;
 int itemCount = 0;
 int itemCapacity = INITIAL_SIZE;
+#ifdef COLUMNAR_STORE
+ItemColumns columns;
+#endif
+
+// Name arena: the items' names, NUL-terminated and back to back. A row refers to its name by offset; renamed and
+// deleted items leave their old bytes behind as garbage until compactNames() rewrites the arena in row order.
+char *nameArena = NULL;
+size_t nameArenaLength = 0;
+size_t nameArenaCapacity = 0;
+size_t nameArenaGarbage = 0;
+
+IndexSlot *idIndex = NULL;
+int idIndexCapacity = 0; // Always a power of two
+int idIndexShift = 32;   // 32 - log2(idIndexCapacity), used by hashId()
+int idIndexCount = 0;
+
+int deleteMode = DELETE_MODE_TOMBSTONE;
+int tombstoneCount = 0; // Deleted slots still occupying items[]
+const char *snapshotFile = NULL; // Set by --snapshot=FILE to start from a snapshot instead of the CSV files
+const char *batchFile = NULL;    // Set by --batch=FILE (or - for stdin) to run a command stream instead of the menu
+int dataFileCount = DATA_FILES;  // Set by --files=N to load the files of a writedatatofile --files=N run
+double batchMark = 0;            // When the last batch "time" command ran; the program start before the first one
+int scanKernel = SCAN_AVX2;      // Highest range scan kernel to use, lowered by --scan-kernel=scalar|sse2
+int scanCpuLevel = -1;           // Highest kernel the CPU supports, detected on first use
+int pageRows = RESULT_PAGE_ROWS; // Set by --page-rows=N; 0 prints whole results without pausing
+int resultLimit = 0;             // Set by --limit=N to cap the rows any one query prints; 0 means no cap
+
+// Write-ahead log (--wal=FILE). Mutations append binary records to walBuffer; walCommit() writes them out
+// with a single write() after each command and calls fdatasync() every walSyncEvery commits.
+// Each record is [body length][checksum][LSN][type][payload].
+const char *walFile = NULL;
+int walFd = -1;
+int walSyncEvery = WAL_SYNC_EVERY;
+unsigned char walBuffer[WAL_BUFFER_BYTES];
+size_t walBuffered = 0;
+int walUnsynced = 0;      // Commits written since the last fdatasync()
+uint64_t walSequence = 0; // LSN of the last record applied to the table
+
+// Category dictionary. Rows store a small code; categoryRows[c] has bit r set for every live row r in category c,
+// so listing, counting or summing a category touches only its own rows.
+char categoryNames[MAX_CATEGORIES][50];
+int categoryCount = 0;
+uint64_t *categoryRows[MAX_CATEGORIES];
+int categoryItemCount[MAX_CATEGORIES];
+
+// Running aggregates over the live rows, kept current by every change so that dashboard queries need no scan.
+// Values are fixed-point (VALUE_SCALE units per currency unit): removing a row subtracts exactly what adding it
+// added, so the totals never drift. Each thread adds its changes to its own slot, so concurrent updaters and
+// parallel bulk updates never contend; readers sum the slots.
+AggregateSlot aggregateSlots[READER_SLOTS];
+int verifyAggregates = 0; // Set by --verify-aggregates to cross-check every dashboard query against a full rescan
+
+// Reorder thresholds. A live row is low on stock while its quantity is below its category's threshold, and
+// lowStockRows has bit r set for every such row r. Each write compares that bit with the row's new state and
+// queues a StockAlert when it flips, so crossings are reported as they happen and the report needs no scan.
+// Writers of one row are already serialized (stripe lock or exclusive mode); the bits of neighbouring rows
+// share words, so they are flipped atomically, and writers reserve queue entries with an atomic counter.
+int categoryThreshold[MAX_CATEGORIES];
+int defaultThreshold = LOW_STOCK_THRESHOLD;
+uint64_t *lowStockRows = NULL;
+StockAlert alertQueue[ALERT_QUEUE_SIZE];
+int alertCount = 0; // Crossings since the queue was last shown; the first ALERT_QUEUE_SIZE are in alertQueue
+
+// Trigram index of item names. Lists hold IDs rather than rows, so moving rows (sorting, compaction, swap
+// deletes) never touches it. Removing a name only counts its entries as stale: lookups re-check every
+// candidate against the row, and the index is rebuilt once stale entries outnumber live ones.
+GramList gramLists[GRAM_BUCKETS];
+long long gramEntries = 0;
+long long gramStale = 0;
+
+// Operation metrics. startOp() and finishOp() around every menu and batch operation record its latency in the
+// running thread's own OpMetrics, so batch threads never share a counter; mergeMetrics() sums them on read.
+// workRows and workBytes are per thread as well: the thread that runs an operation adds the rows and bytes it
+// touches with noteWork(), after any parallel loop has finished, and finishOp() charges it with the difference.
+OpMetrics *opMetrics = NULL; // metricThreads * OP_COUNT entries, one set per thread
+int metricThreads = 0;
+uint64_t workRows = 0;
+uint64_t workBytes = 0;
+#pragma omp threadprivate(workRows, workBytes)
+uint64_t pausedNs = 0; // Time the pager has waited for the user, which is left out of operation latencies
+const char *opNames[OP_COUNT] = {"add", "delete", "retrieve", "update", "bulk_update", "search", "sort", "stock_alert",
+                                 "print", "export", "category_view", "total", "compact", "snapshot", "filtered_update",
+                                 "set_threshold"};
+const char *statsFile = NULL; // Set by --stats-file=FILE to append the metrics there every statsInterval seconds
+int statsInterval = STATS_INTERVAL;
+FILE *statsOutput = NULL;
+double statsStart = 0;        // Program start; dump lines carry the seconds since
+double lastStatsDump = 0;
+
+// Concurrency control for the table. Lookups and in-place updates run in shared mode: each thread raises
+// its own ReaderSlot, so they never wait for one another. Updates of one id serialize on its stripe lock
+// and bump the row's seqlock (rowVersions[row], odd while the row is being written), which lets readers
+// copy rows without locking and retry if an update overlapped. Adds, deletes and new categories change
+// the table's shape: they take structureLock, raise structureWriter and wait for every slot to drain.
+omp_lock_t stripeLocks[LOCK_STRIPES];
+omp_lock_t structureLock;
+ReaderSlot readerSlots[READER_SLOTS];
+int structureWriter = 0;
+unsigned int *rowVersions = NULL;
 
 
 
 
 // Function prototypes
 void loadDataFromFiles();
-void loadData(const char *filename);
 void addItem(int id, const char *name, const char *category, int quantity, float price);
 void deleteItem(int id);
 void retrieveItem(int id);
 void updateItem(int id, const char *name, const char *category, int quantity, float price);
-void processBulkUpdates(int increment);
+void bulkUpdateRows(int begin, int end, int quantityDelta, float priceDelta);
+void applyBulkUpdate(int quantityDelta, float priceDelta, int reportProgress);
+void processBulkUpdates(int quantityDelta, float priceDelta);
+int scanKernelLevel();
+void selectIntRangeScalar(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRangeScalar(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+#ifdef SCAN_X86
+void selectIntRangeSse2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRangeSse2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+void selectIntRangeAvx2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRangeAvx2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+#endif
+void selectIntRange(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits);
+void selectFloatRange(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits);
+uint64_t *newBitmap(int words);
+void selectIntColumn(const int *first, int lo, int hi, uint64_t *bits);
+void selectFloatColumn(const float *first, float lo, float hi, uint64_t *bits);
+void andBitmaps(uint64_t *bits, const uint64_t *other, int words);
+void selectFilterRows(const BulkFilter *filter, int category, uint64_t *selected);
+void applyBulkAction(const BulkAction *action, int row);
+void initBulkFilter(BulkFilter *filter);
+int filteredUpdateRow(const BulkFilter *filter, int category, const BulkAction *action, int row);
+int applyFilteredUpdate(const BulkFilter *filter, const BulkAction *action, int *plan);
+void promptBulkFilter(BulkFilter *filter);
+void promptFilteredUpdate(BulkFilter *filter, BulkAction *action);
+void processFilteredUpdate(const BulkFilter *filter, const BulkAction *action);
+void rowListAppend(RowList *list, int row);
+int rowMatches(int query, int row, const char *keyword);
+void collectRows(int query, const char *keyword, RowList *result);
+void collectBitmapRows(const uint64_t *bits, int words, RowList *result);
+void printRows(const RowList *list, int format);
+int nameGrams(const char *name, int anchored, unsigned int *buckets);
+void indexName(int id, const char *name);
+void unindexName(const char *name);
+void buildNameIndex();
+void tidyNameIndex();
+void freeNameIndex();
+int nameMatches(const char *name, const char *keyword, int prefix);
+int compareRows(const void *a, const void *b);
+void findNameRows(const char *pattern, RowList *result);
 void searchItems(const char *keyword);
-void sortItemsByPrice();
-void logOperation(const char *operation, const char *details);
-void exportData(const char *filename);
+void sortItems(int column, int descending);
+int formatInt(char *out, long long value);
+int formatPrice(char *out, float price);
+size_t formatExportBlock(int format, const uint64_t *selected, int firstWord, int endWord, char *buffer);
+int writeAll(int fd, const void *data, size_t size);
+int openExportFile(const char *filename, pid_t *compressor);
+int closeExportFile(int fd, pid_t compressor);
+int writeExportHeader(int fd, long long rows);
+long long exportRows(const char *filename, int format, const uint64_t *selected, int words);
+long long exportData(const char *filename, int format, const BulkFilter *filter);
 void stockAlert();
 void displayMenu();
 void printItems();
-void viewItemsByCategory();
+long long rowValueUnits(int row);
+void aggregateRow(int row, int sign);
+void aggregateRows(int begin, int end, int sign);
+void sumAggregates(long long *total, long long *categoryValues, int *lowStock);
+void readAggregates(long long *total, long long *categoryValues, int *lowStock);
+void rebuildAggregates();
+int isLowStock(int row);
+void queueStockAlert(int row, int low);
+void trackStock(int row);
+void trackStockRows(int begin, int end);
+int untrackStock(int row);
+void rebuildLowStockRows();
+void setCategoryThreshold(int code, int threshold);
+void printStockAlerts(FILE *out);
+void discardStockAlerts();
+int checkAggregates();
+void viewItemsByCategory(const char *category);
 void calculateTotalValue();
+void buildIndex();
+int findItemRow(int id);
+int indexInsert(int id, int row);
+void indexRemove(int id);
+void indexSetRow(int id, int row);
+void compactItems();
+void reserveRows(int capacity);
+void initTableLocks();
+int idStripe(int id);
+void beginShared();
+void endShared();
+void beginExclusive();
+void endExclusive();
+void beginRowWrite(int row);
+void endRowWrite(int row);
+void copyRow(int row, RowCopy *copy);
+void appendRow(int id, const char *name, int category, int quantity, float price);
+void reserveNames(size_t extra);
+uint32_t storeName(const char *name, size_t length);
+void renameRow(int row, const char *name);
+void releaseName(int row, int tombstone);
+void compactNames();
+void tidyNames();
+int findCategory(const char *name);
+int internCategory(const char *name);
+void categoryAddRow(int row);
+void categoryRemoveRow(int row);
+void rebuildCategoryBitmaps();
+void moveRow(int dst, int src);
+void freeRows();
+void parseOptions(int argc, char *argv[]);
+uint64_t monotonicNs();
+void noteWork(long long rows, long long bytes);
+OpTimer startOp(int op);
+void finishOp(const OpTimer *timer);
+int latencyBucket(uint64_t ns);
+uint64_t bucketHighest(int bucket);
+uint64_t latencyPercentile(const OpMetrics *metrics, int permille);
+void mergeMetrics(OpMetrics *merged);
+int formatStats(const OpMetrics *merged, const char *prefix, TextBuffer *out);
+void initMetrics();
+void showStats();
+void openStatsFile();
+void dumpStats(int force);
+void closeStatsFile();
+void reportResult(int result, int id, const char *success);
+int applyAddItem(int id, const char *name, const char *category, int quantity, float price);
+int applyDeleteItem(int id);
+int applyUpdateItem(int id, const char *name, const char *category, int quantity, float price);
+uint32_t walChecksum(const unsigned char *data, size_t size);
+void walFlush();
+void walAppend(int type, const unsigned char *payload, size_t size);
+void walLogItem(int type, int id, const char *name, const char *category, int quantity, float price);
+void walLogDelete(int id);
+void walLogBulk(int quantityDelta, float priceDelta);
+void walLogFiltered(const BulkFilter *filter, const BulkAction *action);
+void walCommit();
+void walClose();
+void walReplay(int type, const unsigned char *payload, size_t size);
+void walOpen(const char *filename);
+void textReserve(TextBuffer *buffer, size_t extra);
+void textAppend(TextBuffer *buffer, const char *format, ...);
+void textAppendBytes(TextBuffer *buffer, const void *data, size_t size);
+void appendItemText(TextBuffer *buffer, int row);
+const char *copyBatchField(const char *p, const char *end, char *out, size_t size);
+int parseBatchCommand(const char *line, int lineNumber, BatchCommand *command);
+int parseBatchBulk(const char *p, const char *end, BulkFilter *filter, BulkAction *action);
+void runBatchCommand(BatchCommand *command);
+void printBatchResult(const BatchCommand *command);
+void runBatchGroup(BatchCommand *commands, int count);
+void runBatch(const char *filename);
+uint64_t snapshotChecksum(uint64_t checksum, const void *data, size_t size);
+size_t snapshotPadded(size_t size);
+int snapshotNamesValid(const unsigned char *lengths, const char *names, size_t n, uint64_t nameBytes);
+void writeSnapshotSection(FILE *file, const void *data, size_t size, uint64_t *checksum);
+size_t gatherSnapshotBlock(int field, int start, int count, char *buffer);
+size_t scatterSnapshotBlock(int field, int start, int count, const char *data);
+void saveSnapshot(const char *filename);
+int openSnapshot(const char *filename, MappedFile *snapshot);
+void restoreSnapshot(MappedFile *snapshot);
+void mapFile(const char *filename, MappedFile *file);
+void unmapFile(MappedFile *file);
+size_t countLines(const char *begin, const char *end);
+const char *skipHeader(const char *begin, const char *end);
+int parseIntField(const char **p, const char *end, int *value);
+int parsePriceField(const char **p, const char *end, float *value);
+int parseRow(const char *line, const char *end, int *id, const char **name, int *nameLength,
+             const char **category, int *categoryLength, int *quantity, float *price);
+int categoryCode(const char *name, int length);
+int loadChunk(LoadChunk *chunk, int *categoryCache, int *cachedCategories);
+void shiftRows(int dst, int src, int count);
 
-// Function to load data from all files
-void loadDataFromFiles() {
-    char filenames[20][50];
+// Function to resize the row storage (items[] plus, in columnar builds, every column) to hold capacity rows
+void reserveRows(int capacity) {
+    items = realloc(items, sizeof(Item) * capacity);
+#ifdef COLUMNAR_STORE
+    columns.id = realloc(columns.id, sizeof(int) * capacity);
+    columns.quantity = realloc(columns.quantity, sizeof(int) * capacity);
+    columns.price = realloc(columns.price, sizeof(float) * capacity);
+    columns.category = realloc(columns.category, sizeof(unsigned char) * capacity);
+    if (!columns.id || !columns.quantity || !columns.price || !columns.category) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    rowVersions = realloc(rowVersions, sizeof(unsigned int) * capacity);
+    if (!items || !rowVersions) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    if (capacity > itemCapacity) {
+        memset(rowVersions + itemCapacity, 0, sizeof(unsigned int) * (capacity - itemCapacity));
+    }
 
-    #pragma omp parallel for // Parallelize the filename creation step
-    for (int i = 0; i < 20; i++) {
-        sprintf(filenames[i], "warehouse_data_%d.csv", i + 1);
+    int oldWords = (itemCapacity + 63) / 64;
+    int newWords = (capacity + 63) / 64;
+    for (int c = 0; c < categoryCount; c++) {
+        categoryRows[c] = realloc(categoryRows[c], sizeof(uint64_t) * newWords);
+        if (!categoryRows[c]) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        if (newWords > oldWords) {
+            memset(categoryRows[c] + oldWords, 0, sizeof(uint64_t) * (newWords - oldWords));
+        }
+    }
+    int oldLowWords = lowStockRows ? oldWords : 0; // The first call allocates it from scratch
+    lowStockRows = realloc(lowStockRows, sizeof(uint64_t) * newWords);
+    if (!lowStockRows) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
     }
+    if (newWords > oldLowWords) {
+        memset(lowStockRows + oldLowWords, 0, sizeof(uint64_t) * (newWords - oldLowWords));
+    }
+    itemCapacity = capacity;
+}
 
-    #pragma omp parallel for // Parallelize loading data from each file
-    for (int i = 0; i < 20; i++) {
-        loadData(filenames[i]);
+// Function to initialise the table locks; must run before the first add, delete or update
+void initTableLocks() {
+    omp_init_lock(&structureLock);
+    for (int s = 0; s < LOCK_STRIPES; s++) {
+        omp_init_lock(&stripeLocks[s]);
     }
 }
 
-// Function to load data from a CSV file
-void loadData(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Error opening file");
+// Function to map an id onto its writer lock stripe
+int idStripe(int id) {
+    return (int)((((unsigned int)id * 2654435769u) >> 16) % LOCK_STRIPES);
+}
+
+// Function to enter shared mode: announce this thread, backing off while a structural change is in progress
+void beginShared() {
+    ReaderSlot *slot = &readerSlots[omp_get_thread_num() % READER_SLOTS];
+    for (;;) {
+        __atomic_add_fetch(&slot->active, 1, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&structureWriter, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+        __atomic_sub_fetch(&slot->active, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&structureWriter, __ATOMIC_ACQUIRE)) {
+            // Spin: structural changes are short
+        }
+    }
+}
+
+// Function to leave shared mode
+void endShared() {
+    __atomic_sub_fetch(&readerSlots[omp_get_thread_num() % READER_SLOTS].active, 1, __ATOMIC_RELEASE);
+}
+
+// Function to get the table to ourselves: stop new shared-mode entries and wait for the current ones to finish
+void beginExclusive() {
+    omp_set_lock(&structureLock);
+    __atomic_store_n(&structureWriter, 1, __ATOMIC_SEQ_CST);
+    for (int s = 0; s < READER_SLOTS; s++) {
+        while (__atomic_load_n(&readerSlots[s].active, __ATOMIC_SEQ_CST)) {
+            // Spin until this slot's readers and updaters are done
+        }
+    }
+}
+
+// Function to release the table after a structural change
+void endExclusive() {
+    __atomic_store_n(&structureWriter, 0, __ATOMIC_RELEASE);
+    omp_unset_lock(&structureLock);
+}
+
+// Function to mark a row as being written; the caller holds the row's stripe lock
+void beginRowWrite(int row) {
+    __atomic_add_fetch(&rowVersions[row], 1, __ATOMIC_SEQ_CST);
+}
+
+// Function to publish a row write
+void endRowWrite(int row) {
+    __atomic_add_fetch(&rowVersions[row], 1, __ATOMIC_SEQ_CST);
+}
+
+// Function to copy a row in shared mode without locking: retry until no update of the row overlapped the copy
+void copyRow(int row, RowCopy *copy) {
+    for (;;) {
+        unsigned int before = __atomic_load_n(&rowVersions[row], __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        copy->id = ITEM_ID(row);
+        copy->name = ITEM_NAME(row);
+        copy->category = ITEM_CATEGORY(row);
+        copy->quantity = ITEM_QUANTITY(row);
+        copy->price = ITEM_PRICE(row);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&rowVersions[row], __ATOMIC_RELAXED) == before) {
+            return;
+        }
+    }
+}
+
+// Function to return the range scan kernel to use: the one asked for, or the best the CPU has if that is lower
+int scanKernelLevel() {
+    if (scanCpuLevel < 0) {
+        scanCpuLevel = SCAN_SCALAR;
+#ifdef SCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            scanCpuLevel = SCAN_AVX2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            scanCpuLevel = SCAN_SSE2;
+        }
+#endif
+    }
+    return scanKernel < scanCpuLevel ? scanKernel : scanCpuLevel;
+}
+
+// Range scan kernels. Each one reads count 32-bit values, the first at values and each next one stride bytes
+// further on (4 for a column, sizeof(Item) for a field of the row structs), and sets bit r of bits for every
+// value r in [lo, hi]. Whole 64-bit words are written, so the bits past count in the last word are cleared.
+
+// Function to scan an int field for the range [lo, hi] one value at a time; also finishes the vector kernels' tails
+void selectIntRangeScalar(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    for (int w = 0; w * 64 < count; w++) {
+        int n = count - w * 64 < 64 ? count - w * 64 : 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) {
+            int v = *(const int *)(values + ((size_t)w * 64 + b) * stride);
+            word |= (uint64_t)(v >= lo && v <= hi) << b;
+        }
+        bits[w] = word;
+    }
+}
+
+// Function to scan a float field for the range [lo, hi] one value at a time
+void selectFloatRangeScalar(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    for (int w = 0; w * 64 < count; w++) {
+        int n = count - w * 64 < 64 ? count - w * 64 : 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) {
+            float v = *(const float *)(values + ((size_t)w * 64 + b) * stride);
+            word |= (uint64_t)(v >= lo && v <= hi) << b;
+        }
+        bits[w] = word;
+    }
+}
+
+#ifdef SCAN_X86
+// Function to scan an int field four values at a time. Strided fields are assembled lane by lane.
+__attribute__((target("sse2")))
+void selectIntRangeSse2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    __m128i low = _mm_set1_epi32(lo), high = _mm_set1_epi32(hi);
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 16; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 4) * stride;
+            __m128i v = contiguous ? _mm_loadu_si128((const __m128i *)p)
+                : _mm_setr_epi32(*(const int *)p, *(const int *)(p + stride), *(const int *)(p + 2 * stride), *(const int *)(p + 3 * stride));
+            __m128i outside = _mm_or_si128(_mm_cmplt_epi32(v, low), _mm_cmpgt_epi32(v, high));
+            word |= (uint64_t)(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF) << (g * 4);
+        }
+        bits[w] = word;
+    }
+    selectIntRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+
+// Function to scan a float field four values at a time
+__attribute__((target("sse2")))
+void selectFloatRangeSse2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    __m128 low = _mm_set1_ps(lo), high = _mm_set1_ps(hi);
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 16; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 4) * stride;
+            __m128 v = contiguous ? _mm_loadu_ps((const float *)p)
+                : _mm_setr_ps(*(const float *)p, *(const float *)(p + stride), *(const float *)(p + 2 * stride), *(const float *)(p + 3 * stride));
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(v, low), _mm_cmple_ps(v, high));
+            word |= (uint64_t)_mm_movemask_ps(inside) << (g * 4);
+        }
+        bits[w] = word;
+    }
+    selectFloatRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+
+// Function to scan an int field eight values at a time. Strided fields are read with one gather per eight rows.
+__attribute__((target("avx2")))
+void selectIntRangeAvx2(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    __m256i low = _mm256_set1_epi32(lo), high = _mm256_set1_epi32(hi);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 8; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 8) * stride;
+            __m256i v = contiguous ? _mm256_loadu_si256((const __m256i *)p) : _mm256_i32gather_epi32((const int *)p, offsets, 1);
+            __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, v), _mm256_cmpgt_epi32(v, high));
+            word |= (uint64_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF) << (g * 8);
+        }
+        bits[w] = word;
+    }
+    selectIntRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+
+// Function to scan a float field eight values at a time
+__attribute__((target("avx2")))
+void selectFloatRangeAvx2(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    __m256 low = _mm256_set1_ps(lo), high = _mm256_set1_ps(hi);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    int words = count / 64, contiguous = stride == 4;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int g = 0; g < 8; g++) {
+            const char *p = values + ((size_t)w * 64 + g * 8) * stride;
+            __m256 v = contiguous ? _mm256_loadu_ps((const float *)p) : _mm256_i32gather_ps((const float *)p, offsets, 1);
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(v, low, _CMP_GE_OQ), _mm256_cmp_ps(v, high, _CMP_LE_OQ));
+            word |= (uint64_t)_mm256_movemask_ps(inside) << (g * 8);
+        }
+        bits[w] = word;
+    }
+    selectFloatRangeScalar(values + (size_t)words * 64 * stride, stride, count - words * 64, lo, hi, bits + words);
+}
+#endif
+
+// Function to run the int range kernel picked by scanKernelLevel()
+void selectIntRange(const char *values, size_t stride, int count, int lo, int hi, uint64_t *bits) {
+    switch (scanKernelLevel()) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            selectIntRangeAvx2(values, stride, count, lo, hi, bits);
+            break;
+        case SCAN_SSE2:
+            selectIntRangeSse2(values, stride, count, lo, hi, bits);
+            break;
+#endif
+        default:
+            selectIntRangeScalar(values, stride, count, lo, hi, bits);
+    }
+}
+
+// Function to run the float range kernel picked by scanKernelLevel()
+void selectFloatRange(const char *values, size_t stride, int count, float lo, float hi, uint64_t *bits) {
+    switch (scanKernelLevel()) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            selectFloatRangeAvx2(values, stride, count, lo, hi, bits);
+            break;
+        case SCAN_SSE2:
+            selectFloatRangeSse2(values, stride, count, lo, hi, bits);
+            break;
+#endif
+        default:
+            selectFloatRangeScalar(values, stride, count, lo, hi, bits);
+    }
+}
+
+// Function to allocate a row bitmap of the given number of 64-bit words
+uint64_t *newBitmap(int words) {
+    uint64_t *bits = malloc(sizeof(uint64_t) * (words ? words : 1));
+    if (!bits) {
+        perror("Memory allocation failed");
         exit(EXIT_FAILURE);
     }
+    return bits;
+}
 
-    char line[MAX_LINE_LENGTH];
-    #pragma omp parallel private(line) // Parallelize reading lines
-    {
-        while (fgets(line, sizeof(line), file)) {
-            Item item;
-            if (sscanf(line, "%d,%49[^,],%49[^,],%d,%f", &item.id, item.name, item.category, &item.quantity, &item.price) == 5) {
-                #pragma omp critical // Ensure thread safety for adding items
-                {
-                    if (itemCount >= itemCapacity) {
-                        itemCapacity *= 2;
-                        items = realloc(items, sizeof(Item) * itemCapacity);
-                        if (!items) {
-                            perror("Memory allocation failed");
-                            exit(EXIT_FAILURE);
-                        }
-                    }
-                    items[itemCount++] = item;
-                }
+// Function to select the rows whose int field (passed as &ITEM_xxx(0)) lies in [lo, hi]. Threads take blocks of
+// SCAN_BLOCK_WORDS words, so every thread streams its own stretch of the table.
+void selectIntColumn(const int *first, int lo, int hi, uint64_t *bits) {
+    int words = (itemCount + 63) / 64;
+    scanKernelLevel(); // Detect the CPU before the threads start
+    #pragma omp parallel for schedule(static)
+    for (int block = 0; block < words; block += SCAN_BLOCK_WORDS) {
+        int rows = itemCount - block * 64 < SCAN_BLOCK_WORDS * 64 ? itemCount - block * 64 : SCAN_BLOCK_WORDS * 64;
+        selectIntRange((const char *)first + (size_t)block * 64 * COLUMN_STRIDE, COLUMN_STRIDE, rows, lo, hi, bits + block);
+    }
+}
+
+// Function to select the rows whose float field lies in [lo, hi]
+void selectFloatColumn(const float *first, float lo, float hi, uint64_t *bits) {
+    int words = (itemCount + 63) / 64;
+    scanKernelLevel();
+    #pragma omp parallel for schedule(static)
+    for (int block = 0; block < words; block += SCAN_BLOCK_WORDS) {
+        int rows = itemCount - block * 64 < SCAN_BLOCK_WORDS * 64 ? itemCount - block * 64 : SCAN_BLOCK_WORDS * 64;
+        selectFloatRange((const char *)first + (size_t)block * 64 * COLUMN_STRIDE, COLUMN_STRIDE, rows, lo, hi, bits + block);
+    }
+}
+
+// Function to intersect one row bitmap with another
+void andBitmaps(uint64_t *bits, const uint64_t *other, int words) {
+    #pragma omp parallel for simd schedule(static)
+    for (int w = 0; w < words; w++) {
+        bits[w] &= other[w];
+    }
+}
+
+// Function to select the live rows matching a filter. One kernel pass per bounded field; the ID pass always
+// runs because it also drops tombstones. category is the filter's category resolved to a code, or -1 for any.
+void selectFilterRows(const BulkFilter *filter, int category, uint64_t *selected) {
+    int words = (itemCount + 63) / 64;
+    selectIntColumn(&ITEM_ID(0), filter->minId > TOMBSTONE_ID ? filter->minId : TOMBSTONE_ID + 1, filter->maxId, selected);
+
+    uint64_t *scratch = newBitmap(words);
+    int passes = 1;
+    if (filter->minQuantity != INT_MIN || filter->maxQuantity != INT_MAX) {
+        selectIntColumn(&ITEM_QUANTITY(0), filter->minQuantity, filter->maxQuantity, scratch);
+        andBitmaps(selected, scratch, words);
+        passes++;
+    }
+    if (filter->minPrice != -FLT_MAX || filter->maxPrice != FLT_MAX) {
+        selectFloatColumn(&ITEM_PRICE(0), filter->minPrice, filter->maxPrice, scratch);
+        andBitmaps(selected, scratch, words);
+        passes++;
+    }
+    noteWork(itemCount, (long long)itemCount * COLUMN_STRIDE * passes);
+    if (category >= 0) {
+        andBitmaps(selected, categoryRows[category], words);
+    }
+    free(scratch);
+}
+
+// Function to reset a filter so that it matches every item
+void initBulkFilter(BulkFilter *filter) {
+    filter->category[0] = '\0';
+    filter->minId = INT_MIN + 1; // INT_MIN is TOMBSTONE_ID
+    filter->maxId = INT_MAX;
+    filter->minQuantity = INT_MIN;
+    filter->maxQuantity = INT_MAX;
+    filter->minPrice = -FLT_MAX;
+    filter->maxPrice = FLT_MAX;
+}
+
+// Function to test one row against a filter and apply the action if it matches; returns 1 on a match.
+// category is the filter's category already resolved to a code, or -1 for any.
+int filteredUpdateRow(const BulkFilter *filter, int category, const BulkAction *action, int row) {
+    int id = ITEM_ID(row);
+    if (id == TOMBSTONE_ID || id < filter->minId || id > filter->maxId ||
+        (category >= 0 && ITEM_CATEGORY(row) != category) ||
+        ITEM_QUANTITY(row) < filter->minQuantity || ITEM_QUANTITY(row) > filter->maxQuantity ||
+        ITEM_PRICE(row) < filter->minPrice || ITEM_PRICE(row) > filter->maxPrice) {
+        return 0;
+    }
+    applyBulkAction(action, row);
+    return 1;
+}
+
+// Function to apply a filtered bulk update's action to one row
+void applyBulkAction(const BulkAction *action, int row) {
+    aggregateRow(row, -1);
+    if (action->quantityMode == BULK_ADD) {
+        ITEM_QUANTITY(row) += action->quantity;
+    } else if (action->quantityMode == BULK_SET) {
+        ITEM_QUANTITY(row) = action->quantity;
+    }
+    if (action->priceMode == BULK_ADD) {
+        ITEM_PRICE(row) += action->price;
+    } else if (action->priceMode == BULK_SET) {
+        ITEM_PRICE(row) = action->price;
+    } else if (action->priceMode == BULK_SCALE) {
+        ITEM_PRICE(row) *= action->price;
+    }
+    aggregateRow(row, 1);
+    trackStock(row);
+}
+
+// Function to apply an action to every item matching a filter in one pass. The candidates come from
+// whichever source is cheapest: the range scan kernels over every row, the category's bitmap, or one
+// index probe per id in the range. Candidates of the last two are checked against the whole filter.
+// Returns the match count.
+int applyFilteredUpdate(const BulkFilter *filter, const BulkAction *action, int *plan) {
+    int category = -1;
+    if (filter->category[0]) {
+        category = findCategory(filter->category);
+        if (category < 0) {
+            *plan = BULK_PLAN_CATEGORY;
+            return 0;
+        }
+    }
+
+    long long idSpan = filter->maxId >= filter->minId ? (long long)filter->maxId - filter->minId + 1 : 0;
+    long long cost = itemCount;
+    *plan = BULK_PLAN_SCAN;
+    if (category >= 0 && categoryItemCount[category] + itemCount / 64 < cost) {
+        cost = categoryItemCount[category] + itemCount / 64;
+        *plan = BULK_PLAN_CATEGORY;
+    }
+    if (idSpan * BULK_PROBE_COST < cost) {
+        *plan = BULK_PLAN_ID;
+    }
+
+    int matched = 0;
+    if (*plan == BULK_PLAN_ID) {
+        uint64_t ownRows = workRows;
+        long long found = 0;
+        #pragma omp parallel for reduction(+:matched, found) schedule(dynamic, 4096)
+        for (long long id = filter->minId; id <= filter->maxId; id++) {
+            int row = findItemRow((int)id);
+            if (row >= 0) {
+                matched += filteredUpdateRow(filter, category, action, row);
+                found++;
+            }
+        }
+        // This thread's probes are already counted; the other threads' went to their own counters
+        found -= (long long)(workRows - ownRows);
+        noteWork(found, found * ITEM_BYTES);
+    } else if (*plan == BULK_PLAN_CATEGORY) {
+        int words = (itemCount + 63) / 64;
+        noteWork(categoryItemCount[category], (long long)categoryItemCount[category] * ITEM_BYTES);
+        #pragma omp parallel for reduction(+:matched) schedule(static)
+        for (int w = 0; w < words; w++) {
+            for (uint64_t bits = categoryRows[category][w]; bits; bits &= bits - 1) {
+                matched += filteredUpdateRow(filter, category, action, w * 64 + __builtin_ctzll(bits));
+            }
+        }
+    } else {
+        int words = (itemCount + 63) / 64;
+        uint64_t *selected = newBitmap(words);
+        selectFilterRows(filter, category, selected);
+        #pragma omp parallel for reduction(+:matched) schedule(static)
+        for (int w = 0; w < words; w++) {
+            for (uint64_t bits = selected[w]; bits; bits &= bits - 1) {
+                applyBulkAction(action, w * 64 + __builtin_ctzll(bits));
+                matched++;
             }
         }
+        free(selected);
     }
-    fclose(file);
+    return matched;
 }
 
-// Function to add an item to the dataset
-void addItem(int id, const char *name, const char *category, int quantity, float price) {
-    #pragma omp critical // Ensure thread safety when adding an item
+// Function to read a filter from the user
+void promptBulkFilter(BulkFilter *filter) {
+    int low, high;
+    initBulkFilter(filter);
+    printf("Enter category to match (- for any): ");
+    scanf("%49s", filter->category);
+    if (strcmp(filter->category, "-") == 0) {
+        filter->category[0] = '\0';
+    }
+    printf("Enter ID range to match (min max, -1 for no bound): ");
+    scanf("%d %d", &low, &high);
+    if (low >= 0) filter->minId = low;
+    if (high >= 0) filter->maxId = high;
+    printf("Enter quantity range to match (min max, -1 for no bound): ");
+    scanf("%d %d", &low, &high);
+    if (low >= 0) filter->minQuantity = low;
+    if (high >= 0) filter->maxQuantity = high;
+    printf("Enter price range to match (min max, -1 for no bound): ");
+    float lowPrice, highPrice;
+    scanf("%f %f", &lowPrice, &highPrice);
+    if (lowPrice >= 0) filter->minPrice = lowPrice;
+    if (highPrice >= 0) filter->maxPrice = highPrice;
+}
+
+// Function to read a filtered bulk update from the user
+void promptFilteredUpdate(BulkFilter *filter, BulkAction *action) {
+    promptBulkFilter(filter);
+    printf("Enter quantity action (0 keep, 1 add, 2 set) and value: ");
+    scanf("%d %d", &action->quantityMode, &action->quantity);
+    printf("Enter price action (0 keep, 1 add, 2 set, 3 scale) and value: ");
+    scanf("%d %f", &action->priceMode, &action->price);
+}
+
+// Function to run a filtered bulk update and report it
+void processFilteredUpdate(const BulkFilter *filter, const BulkAction *action) {
+    const char *planNames[] = {"a full scan", "the category bitmap", "the id index"};
+    double start = omp_get_wtime();
+    int plan;
+    int matched = applyFilteredUpdate(filter, action, &plan);
+    double elapsed = omp_get_wtime() - start;
+
+    walLogFiltered(filter, action);
+
+    printf("\nFiltered bulk update completed: %d items matched using %s.\n", matched, planNames[plan]);
+    printf("Total processing time: %.3f seconds\n", elapsed);
+}
+
+// Function to append a row at items[itemCount], doubling the storage when it is full. The ID index is not touched.
+void appendRow(int id, const char *name, int category, int quantity, float price) {
+    if (itemCount >= itemCapacity) {
+        reserveRows(itemCapacity * 2);
+    }
+
+    ITEM_ID(itemCount) = id;
+    items[itemCount].nameOffset = storeName(name, strlen(name));
+    ITEM_CATEGORY(itemCount) = (unsigned char)category;
+    ITEM_QUANTITY(itemCount) = quantity;
+    ITEM_PRICE(itemCount) = price;
+    categoryAddRow(itemCount);
+    itemCount++;
+}
+
+// Function to move row src into slot dst. Slot dst must not hold a live row (its category bit must already be clear).
+void moveRow(int dst, int src) {
+    categoryRemoveRow(src);
+    int low = untrackStock(src);
+    items[dst] = items[src];
+#ifdef COLUMNAR_STORE
+    columns.id[dst] = columns.id[src];
+    columns.quantity[dst] = columns.quantity[src];
+    columns.price[dst] = columns.price[src];
+    columns.category[dst] = columns.category[src];
+#endif
+    categoryAddRow(dst);
+    if (low) {
+        __atomic_fetch_or(&lowStockRows[dst >> 6], (uint64_t)1 << (dst & 63), __ATOMIC_RELAXED);
+    }
+}
+
+// Function to release the row storage
+void freeRows() {
+    free(items);
+    free(rowVersions);
+#ifdef COLUMNAR_STORE
+    free(columns.id);
+    free(columns.quantity);
+    free(columns.price);
+    free(columns.category);
+#endif
+    for (int c = 0; c < categoryCount; c++) {
+        free(categoryRows[c]);
+    }
+    free(lowStockRows);
+    free(nameArena);
+}
+
+// Function to make room for extra more bytes in the name arena, doubling it as needed
+void reserveNames(size_t extra) {
+    if (nameArenaLength + extra > UINT32_MAX) {
+        fprintf(stderr, "Error: item names exceed the 4 GB name arena.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (nameArenaLength + extra <= nameArenaCapacity) {
+        return;
+    }
+    size_t capacity = nameArenaCapacity ? nameArenaCapacity : NAME_ARENA_MIN_BYTES;
+    while (capacity < nameArenaLength + extra) {
+        capacity *= 2;
+    }
+    nameArena = realloc(nameArena, capacity);
+    if (!nameArena) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    nameArenaCapacity = capacity;
+}
+
+// Function to append a name (clipped to NAME_MAX_LENGTH characters) to the name arena. Returns its offset.
+uint32_t storeName(const char *name, size_t length) {
+    if (length > NAME_MAX_LENGTH) {
+        length = NAME_MAX_LENGTH;
+    }
+    reserveNames(length + 1);
+    uint32_t offset = (uint32_t)nameArenaLength;
+    memcpy(nameArena + offset, name, length);
+    nameArena[offset + length] = '\0';
+    nameArenaLength += length + 1;
+    return offset;
+}
+
+// Function to give a row a new name; the old one becomes garbage
+void renameRow(int row, const char *name) {
+    nameArenaGarbage += strlen(ITEM_NAME(row)) + 1;
+    items[row].nameOffset = storeName(name, strlen(name));
+}
+
+// Function to drop the name of a deleted row. A row left behind as a tombstone keeps the terminator, so its name
+// reads as empty.
+void releaseName(int row, int tombstone) {
+    size_t length = strlen(ITEM_NAME(row));
+    if (tombstone) {
+        items[row].nameOffset += (uint32_t)length;
+        nameArenaGarbage += length;
+    } else {
+        nameArenaGarbage += length + 1;
+    }
+}
+
+// Function to rewrite the name arena with just the names of rows [0, itemCount), in row order, so a scan over
+// the rows reads the names sequentially. Each thread sizes the names of its block of rows, a prefix sum gives
+// every block its output offset, and the blocks are then copied in parallel.
+void compactNames() {
+    size_t live = nameArenaLength - nameArenaGarbage;
+    size_t capacity = live + live / 2 > NAME_ARENA_MIN_BYTES ? live + live / 2 : NAME_ARENA_MIN_BYTES;
+    char *arena = malloc(capacity);
+    size_t *blockStart = calloc(omp_get_max_threads() + 1, sizeof(size_t));
+    if (!arena || !blockStart) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t length = 0;
+    #pragma omp parallel
     {
-        if (itemCount >= itemCapacity) {
-            itemCapacity *= 2;
-            items = realloc(items, sizeof(Item) * itemCapacity);
-            if (!items) {
-                perror("Memory allocation failed");
-                exit(EXIT_FAILURE);
+        int thread = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        int begin = (int)((long long)itemCount * thread / threads);
+        int end = (int)((long long)itemCount * (thread + 1) / threads);
+
+        size_t bytes = 0;
+        for (int i = begin; i < end; i++) {
+            bytes += strlen(ITEM_NAME(i)) + 1;
+        }
+        blockStart[thread + 1] = bytes;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int t = 1; t <= threads; t++) {
+                blockStart[t] += blockStart[t - 1];
             }
+            length = blockStart[threads];
         }
 
-        items[itemCount].id = id;
-        strncpy(items[itemCount].name, name, sizeof(items[itemCount].name) - 1);
-        strncpy(items[itemCount].category, category, sizeof(items[itemCount].category) - 1);
-        items[itemCount].quantity = quantity;
-        items[itemCount].price = price;
-        itemCount++;
+        size_t out = blockStart[thread];
+        for (int i = begin; i < end; i++) {
+            size_t size = strlen(ITEM_NAME(i)) + 1;
+            memcpy(arena + out, ITEM_NAME(i), size);
+            items[i].nameOffset = (uint32_t)out;
+            out += size;
+        }
     }
-    printf("\nItem added successfully.\n");
+    free(blockStart);
+
+    free(nameArena);
+    nameArena = arena;
+    nameArenaLength = length;
+    nameArenaCapacity = capacity;
+    nameArenaGarbage = 0;
 }
 
-// Function to delete an item by ID
-void deleteItem(int id) {
-    int itemFound = 0;
-    #pragma omp parallel for
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].id == id) {
-            #pragma omp critical
-            {
-                for (int j = i; j < itemCount - 1; j++) {
-                    items[j] = items[j + 1];
-                }
-                itemCount--;
-                itemFound = 1;
-            }
+// Function to compact the name arena once garbage makes up NAME_GARBAGE_PERCENT of it
+void tidyNames() {
+    if (nameArenaGarbage * 100 > nameArenaLength * NAME_GARBAGE_PERCENT) {
+        compactNames();
+    }
+}
+
+// Function to look up a category code by name, or -1 if the category has never been seen
+int findCategory(const char *name) {
+    for (int c = 0; c < categoryCount; c++) {
+        if (strcmp(categoryNames[c], name) == 0) {
+            return c;
         }
     }
-    if (itemFound) {
-        printf("\nItem deleted successfully.\n");
-    } else {
-        printf("\nError: Item with ID %d not found.\n", id);
+    return -1;
+}
+
+// Function to return the code of a category, adding it to the dictionary on first use. Returns -1 when the dictionary is full.
+int internCategory(const char *name) {
+    int code = findCategory(name);
+    if (code >= 0 || categoryCount >= MAX_CATEGORIES) {
+        return code;
+    }
+
+    strncpy(categoryNames[categoryCount], name, sizeof(categoryNames[categoryCount]) - 1);
+    categoryNames[categoryCount][sizeof(categoryNames[categoryCount]) - 1] = '\0';
+    categoryRows[categoryCount] = calloc((itemCapacity + 63) / 64, sizeof(uint64_t));
+    if (!categoryRows[categoryCount]) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    categoryItemCount[categoryCount] = 0;
+    categoryThreshold[categoryCount] = defaultThreshold;
+    return categoryCount++;
+}
+
+// Function to mark a live row in its category's bitmap
+void categoryAddRow(int row) {
+    int code = ITEM_CATEGORY(row);
+    __atomic_fetch_or(&categoryRows[code][row >> 6], (uint64_t)1 << (row & 63), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&categoryItemCount[code], 1, __ATOMIC_RELAXED);
+}
+
+// Function to clear a row from its category's bitmap
+void categoryRemoveRow(int row) {
+    int code = ITEM_CATEGORY(row);
+    __atomic_fetch_and(&categoryRows[code][row >> 6], ~((uint64_t)1 << (row & 63)), __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&categoryItemCount[code], 1, __ATOMIC_RELAXED);
+}
+
+// Function to rebuild every category bitmap from the rows, used after rows have been permuted in bulk.
+// Each thread owns whole 64-row words, so no two threads ever write the same bitmap word.
+void rebuildCategoryBitmaps() {
+    int words = (itemCount + 63) / 64;
+    for (int c = 0; c < categoryCount; c++) {
+        // Clear the whole capacity so bits of rows past a shrunk itemCount go too
+        memset(categoryRows[c], 0, sizeof(uint64_t) * ((itemCapacity + 63) / 64));
+        categoryItemCount[c] = 0;
+    }
+    #pragma omp parallel for reduction(+:categoryItemCount[:MAX_CATEGORIES])
+    for (int w = 0; w < words; w++) {
+        int end = (w + 1) * 64 < itemCount ? (w + 1) * 64 : itemCount;
+        for (int i = w * 64; i < end; i++) {
+            if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+            categoryRows[ITEM_CATEGORY(i)][w] |= (uint64_t)1 << (i & 63);
+            categoryItemCount[ITEM_CATEGORY(i)]++;
+        }
+    }
+}
+
+// Function to return the code of a category given as a name and length (not NUL-terminated), adding it on first use
+int categoryCode(const char *name, int length) {
+    for (int c = 0; c < categoryCount; c++) {
+        if (memcmp(categoryNames[c], name, length) == 0 && categoryNames[c][length] == '\0') {
+            return c;
+        }
+    }
+
+    char copy[50];
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    return internCategory(copy);
+}
+
+// Function to load all the data files. Every file is memory-mapped and cut into newline-aligned chunks;
+// the chunks' line counts size items[] once, and then threads parse chunks straight into their own rows.
+// The name arena is sized the same way: a chunk's names can never take more bytes than the chunk.
+void loadDataFromFiles() {
+    MappedFile *files = malloc(sizeof(MappedFile) * dataFileCount);
+    if (!files) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t totalBytes = 0;
+    for (int i = 0; i < dataFileCount; i++) {
+        char filename[50];
+        sprintf(filename, "warehouse_data_%d.csv", i + 1);
+        mapFile(filename, &files[i]);
+        totalBytes += files[i].size;
+    }
+
+    LoadChunk *chunks = malloc(sizeof(LoadChunk) * (totalBytes / LOAD_CHUNK_BYTES + dataFileCount));
+    if (!chunks) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    int chunkCount = 0;
+    for (int i = 0; i < dataFileCount; i++) {
+        const char *end = files[i].data + files[i].size;
+        const char *begin = skipHeader(files[i].data, end);
+        while (begin < end) {
+            const char *cut = end;
+            if ((size_t)(end - begin) > LOAD_CHUNK_BYTES) {
+                cut = memchr(begin + LOAD_CHUNK_BYTES, '\n', end - begin - LOAD_CHUNK_BYTES);
+                cut = cut ? cut + 1 : end;
+            }
+            chunks[chunkCount].begin = begin;
+            chunks[chunkCount].end = cut;
+            chunkCount++;
+            begin = cut;
+        }
+    }
+
+    #pragma omp parallel for
+    for (int c = 0; c < chunkCount; c++) {
+        chunks[c].rows = (int)countLines(chunks[c].begin, chunks[c].end);
+    }
+    long long rows = itemCount;
+    size_t nameBytes = nameArenaLength;
+    for (int c = 0; c < chunkCount; c++) {
+        chunks[c].firstRow = (int)rows;
+        rows += chunks[c].rows;
+        chunks[c].firstName = nameBytes;
+        nameBytes += chunks[c].end - chunks[c].begin;
+    }
+    if (rows > itemCapacity) {
+        reserveRows((int)rows);
+    }
+    reserveNames(nameBytes - nameArenaLength);
+
+    #pragma omp parallel
+    {
+        int categoryCache[MAX_CATEGORIES]; // Codes this thread has already resolved
+        int cachedCategories = 0;
+        #pragma omp for schedule(dynamic)
+        for (int c = 0; c < chunkCount; c++) {
+            chunks[c].rows = loadChunk(&chunks[c], categoryCache, &cachedCategories);
+        }
+    }
+
+    // Lines that did not parse leave unused rows at the end of their chunk, and every chunk leaves unused name
+    // bytes; slide later chunks' rows and names down over them
+    int out = itemCount;
+    size_t nameOut = nameArenaLength;
+    for (int c = 0; c < chunkCount; c++) {
+        if (chunks[c].firstRow != out) {
+            shiftRows(out, chunks[c].firstRow, chunks[c].rows);
+            chunks[c].firstRow = out;
+        }
+        if (chunks[c].firstName != nameOut) {
+            memmove(nameArena + nameOut, nameArena + chunks[c].firstName, chunks[c].nameBytes);
+            chunks[c].firstName = nameOut;
+        }
+        out += chunks[c].rows;
+        nameOut += chunks[c].nameBytes;
+    }
+    // loadChunk stored name offsets relative to the chunk's stretch
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < chunkCount; c++) {
+        for (int r = chunks[c].firstRow; r < chunks[c].firstRow + chunks[c].rows; r++) {
+            items[r].nameOffset += (uint32_t)chunks[c].firstName;
+        }
+    }
+    itemCount = out;
+    nameArenaLength = nameOut;
+    if (nameArenaCapacity > nameOut + NAME_ARENA_MIN_BYTES) {
+        char *arena = realloc(nameArena, nameOut + NAME_ARENA_MIN_BYTES); // Give back the unused stretches
+        if (arena) {
+            nameArena = arena;
+            nameArenaCapacity = nameOut + NAME_ARENA_MIN_BYTES;
+        }
+    }
+    free(chunks);
+    for (int i = 0; i < dataFileCount; i++) {
+        unmapFile(&files[i]);
+    }
+    free(files);
+
+    rebuildCategoryBitmaps();
+    buildIndex();
+    buildNameIndex();
+    rebuildAggregates();
+}
+
+// Function to map a whole data file into memory read-only. An empty file maps to data == NULL.
+void mapFile(const char *filename, MappedFile *file) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror("Error reading file size");
+        exit(EXIT_FAILURE);
+    }
+    file->size = (size_t)info.st_size;
+    file->data = NULL;
+    if (file->size > 0) {
+        file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (file->data == MAP_FAILED) {
+            perror("Error mapping file");
+            exit(EXIT_FAILURE);
+        }
+        madvise(file->data, file->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+// Function to release a mapping made by mapFile
+void unmapFile(MappedFile *file) {
+    if (file->data) {
+        munmap(file->data, file->size);
+    }
+}
+
+// Function to count the lines in [begin, end), including a final line with no newline. Used as an upper bound on rows.
+size_t countLines(const char *begin, const char *end) {
+    size_t lines = 0;
+    const char *p = begin;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        lines++;
+        p++;
+    }
+    if (end > begin && end[-1] != '\n') {
+        lines++;
+    }
+    return lines;
+}
+
+// Function to return the start of the first data row, skipping a header line that does not begin with a number
+const char *skipHeader(const char *begin, const char *end) {
+    if (begin < end && *begin != '-' && (*begin < '0' || *begin > '9')) {
+        const char *newline = memchr(begin, '\n', end - begin);
+        return newline ? newline + 1 : end;
+    }
+    return begin;
+}
+
+// Function to parse an optionally negative integer at *p, leaving *p just past it. Returns 0 if there is no valid number.
+int parseIntField(const char **p, const char *end, int *value) {
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && *s == '-') {
+        negative = 1;
+        s++;
+    }
+    if (s == end || *s < '0' || *s > '9') {
+        return 0;
+    }
+
+    long long v = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+        if (v > (long long)INT_MAX + 1) {
+            return 0;
+        }
+    }
+    if (negative) v = -v;
+    if (v > INT_MAX) {
+        return 0;
+    }
+    *value = (int)v;
+    *p = s;
+    return 1;
+}
+
+// Function to parse a plain decimal such as 12.34 or -0.5 at *p, leaving *p just past it
+int parsePriceField(const char **p, const char *end, float *value) {
+    static const double scale[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && *s == '-') {
+        negative = 1;
+        s++;
+    }
+
+    long long mantissa = 0;
+    int digits = 0, fraction = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+        if (digits < 18) mantissa = mantissa * 10 + (*s - '0');
+        else fraction--; // Drop digits a float cannot hold but keep the magnitude
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+            if (digits < 18 && fraction < 9) {
+                mantissa = mantissa * 10 + (*s - '0');
+                fraction++;
+            }
+        }
+    }
+    if (digits == 0) {
+        return 0;
+    }
+
+    double v = fraction >= 0 ? mantissa / scale[fraction] : mantissa * scale[-fraction < 9 ? -fraction : 9];
+    *value = (float)(negative ? -v : v);
+    *p = s;
+    return 1;
+}
+
+// Function to parse one "id,name,category,quantity,price" row from [line, end). Text fields are returned as
+// pointers into the line plus a length; names are clipped to NAME_MAX_LENGTH characters and categories to 49.
+int parseRow(const char *line, const char *end, int *id, const char **name, int *nameLength,
+             const char **category, int *categoryLength, int *quantity, float *price) {
+    const char *p = line;
+    if (!parseIntField(&p, end, id) || p == end || *p++ != ',') {
+        return 0;
+    }
+
+    *name = p;
+    while (p < end && *p != ',') p++;
+    *nameLength = p - *name < NAME_MAX_LENGTH ? (int)(p - *name) : NAME_MAX_LENGTH;
+    if (*nameLength == 0 || p == end || *p++ != ',') {
+        return 0;
+    }
+
+    *category = p;
+    while (p < end && *p != ',') p++;
+    *categoryLength = p - *category < 49 ? (int)(p - *category) : 49;
+    if (*categoryLength == 0 || p == end || *p++ != ',') {
+        return 0;
+    }
+
+    return parseIntField(&p, end, quantity) && p < end && *p++ == ',' && parsePriceField(&p, end, price);
+}
+
+// Function to parse one chunk into items[chunk->firstRow...] and its names into nameArena[chunk->firstName...],
+// and return the number of rows written. Rows go straight into their final slots, so no lock is taken except to
+// add a category this thread has not seen.
+int loadChunk(LoadChunk *chunk, int *categoryCache, int *cachedCategories) {
+    int row = chunk->firstRow;
+    char *names = nameArena + chunk->firstName;
+    size_t nameBytes = 0;
+    const char *line = chunk->begin;
+    while (line < chunk->end) {
+        const char *lineEnd = memchr(line, '\n', chunk->end - line);
+        if (!lineEnd) lineEnd = chunk->end;
+
+        int id, quantity, nameLength, categoryLength;
+        const char *name, *category;
+        float price;
+        if (parseRow(line, lineEnd, &id, &name, &nameLength, &category, &categoryLength, &quantity, &price)) {
+            int code = -1;
+            for (int k = 0; k < *cachedCategories; k++) {
+                int c = categoryCache[k];
+                if (memcmp(categoryNames[c], category, categoryLength) == 0 && categoryNames[c][categoryLength] == '\0') {
+                    code = c;
+                    break;
+                }
+            }
+            if (code < 0) {
+                #pragma omp critical // Ensure thread safety when adding to the category dictionary
+                code = categoryCode(category, categoryLength);
+                if (code >= 0) {
+                    categoryCache[(*cachedCategories)++] = code;
+                }
+            }
+
+            if (code >= 0) {
+                memcpy(names + nameBytes, name, nameLength);
+                names[nameBytes + nameLength] = '\0';
+                items[row].nameOffset = (uint32_t)nameBytes;
+                nameBytes += nameLength + 1;
+                ITEM_ID(row) = id;
+                ITEM_CATEGORY(row) = (unsigned char)code;
+                ITEM_QUANTITY(row) = quantity;
+                ITEM_PRICE(row) = price;
+                row++;
+            }
+        }
+        line = lineEnd + 1;
+    }
+    chunk->nameBytes = nameBytes;
+    return row - chunk->firstRow;
+}
+
+// Function to slide count rows from src down to dst. The ID index and category bitmaps are not touched.
+void shiftRows(int dst, int src, int count) {
+    memmove(&items[dst], &items[src], sizeof(Item) * count);
+#ifdef COLUMNAR_STORE
+    memmove(&columns.id[dst], &columns.id[src], sizeof(int) * count);
+    memmove(&columns.quantity[dst], &columns.quantity[src], sizeof(int) * count);
+    memmove(&columns.price[dst], &columns.price[src], sizeof(float) * count);
+    memmove(&columns.category[dst], &columns.category[src], sizeof(unsigned char) * count);
+#endif
+}
+
+// Function to map an item ID to its home slot (Fibonacci hashing keeps sequential IDs spread out)
+unsigned int hashId(int id) {
+    return ((unsigned int)id * 2654435769u) >> idIndexShift;
+}
+
+// Function to allocate an empty index with the given power-of-two capacity
+void indexAllocate(int capacity) {
+    IndexSlot *slots = malloc(sizeof(IndexSlot) * capacity);
+    if (!slots) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < capacity; i++) {
+        slots[i].row = INDEX_EMPTY;
+    }
+
+    free(idIndex);
+    idIndex = slots;
+    idIndexCapacity = capacity;
+    idIndexShift = 32;
+    while (capacity > 1) {
+        capacity >>= 1;
+        idIndexShift--;
+    }
+    idIndexCount = 0;
+}
+
+// Function to double the index capacity and rehash every entry
+void indexGrow() {
+    IndexSlot *old = idIndex;
+    int oldCapacity = idIndexCapacity;
+
+    idIndex = NULL;
+    indexAllocate(oldCapacity * 2);
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].row != INDEX_EMPTY) {
+            indexInsert(old[i].id, old[i].row);
+        }
+    }
+    free(old);
+}
+
+// Function to find the row of an item by ID, or INDEX_EMPTY if it is not stored
+int findItemRow(int id) {
+    unsigned int mask = idIndexCapacity - 1;
+    for (unsigned int slot = hashId(id); ; slot = (slot + 1) & mask) {
+        if (idIndex[slot].row == INDEX_EMPTY) {
+            return INDEX_EMPTY;
+        }
+        if (idIndex[slot].id == id) {
+            noteWork(1, ITEM_BYTES);
+            return idIndex[slot].row;
+        }
+    }
+}
+
+// Function to add an ID to the index. Returns 0 (and changes nothing) if the ID is already present.
+int indexInsert(int id, int row) {
+    // Keep the load factor under 70% so probe sequences stay short
+    if ((long long)(idIndexCount + 1) * 10 > (long long)idIndexCapacity * 7) {
+        indexGrow();
+    }
+
+    unsigned int mask = idIndexCapacity - 1;
+    unsigned int slot = hashId(id);
+    while (idIndex[slot].row != INDEX_EMPTY) {
+        if (idIndex[slot].id == id) {
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+    idIndex[slot].id = id;
+    idIndex[slot].row = row;
+    idIndexCount++;
+    return 1;
+}
+
+// Function to remove an ID from the index using backward-shift deletion (no tombstones needed)
+void indexRemove(int id) {
+    unsigned int mask = idIndexCapacity - 1;
+    unsigned int hole = hashId(id);
+    while (idIndex[hole].row != INDEX_EMPTY && idIndex[hole].id != id) {
+        hole = (hole + 1) & mask;
+    }
+    if (idIndex[hole].row == INDEX_EMPTY) {
+        return;
+    }
+
+    // Pull later entries of the probe run back into the hole unless that would move them before their home slot
+    for (unsigned int next = (hole + 1) & mask; idIndex[next].row != INDEX_EMPTY; next = (next + 1) & mask) {
+        unsigned int home = hashId(idIndex[next].id);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            idIndex[hole] = idIndex[next];
+            hole = next;
+        }
+    }
+    idIndex[hole].row = INDEX_EMPTY;
+    idIndexCount--;
+}
+
+// Function to point an indexed ID at a new row after the item has been moved
+void indexSetRow(int id, int row) {
+    unsigned int mask = idIndexCapacity - 1;
+    for (unsigned int slot = hashId(id); idIndex[slot].row != INDEX_EMPTY; slot = (slot + 1) & mask) {
+        if (idIndex[slot].id == id) {
+            idIndex[slot].row = row;
+            return;
+        }
+    }
+}
+
+// Function to (re)build the ID index from items[]. Rows whose ID was already seen are dropped.
+void buildIndex() {
+    int capacity = MIN_INDEX_CAPACITY;
+    while ((long long)itemCount * 10 > (long long)capacity * 7) {
+        capacity *= 2;
+    }
+    indexAllocate(capacity);
+
+    int kept = 0;
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID) {
+            nameArenaGarbage++; // The terminator its empty name kept
+            continue;
+        }
+        if (!indexInsert(ITEM_ID(i), kept)) {
+            categoryRemoveRow(i);
+            releaseName(i, 0);
+            continue;
+        }
+        if (kept != i) {
+            moveRow(kept, i);
+        }
+        kept++;
+    }
+
+    if (kept + tombstoneCount != itemCount) {
+        printf("Skipped %d rows with duplicate or reserved IDs.\n", itemCount - tombstoneCount - kept);
+    }
+    itemCount = kept;
+    tombstoneCount = 0;
+}
+
+// Function to squeeze tombstoned slots out of items[] while keeping live rows in their current order.
+// Each thread counts the live rows of its block, a prefix sum gives every block its output offset,
+// and the blocks are then copied into a fresh array in parallel.
+void compactItems() {
+    if (tombstoneCount == 0) {
+        return;
+    }
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES);
+
+    Item *compacted = malloc(sizeof(Item) * itemCapacity);
+    int *blockStart = calloc(omp_get_max_threads() + 1, sizeof(int));
+    if (!compacted || !blockStart) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+#ifdef COLUMNAR_STORE
+    int *compactedId = malloc(sizeof(int) * itemCapacity);
+    int *compactedQuantity = malloc(sizeof(int) * itemCapacity);
+    float *compactedPrice = malloc(sizeof(float) * itemCapacity);
+    unsigned char *compactedCategory = malloc(sizeof(unsigned char) * itemCapacity);
+    if (!compactedId || !compactedQuantity || !compactedPrice || !compactedCategory) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    #pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        int begin = (int)((long long)itemCount * thread / threads);
+        int end = (int)((long long)itemCount * (thread + 1) / threads);
+
+        int live = 0;
+        for (int i = begin; i < end; i++) {
+            if (ITEM_ID(i) != TOMBSTONE_ID) live++;
+        }
+        blockStart[thread + 1] = live;
+
+        #pragma omp barrier
+        #pragma omp single
+        for (int t = 1; t <= threads; t++) {
+            blockStart[t] += blockStart[t - 1];
+        }
+
+        int out = blockStart[thread];
+        for (int i = begin; i < end; i++) {
+            if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+            compacted[out] = items[i];
+#ifdef COLUMNAR_STORE
+            compactedId[out] = columns.id[i];
+            compactedQuantity[out] = columns.quantity[i];
+            compactedPrice[out] = columns.price[i];
+            compactedCategory[out] = columns.category[i];
+#endif
+            out++;
+        }
+    }
+
+    free(items);
+    items = compacted;
+#ifdef COLUMNAR_STORE
+    free(columns.id);
+    free(columns.quantity);
+    free(columns.price);
+    free(columns.category);
+    columns.id = compactedId;
+    columns.quantity = compactedQuantity;
+    columns.price = compactedPrice;
+    columns.category = compactedCategory;
+#endif
+    nameArenaGarbage += tombstoneCount; // The terminators the tombstones' empty names still held
+    itemCount -= tombstoneCount;
+    tombstoneCount = 0;
+    free(blockStart);
+
+    for (int i = 0; i < itemCount; i++) {
+        indexSetRow(ITEM_ID(i), i);
+    }
+    rebuildCategoryBitmaps();
+    rebuildLowStockRows();
+}
+
+// Function to report the outcome of a mutation
+void reportResult(int result, int id, const char *success) {
+    switch (result) {
+        case RESULT_OK:
+            printf("\n%s\n", success);
+            break;
+        case RESULT_NOT_FOUND:
+            printf("\nError: Item with ID %d not found.\n", id);
+            break;
+        case RESULT_EXISTS:
+            printf("\nError: Item with ID %d already exists.\n", id);
+            break;
+        case RESULT_RESERVED_ID:
+            printf("\nError: Item ID %d is reserved.\n", id);
+            break;
+        case RESULT_TOO_MANY_CATEGORIES:
+            printf("\nError: Too many categories (at most %d).\n", MAX_CATEGORIES);
+            break;
+    }
+}
+
+// Function to add an item to the dataset and log it. Returns RESULT_OK or the reason the item was rejected.
+int applyAddItem(int id, const char *name, const char *category, int quantity, float price) {
+    int result = RESULT_RESERVED_ID;
+    if (id == TOMBSTONE_ID) {
+        return result;
+    }
+    beginExclusive(); // A new row may grow the storage and the index
+    if (findItemRow(id) != INDEX_EMPTY) {
+        result = RESULT_EXISTS;
+    } else {
+        int code = internCategory(category);
+        if (code < 0) {
+            result = RESULT_TOO_MANY_CATEGORIES;
+        } else {
+            indexInsert(id, itemCount);
+            appendRow(id, name, code, quantity, price);
+            indexName(id, ITEM_NAME(itemCount - 1));
+            aggregateRow(itemCount - 1, 1);
+            trackStock(itemCount - 1);
+            walLogItem(WAL_RECORD_ADD, id, name, category, quantity, price);
+            result = RESULT_OK;
+        }
+    }
+    endExclusive();
+    return result;
+}
+
+// Function to add an item to the dataset
+void addItem(int id, const char *name, const char *category, int quantity, float price) {
+    reportResult(applyAddItem(id, name, category, quantity, price), id, "Item added successfully.");
+}
+
+// Function to delete an item by ID in O(1): the slot is either tombstoned or refilled with the last row
+int applyDeleteItem(int id) {
+    int result = RESULT_NOT_FOUND;
+    beginExclusive(); // Deleting moves index entries, and in swap mode a row
+    int i = findItemRow(id);
+    if (i != INDEX_EMPTY) {
+        unindexName(ITEM_NAME(i));
+        aggregateRow(i, -1);
+        untrackStock(i);
+        indexRemove(id);
+        categoryRemoveRow(i);
+        releaseName(i, i != itemCount - 1 && deleteMode != DELETE_MODE_SWAP);
+        if (i == itemCount - 1) {
+            itemCount--;
+        } else if (deleteMode == DELETE_MODE_SWAP) {
+            moveRow(i, itemCount - 1);
+            indexSetRow(ITEM_ID(i), i);
+            itemCount--;
+        } else {
+            // Clear the payload as well; every scan skips rows whose ID is TOMBSTONE_ID
+            ITEM_ID(i) = TOMBSTONE_ID;
+            ITEM_QUANTITY(i) = 0;
+            ITEM_PRICE(i) = 0;
+            tombstoneCount++;
+            if ((long long)tombstoneCount * 100 > (long long)itemCount * AUTO_COMPACT_PERCENT) {
+                compactItems();
+            }
+        }
+        walLogDelete(id);
+        tidyNameIndex();
+        tidyNames();
+        result = RESULT_OK;
+    }
+    endExclusive();
+    return result;
+}
+
+// Function to delete an item by ID
+void deleteItem(int id) {
+    reportResult(applyDeleteItem(id), id, "Item deleted successfully.");
+}
+
+
+// Function to retrieve an item by ID
+void retrieveItem(int id) {
+    int i = findItemRow(id);
+    if (i == INDEX_EMPTY) {
+        printf("\nError: Item with ID %d not found.\n", id);
+        return;
+    }
+
+    printf("\nItem Details:\n");
+    printf("ID: %d\nName: %s\nCategory: %s\nQuantity: %d\nPrice: %.2f\n",
+           ITEM_ID(i), ITEM_NAME(i), ITEM_CATEGORY_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
+}
+
+
+// Function to update the given fields of an item (NULL or negative leaves a field unchanged) and log it
+int applyUpdateItem(int id, const char *name, const char *category, int quantity, float price) {
+    int result = RESULT_NOT_FOUND;
+    if (name || (category && findCategory(category) < 0)) {
+        // A rename appends to the name arena, which may move it, and a new category has to be interned: both are
+        // structural changes
+        beginExclusive();
+        int i = findItemRow(id);
+        int code = category ? internCategory(category) : 0;
+        if (i != INDEX_EMPTY && code < 0) {
+            result = RESULT_TOO_MANY_CATEGORIES;
+        } else if (i != INDEX_EMPTY) {
+            aggregateRow(i, -1);
+            if (name && strncmp(ITEM_NAME(i), name, NAME_MAX_LENGTH) != 0) {
+                unindexName(ITEM_NAME(i));
+                renameRow(i, name);
+                indexName(id, ITEM_NAME(i));
+                tidyNameIndex();
+                tidyNames();
+            }
+            if (category) {
+                categoryRemoveRow(i);
+                ITEM_CATEGORY(i) = (unsigned char)code;
+                categoryAddRow(i);
+            }
+            if (quantity >= 0) ITEM_QUANTITY(i) = quantity;
+            if (price >= 0) ITEM_PRICE(i) = price;
+            aggregateRow(i, 1);
+            trackStock(i);
+            walLogItem(WAL_RECORD_UPDATE, id, name, category, quantity, price);
+            result = RESULT_OK;
+        }
+        endExclusive();
+        return result;
+    }
+
+    // Everything else is an in-place change of one row: shared mode, the id's stripe lock and the row's seqlock
+    omp_lock_t *lock = &stripeLocks[idStripe(id)];
+    beginShared();
+    omp_set_lock(lock);
+    int i = findItemRow(id);
+    if (i != INDEX_EMPTY) {
+        beginRowWrite(i);
+        aggregateRow(i, -1);
+        if (category) {
+            categoryRemoveRow(i);
+            ITEM_CATEGORY(i) = (unsigned char)findCategory(category);
+            categoryAddRow(i);
+        }
+        if (quantity >= 0) ITEM_QUANTITY(i) = quantity;
+        if (price >= 0) ITEM_PRICE(i) = price;
+        aggregateRow(i, 1);
+        endRowWrite(i);
+        trackStock(i);
+        walLogItem(WAL_RECORD_UPDATE, id, name, category, quantity, price);
+        result = RESULT_OK;
+    }
+    omp_unset_lock(lock);
+    endShared();
+    return result;
+}
+
+// Function to update an item
+void updateItem(int id, const char *name, const char *category, int quantity, float price) {
+    reportResult(applyUpdateItem(id, name, category, quantity, price), id, "Item updated successfully.");
+}
+
+// Function to add the deltas to rows [begin, end). Each field gets its own loop so that under
+// COLUMNAR_STORE both are straight passes over one contiguous column, which the compiler vectorizes.
+void bulkUpdateRows(int begin, int end, int quantityDelta, float priceDelta) {
+    #pragma omp simd
+    for (int i = begin; i < end; i++) {
+        ITEM_QUANTITY(i) += quantityDelta;
+    }
+    if (priceDelta != 0.0f) {
+        #pragma omp simd
+        for (int i = begin; i < end; i++) {
+            ITEM_PRICE(i) += priceDelta;
+        }
+    }
+}
+
+// Function to apply a bulk update to every row. Threads take contiguous bands of chunks; progress is a
+// shared counter bumped atomically, and the thread that carries it past a step prints, so no worker waits.
+void applyBulkUpdate(int quantityDelta, float priceDelta, int reportProgress) {
+    int chunks = (itemCount + BULK_CHUNK_ROWS - 1) / BULK_CHUNK_ROWS;
+    int done = 0;
+    noteWork(itemCount, (long long)itemCount * COLUMN_STRIDE * (priceDelta != 0.0f ? 2 : 1));
+
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        int begin = c * BULK_CHUNK_ROWS;
+        int end = begin + BULK_CHUNK_ROWS < itemCount ? begin + BULK_CHUNK_ROWS : itemCount;
+        aggregateRows(begin, end, -1);
+        bulkUpdateRows(begin, end, quantityDelta, priceDelta);
+        aggregateRows(begin, end, 1);
+        trackStockRows(begin, end);
+
+        if (reportProgress) {
+            int before;
+            #pragma omp atomic capture
+            { before = done; done += end - begin; }
+            if (before / BULK_PROGRESS_ROWS != (before + end - begin) / BULK_PROGRESS_ROWS) {
+                printf("Processing done for %d items.\n", before + end - begin);
+            }
+        }
+    }
+}
+
+void processBulkUpdates(int quantityDelta, float priceDelta) {
+    double start = omp_get_wtime();
+    applyBulkUpdate(quantityDelta, priceDelta, 1);
+    double elapsed = omp_get_wtime() - start;
+
+    walLogBulk(quantityDelta, priceDelta);
+
+    printf("\nBulk update completed: Incremented all quantities by %d", quantityDelta);
+    if (priceDelta != 0.0f) {
+        printf(" and all prices by %.2f", priceDelta);
+    }
+    printf(".\nTotal processing time: %.3f seconds\n", elapsed);
+}
+
+// Function to add a row index to a list, doubling its storage when it is full
+void rowListAppend(RowList *list, int row) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->rows = realloc(list->rows, sizeof(int) * list->capacity);
+        if (!list->rows) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    list->rows[list->count++] = row;
+}
+
+// Function to test a live row against a QUERY_* predicate
+int rowMatches(int query, int row, const char *keyword) {
+    switch (query) {
+        case QUERY_NAME:
+            return strstr(ITEM_NAME(row), keyword) != NULL;
+        case QUERY_PREFIX:
+            return nameMatches(ITEM_NAME(row), keyword, 1);
+        default:
+            return 1;
+    }
+}
+
+// Function to collect the rows matching a QUERY_* predicate, in storage order.
+// Each thread scans one contiguous block of rows into its own list; the lists are then copied side by side,
+// so the result needs no sorting and no thread ever waits for another while matching.
+void collectRows(int query, const char *keyword, RowList *result) {
+    int threads = omp_get_max_threads();
+    RowList *parts = calloc(threads, sizeof(RowList));
+    int *offsets = malloc(sizeof(int) * (threads + 1));
+    if (!parts || !offsets) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num(), used = omp_get_num_threads();
+        int begin = (int)((long long)itemCount * t / used);
+        int end = (int)((long long)itemCount * (t + 1) / used);
+        for (int i = begin; i < end; i++) {
+            if (ITEM_ID(i) != TOMBSTONE_ID && rowMatches(query, i, keyword)) {
+                rowListAppend(&parts[t], i);
+            }
+        }
+        #pragma omp barrier
+        #pragma omp single
+        {
+            offsets[0] = 0;
+            for (int p = 0; p < threads; p++) {
+                offsets[p + 1] = offsets[p] + parts[p].count;
+            }
+            result->count = result->capacity = offsets[threads];
+            result->rows = malloc(sizeof(int) * (result->count ? result->count : 1));
+            if (!result->rows) {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (parts[t].count) {
+            memcpy(result->rows + offsets[t], parts[t].rows, sizeof(int) * parts[t].count);
+        }
+    }
+
+    for (int p = 0; p < threads; p++) {
+        free(parts[p].rows);
+    }
+    free(parts);
+    free(offsets);
+}
+
+// Function to collect the rows set in a bitmap (a category's, or a scan kernel's selection), in storage order.
+// The bitmap already gives every block its offset: each thread counts the bits of its block of words, then
+// fills its own stretch of the result.
+void collectBitmapRows(const uint64_t *bits, int words, RowList *result) {
+    int threads = omp_get_max_threads();
+    int *offsets = calloc(threads + 1, sizeof(int));
+    if (!offsets) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num(), used = omp_get_num_threads();
+        int begin = (int)((long long)words * t / used);
+        int end = (int)((long long)words * (t + 1) / used);
+        int count = 0;
+        for (int w = begin; w < end; w++) {
+            count += __builtin_popcountll(bits[w]);
+        }
+        offsets[t + 1] = count;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int p = 0; p < used; p++) {
+                offsets[p + 1] += offsets[p];
+            }
+            result->count = result->capacity = offsets[used];
+            result->rows = malloc(sizeof(int) * (result->count ? result->count : 1));
+            if (!result->rows) {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+        int next = offsets[t];
+        for (int w = begin; w < end; w++) {
+            for (uint64_t word = bits[w]; word; word &= word - 1) {
+                result->rows[next++] = w * 64 + __builtin_ctzll(word);
+            }
+        }
+    }
+    free(offsets);
+}
+
+// Function to print a query result through one buffer per page, honouring --limit and pausing every --page-rows rows
+void printRows(const RowList *list, int format) {
+    int shown = list->count;
+    if (resultLimit > 0 && shown > resultLimit) {
+        shown = resultLimit;
+    }
+
+    TextBuffer page = {0};
+    for (int start = 0; start < shown; ) {
+        int end = pageRows > 0 && shown - start > pageRows ? start + pageRows : shown;
+        page.length = 0;
+        for (int r = start; r < end; r++) {
+            int i = list->rows[r];
+            if (format == ROW_FORMAT_NO_CATEGORY) {
+                textAppend(&page, "ID: %d | Name: %s | Quantity: %d | Price: %.2f\n",
+                           ITEM_ID(i), ITEM_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
+            } else {
+                textAppend(&page, "ID: %d | Name: %s | Category: %s | Quantity: %d | Price: %.2f\n",
+                           ITEM_ID(i), ITEM_NAME(i), ITEM_CATEGORY_NAME(i), ITEM_QUANTITY(i), ITEM_PRICE(i));
+            }
+        }
+        fwrite(page.data, 1, page.length, stdout);
+        start = end;
+
+        if (start < shown) {
+            char answer = 'n';
+            printf("-- Rows 1-%d of %d shown. Show more? (y/n): ", start, shown);
+            uint64_t waitStart = monotonicNs();
+            int read = scanf(" %c", &answer);
+            pausedNs += monotonicNs() - waitStart;
+            if (read != 1 || (answer != 'y' && answer != 'Y')) {
+                break;
+            }
+        }
+    }
+    free(page.data);
+
+    if (shown < list->count) {
+        printf("-- %d more rows not shown (--limit=%d).\n", list->count - shown, resultLimit);
+    }
+}
+
+// Function to list the index buckets of a name's trigrams. With anchored set the name is read as if it began
+// with two GRAM_ANCHOR bytes, which gives its first one and two characters grams of their own.
+int nameGrams(const char *name, int anchored, unsigned int *buckets) {
+    unsigned char text[NAME_MAX_LENGTH + 2];
+    int length = 0;
+    if (anchored) {
+        text[length++] = GRAM_ANCHOR;
+        text[length++] = GRAM_ANCHOR;
+    }
+    while (*name && length < (int)sizeof(text)) {
+        text[length++] = (unsigned char)*name++;
+    }
+
+    int count = 0;
+    for (int i = 0; i + 2 < length; i++) {
+        unsigned int gram = (unsigned int)text[i] << 16 | (unsigned int)text[i + 1] << 8 | text[i + 2];
+        buckets[count++] = (gram * 2654435769u) >> (32 - GRAM_BUCKET_BITS);
+    }
+    return count;
+}
+
+// Function to add an item's name to the trigram index
+void indexName(int id, const char *name) {
+    unsigned int buckets[NAME_MAX_LENGTH + 2];
+    int count = nameGrams(name, 1, buckets);
+    for (int g = 0; g < count; g++) {
+        GramList *list = &gramLists[buckets[g]];
+        if (list->count && list->ids[list->count - 1] == id) {
+            continue; // Two grams of this name share a bucket
+        }
+        if (list->count == list->capacity) {
+            list->capacity = list->capacity ? list->capacity * 2 : 16;
+            list->ids = realloc(list->ids, sizeof(int) * list->capacity);
+            if (!list->ids) {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+        list->ids[list->count++] = id;
+        gramEntries++;
+    }
+}
+
+// Function to retire a name that is about to be overwritten or deleted. Its entries stay in the lists until the next rebuild.
+void unindexName(const char *name) {
+    unsigned int buckets[NAME_MAX_LENGTH + 2];
+    gramStale += nameGrams(name, 1, buckets);
+}
+
+// Function to (re)build the trigram index from the live rows
+void buildNameIndex() {
+    for (int b = 0; b < GRAM_BUCKETS; b++) {
+        gramLists[b].count = 0;
+    }
+    gramEntries = 0;
+    gramStale = 0;
+    for (int i = 0; i < itemCount; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID) {
+            indexName(ITEM_ID(i), ITEM_NAME(i));
+        }
+    }
+}
+
+// Function to rebuild the trigram index once stale entries outnumber live ones
+void tidyNameIndex() {
+    if (gramStale * 2 > gramEntries) {
+        buildNameIndex();
+    }
+}
+
+// Function to release the trigram index
+void freeNameIndex() {
+    for (int b = 0; b < GRAM_BUCKETS; b++) {
+        free(gramLists[b].ids);
+        gramLists[b].ids = NULL;
+        gramLists[b].count = gramLists[b].capacity = 0;
+    }
+}
+
+// Function to test a name against a search keyword: a substring match, or with prefix set a match at the start
+int nameMatches(const char *name, const char *keyword, int prefix) {
+    return prefix ? strncmp(name, keyword, strlen(keyword)) == 0 : strstr(name, keyword) != NULL;
+}
+
+// Function to order row numbers for qsort()
+int compareRows(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to find the live rows whose name contains pattern, in storage order. A pattern ending in '*' matches
+// names that start with the rest. The rarest trigram of the pattern supplies the candidates when its list is
+// short enough to beat a parallel scan; patterns without a trigram (under three characters) always scan.
+void findNameRows(const char *pattern, RowList *result) {
+    char keyword[NAME_MAX_LENGTH + 2]; // Room for a whole name plus the '*' of a prefix pattern
+    strncpy(keyword, pattern, sizeof(keyword) - 1);
+    keyword[sizeof(keyword) - 1] = '\0';
+    size_t length = strlen(keyword);
+    int prefix = length > 0 && keyword[length - 1] == '*';
+    if (prefix) {
+        keyword[length - 1] = '\0';
+    }
+
+    unsigned int buckets[NAME_MAX_LENGTH + 2];
+    int grams = nameGrams(keyword, prefix, buckets);
+    const GramList *best = NULL;
+    for (int g = 0; g < grams; g++) {
+        if (!best || gramLists[buckets[g]].count < best->count) {
+            best = &gramLists[buckets[g]];
+        }
+    }
+
+    if (!best || (long long)best->count * GRAM_PROBE_COST >= itemCount) {
+        noteWork(itemCount, (long long)itemCount * sizeof(Item) + (long long)(nameArenaLength - nameArenaGarbage));
+        collectRows(prefix ? QUERY_PREFIX : QUERY_NAME, keyword, result);
+        return;
+    }
+
+    for (int c = 0; c < best->count; c++) {
+        int i = findItemRow(best->ids[c]);
+        if (i != INDEX_EMPTY && nameMatches(ITEM_NAME(i), keyword, prefix)) {
+            rowListAppend(result, i);
+        }
+    }
+    // An ID is listed again after it is renamed back or re-added, so sort and drop repeats
+    qsort(result->rows, result->count, sizeof(int), compareRows);
+    int unique = 0;
+    for (int r = 0; r < result->count; r++) {
+        if (unique == 0 || result->rows[unique - 1] != result->rows[r]) {
+            result->rows[unique++] = result->rows[r];
+        }
+    }
+    result->count = unique;
+}
+
+// Function to search for items by name (partial match, or prefix match for a keyword ending in *)
+void searchItems(const char *keyword) {
+    printf("\nSearch Results for '%s':\n", keyword);
+    RowList matches = {0};
+    findNameRows(keyword, &matches);
+    if (matches.count == 0) {
+        printf("No items found matching '%s'.\n", keyword);
+    } else {
+        printRows(&matches, ROW_FORMAT_FULL);
+        printf("%d items found.\n", matches.count);
+    }
+    free(matches.rows);
+}
+
+// Function to map a float onto an unsigned key with the same ordering (flip all bits of negatives, the sign bit of positives)
+unsigned int floatSortKey(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Function to compute the radix key of a row for a numeric sort column
+unsigned int rowSortKey(int row, int column) {
+    switch (column) {
+        case SORT_BY_QUANTITY: return (unsigned int)ITEM_QUANTITY(row) ^ 0x80000000u;
+        case SORT_BY_ID:       return (unsigned int)ITEM_ID(row) ^ 0x80000000u;
+        default:               return floatSortKey(ITEM_PRICE(row));
+    }
+}
+
+// Function to decide whether entry x belongs before entry y. Ties fall back to the row number so every sort is stable.
+int entryBefore(const SortEntry *x, const SortEntry *y, int byName, int descending) {
+    if (byName) {
+        int cmp = strcmp(ITEM_NAME(x->row), ITEM_NAME(y->row));
+        if (cmp != 0) return descending ? cmp > 0 : cmp < 0;
+    } else if (x->key != y->key) {
+        return x->key < y->key; // Numeric keys are already inverted for descending sorts
+    }
+    return x->row < y->row;
+}
+
+// Function to LSD radix sort entries on their 32-bit key, one byte per pass. Passes where every key shares the same byte are skipped.
+void radixSortEntries(SortEntry *entries, SortEntry *scratch, int n) {
+    int counts[4][256] = {{0}};
+    for (int i = 0; i < n; i++) {
+        unsigned int key = entries[i].key;
+        counts[0][key & 0xFF]++;
+        counts[1][(key >> 8) & 0xFF]++;
+        counts[2][(key >> 16) & 0xFF]++;
+        counts[3][key >> 24]++;
+    }
+
+    SortEntry *src = entries, *dst = scratch;
+    for (int pass = 0; pass < 4; pass++) {
+        int shift = pass * 8;
+        if (n == 0 || counts[pass][(src[0].key >> shift) & 0xFF] == n) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            int count = counts[pass][digit];
+            counts[pass][digit] = offset;
+            offset += count;
+        }
+        for (int i = 0; i < n; i++) {
+            dst[counts[pass][(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+
+        SortEntry *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != entries) {
+        memcpy(entries, src, sizeof(SortEntry) * n);
+    }
+}
+
+// Function to merge two sorted runs into out
+void mergeEntries(const SortEntry *a, int na, const SortEntry *b, int nb, SortEntry *out, int byName, int descending) {
+    int i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        out[k++] = entryBefore(&b[j], &a[i], byName, descending) ? b[j++] : a[i++];
+    }
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
+
+// Function to sort entries by item name: insertion-sorted runs followed by bottom-up merges
+void mergeSortByName(SortEntry *entries, SortEntry *scratch, int n, int descending) {
+    for (int start = 0; start < n; start += NAME_RUN_LENGTH) {
+        int end = start + NAME_RUN_LENGTH < n ? start + NAME_RUN_LENGTH : n;
+        for (int i = start + 1; i < end; i++) {
+            SortEntry entry = entries[i];
+            int j = i - 1;
+            while (j >= start && entryBefore(&entry, &entries[j], 1, descending)) {
+                entries[j + 1] = entries[j];
+                j--;
+            }
+            entries[j + 1] = entry;
+        }
+    }
+
+    SortEntry *src = entries, *dst = scratch;
+    for (int width = NAME_RUN_LENGTH; width < n; width *= 2) {
+        for (int start = 0; start < n; start += 2 * width) {
+            int mid = start + width < n ? start + width : n;
+            int end = start + 2 * width < n ? start + 2 * width : n;
+            mergeEntries(src + start, mid - start, src + mid, end - mid, dst + start, 1, descending);
+        }
+        SortEntry *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != entries) {
+        memcpy(entries, src, sizeof(SortEntry) * n);
+    }
+}
+
+// Function to find where the merge path crosses a diagonal: the number of elements of a among the first `diagonal` merged outputs
+int mergePathSplit(const SortEntry *a, int na, const SortEntry *b, int nb, int diagonal, int byName, int descending) {
+    int lo = diagonal > nb ? diagonal - nb : 0;
+    int hi = diagonal < na ? diagonal : na;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (entryBefore(&b[diagonal - mid - 1], &a[mid], byName, descending)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+// Function to merge two sorted runs with every thread: each thread takes an equal slice of the output,
+// locates its start and end on the merge path by binary search and merges that slice on its own
+void parallelMerge(const SortEntry *a, int na, const SortEntry *b, int nb, SortEntry *out, int byName, int descending) {
+    #pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        int total = na + nb;
+        int first = (int)((long long)total * thread / threads);
+        int last = (int)((long long)total * (thread + 1) / threads);
+        int aFirst = mergePathSplit(a, na, b, nb, first, byName, descending);
+        int aLast = mergePathSplit(a, na, b, nb, last, byName, descending);
+        mergeEntries(a + aFirst, aLast - aFirst, b + (first - aFirst), (last - aLast) - (first - aFirst),
+                     out + first, byName, descending);
+    }
+}
+
+// Function to reorder items[] by a sorted permutation with a single parallel gather, then repoint the ID index
+void applySortOrder(const SortEntry *entries, int n) {
+    Item *sorted = malloc(sizeof(Item) * itemCapacity);
+    if (!sorted) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        sorted[i] = items[entries[i].row];
+    }
+    free(items);
+    items = sorted;
+
+#ifdef COLUMNAR_STORE
+    int *sortedId = malloc(sizeof(int) * itemCapacity);
+    int *sortedQuantity = malloc(sizeof(int) * itemCapacity);
+    float *sortedPrice = malloc(sizeof(float) * itemCapacity);
+    unsigned char *sortedCategory = malloc(sizeof(unsigned char) * itemCapacity);
+    if (!sortedId || !sortedQuantity || !sortedPrice || !sortedCategory) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        int row = entries[i].row;
+        sortedId[i] = columns.id[row];
+        sortedQuantity[i] = columns.quantity[row];
+        sortedPrice[i] = columns.price[row];
+        sortedCategory[i] = columns.category[row];
+    }
+    free(columns.id);
+    free(columns.quantity);
+    free(columns.price);
+    free(columns.category);
+    columns.id = sortedId;
+    columns.quantity = sortedQuantity;
+    columns.price = sortedPrice;
+    columns.category = sortedCategory;
+#endif
+    rebuildCategoryBitmaps();
+    rebuildLowStockRows();
+    compactNames();
+
+    for (int i = 0; i < n; i++) {
+        indexSetRow(ITEM_ID(i), i);
+    }
+}
+
+// Function to sort items by any column. Only an 8-byte (key, row) permutation is sorted: every thread
+// radix sorts (or merge sorts, for names) its own block, then the blocks are merged pairwise with all
+// threads cooperating on each merge. The rows move once at the end.
+void sortItems(int column, int descending) {
+    compactItems();
+    int n = itemCount;
+    int byName = column == SORT_BY_NAME;
+    SortEntry *entries = malloc(sizeof(SortEntry) * (n > 0 ? n : 1));
+    SortEntry *scratch = malloc(sizeof(SortEntry) * (n > 0 ? n : 1));
+    int *runStart = malloc(sizeof(int) * (omp_get_max_threads() + 1));
+    if (!entries || !scratch || !runStart) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    int runs = 1;
+    #pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        int begin = (int)((long long)n * thread / threads);
+        int end = (int)((long long)n * (thread + 1) / threads);
+
+        for (int i = begin; i < end; i++) {
+            entries[i].row = i;
+            entries[i].key = byName ? 0 : rowSortKey(i, column);
+            if (descending) entries[i].key = ~entries[i].key;
+        }
+        if (byName) {
+            mergeSortByName(entries + begin, scratch + begin, end - begin, descending);
+        } else {
+            radixSortEntries(entries + begin, scratch + begin, end - begin);
+        }
+
+        runStart[thread] = begin;
+        #pragma omp single
+        {
+            runs = threads;
+            runStart[threads] = n;
+        }
+    }
+
+    SortEntry *src = entries, *dst = scratch;
+    while (runs > 1) {
+        int merged = 0;
+        for (int r = 0; r < runs; r += 2) {
+            int begin = runStart[r];
+            if (r + 1 < runs) {
+                int mid = runStart[r + 1];
+                int end = runStart[r + 2];
+                parallelMerge(src + begin, mid - begin, src + mid, end - mid, dst + begin, byName, descending);
+            } else {
+                memcpy(dst + begin, src + begin, sizeof(SortEntry) * (runStart[r + 1] - begin));
+            }
+            runStart[merged++] = begin;
+        }
+        runStart[merged] = n;
+        runs = merged;
+
+        SortEntry *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    applySortOrder(src, n);
+    noteWork(n, (long long)n * ITEM_BYTES);
+
+    free(entries);
+    free(scratch);
+    free(runStart);
+}
+
+// Function to checksum one WAL record body (FNV-1a), so a torn or corrupt tail is detected on replay
+uint32_t walChecksum(const unsigned char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Function to write every buffered WAL record to the log file
+void walFlush() {
+    size_t written = 0;
+    while (written < walBuffered) {
+        ssize_t n = write(walFd, walBuffer + written, walBuffered - written);
+        if (n < 0) {
+            perror("Error writing WAL");
+            exit(EXIT_FAILURE);
+        }
+        written += (size_t)n;
+    }
+    walBuffered = 0;
+}
+
+// Function to append a record with the next LSN to the WAL buffer. Does nothing while no WAL is open (or during replay).
+void walAppend(int type, const unsigned char *payload, size_t size) {
+    if (walFd < 0) {
+        return;
+    }
+
+    #pragma omp critical(walLog) // Records may come from several threads
+    {
+        uint32_t length = (uint32_t)(sizeof(uint64_t) + 1 + size);
+        if (walBuffered + 2 * sizeof(uint32_t) + length > WAL_BUFFER_BYTES) {
+            walFlush();
+        }
+
+        unsigned char *record = walBuffer + walBuffered;
+        unsigned char *body = record + 2 * sizeof(uint32_t);
+        uint64_t lsn = ++walSequence;
+        memcpy(body, &lsn, sizeof(lsn));
+        body[sizeof(lsn)] = (unsigned char)type;
+        memcpy(body + sizeof(lsn) + 1, payload, size);
+
+        uint32_t checksum = walChecksum(body, length);
+        memcpy(record, &length, sizeof(length));
+        memcpy(record + sizeof(length), &checksum, sizeof(checksum));
+        walBuffered += 2 * sizeof(uint32_t) + length;
+    }
+}
+
+// Function to log an added or updated item. Payload: id, flags, quantity, price, then name and category
+// each as a length byte plus characters. flags says which fields an update changes.
+void walLogItem(int type, int id, const char *name, const char *category, int quantity, float price) {
+    unsigned char payload[2 * sizeof(int) + sizeof(float) + 3 + NAME_MAX_LENGTH + 49];
+    unsigned char flags = 0;
+    if (name) flags |= WAL_FIELD_NAME;
+    if (category) flags |= WAL_FIELD_CATEGORY;
+    if (type == WAL_RECORD_ADD || quantity >= 0) flags |= WAL_FIELD_QUANTITY;
+    if (type == WAL_RECORD_ADD || price >= 0) flags |= WAL_FIELD_PRICE;
+
+    size_t size = 0;
+    memcpy(payload + size, &id, sizeof(id));
+    size += sizeof(id);
+    payload[size++] = flags;
+    memcpy(payload + size, &quantity, sizeof(quantity));
+    size += sizeof(quantity);
+    memcpy(payload + size, &price, sizeof(price));
+    size += sizeof(price);
+
+    const char *text[2] = {name ? name : "", category ? category : ""};
+    for (int t = 0; t < 2; t++) {
+        size_t limit = t == 0 ? NAME_MAX_LENGTH : 49;
+        size_t length = strlen(text[t]) < limit ? strlen(text[t]) : limit;
+        payload[size++] = (unsigned char)length;
+        memcpy(payload + size, text[t], length);
+        size += length;
+    }
+    walAppend(type, payload, size);
+}
+
+// Function to log a deleted item
+void walLogDelete(int id) {
+    walAppend(WAL_RECORD_DELETE, (const unsigned char *)&id, sizeof(id));
+}
+
+// Function to log a bulk update
+void walLogBulk(int quantityDelta, float priceDelta) {
+    unsigned char payload[sizeof(int) + sizeof(float)];
+    memcpy(payload, &quantityDelta, sizeof(quantityDelta));
+    memcpy(payload + sizeof(quantityDelta), &priceDelta, sizeof(priceDelta));
+    walAppend(WAL_RECORD_BULK, payload, sizeof(payload));
+}
+
+// Function to log a filtered bulk update; the category travels by name, so replay does not depend on codes
+void walLogFiltered(const BulkFilter *filter, const BulkAction *action) {
+    unsigned char payload[sizeof(BulkFilter) + sizeof(BulkAction)];
+    memcpy(payload, filter, sizeof(BulkFilter));
+    memcpy(payload + sizeof(BulkFilter), action, sizeof(BulkAction));
+    walAppend(WAL_RECORD_FILTERED, payload, sizeof(payload));
+}
+
+// Function to end a group of mutations: write the buffered records with one write() and fdatasync()
+// once every walSyncEvery commits. Records are safe from a process crash as soon as this returns.
+void walCommit() {
+    if (walFd < 0 || walBuffered == 0) {
+        return;
+    }
+
+    walFlush();
+    if (walSyncEvery > 0 && ++walUnsynced >= walSyncEvery) {
+        fdatasync(walFd);
+        walUnsynced = 0;
+    }
+}
+
+// Function to flush, sync and close the WAL on a clean exit
+void walClose() {
+    if (walFd < 0) {
+        return;
+    }
+
+    walFlush();
+    fdatasync(walFd);
+    close(walFd);
+    walFd = -1;
+}
+
+// Function to apply one logged mutation during replay
+void walReplay(int type, const unsigned char *payload, size_t size) {
+    int id, quantity;
+    float price;
+    char text[2][NAME_MAX_LENGTH + 1];
+
+    if (type == WAL_RECORD_DELETE && size == sizeof(int)) {
+        memcpy(&id, payload, sizeof(id));
+        applyDeleteItem(id);
+    } else if (type == WAL_RECORD_BULK && size == sizeof(int) + sizeof(float)) {
+        memcpy(&quantity, payload, sizeof(quantity));
+        memcpy(&price, payload + sizeof(int), sizeof(price));
+        applyBulkUpdate(quantity, price, 0);
+    } else if (type == WAL_RECORD_FILTERED && size == sizeof(BulkFilter) + sizeof(BulkAction)) {
+        BulkFilter filter;
+        BulkAction action;
+        int plan;
+        memcpy(&filter, payload, sizeof(filter));
+        memcpy(&action, payload + sizeof(filter), sizeof(action));
+        filter.category[sizeof(filter.category) - 1] = '\0';
+        applyFilteredUpdate(&filter, &action, &plan);
+    } else if ((type == WAL_RECORD_ADD || type == WAL_RECORD_UPDATE) && size >= 2 * sizeof(int) + sizeof(float) + 3) {
+        size_t p = 0;
+        memcpy(&id, payload + p, sizeof(id));
+        p += sizeof(id);
+        unsigned char flags = payload[p++];
+        memcpy(&quantity, payload + p, sizeof(quantity));
+        p += sizeof(quantity);
+        memcpy(&price, payload + p, sizeof(price));
+        p += sizeof(price);
+        for (int t = 0; t < 2; t++) {
+            size_t length = p < size ? payload[p++] : 0;
+            if (length > (t == 0 ? NAME_MAX_LENGTH : 49) || p + length > size) {
+                return;
+            }
+            memcpy(text[t], payload + p, length);
+            text[t][length] = '\0';
+            p += length;
+        }
+
+        if (type == WAL_RECORD_ADD) {
+            applyAddItem(id, text[0], text[1], quantity, price);
+        } else {
+            applyUpdateItem(id, (flags & WAL_FIELD_NAME) ? text[0] : NULL, (flags & WAL_FIELD_CATEGORY) ? text[1] : NULL,
+                            (flags & WAL_FIELD_QUANTITY) ? quantity : -1, (flags & WAL_FIELD_PRICE) ? price : -1);
+        }
+    }
+}
+
+// Function to replay the WAL on top of the loaded table and open it for appending. Records at or below
+// walSequence (already contained in the snapshot) are skipped; an incomplete tail is cut off.
+void walOpen(const char *filename) {
+    int fd = open(filename, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Error opening WAL");
+        exit(EXIT_FAILURE);
+    }
+
+    MappedFile log;
+    mapFile(filename, &log);
+    const unsigned char *data = (const unsigned char *)log.data;
+    size_t offset = 0;
+    int replayed = 0, skipped = 0;
+    while (log.size - offset >= 2 * sizeof(uint32_t)) {
+        uint32_t length, checksum;
+        memcpy(&length, data + offset, sizeof(length));
+        memcpy(&checksum, data + offset + sizeof(length), sizeof(checksum));
+        const unsigned char *body = data + offset + 2 * sizeof(uint32_t);
+        if (length <= sizeof(uint64_t) || length > log.size - offset - 2 * sizeof(uint32_t)
+            || walChecksum(body, length) != checksum) {
+            break;
+        }
+
+        uint64_t lsn;
+        memcpy(&lsn, body, sizeof(lsn));
+        if (lsn > walSequence) {
+            walReplay(body[sizeof(lsn)], body + sizeof(lsn) + 1, length - sizeof(lsn) - 1);
+            walSequence = lsn;
+            replayed++;
+        } else {
+            skipped++;
+        }
+        offset += 2 * sizeof(uint32_t) + length;
+    }
+
+    if (offset < log.size) {
+        printf("Discarding %zu bytes of incomplete WAL data.\n", log.size - offset);
+        if (ftruncate(fd, (off_t)offset) != 0) {
+            perror("Error truncating WAL");
+            exit(EXIT_FAILURE);
+        }
+    }
+    unmapFile(&log);
+    lseek(fd, (off_t)offset, SEEK_SET);
+    walFd = fd;
+    if (replayed || skipped) {
+        printf("Replayed %d WAL records (%d were already in the snapshot).\n", replayed, skipped);
+    }
+}
+
+
+// Function to write value in decimal at out. Returns the characters written.
+int formatInt(char *out, long long value) {
+    char digits[20];
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    int count = 0, length = 0;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) out[length++] = '-';
+    while (count) out[length++] = digits[--count];
+    return length;
+}
+
+// Function to write price exactly as "%.2f" would, without going through printf. A float times 100 is exact in a
+// double, so the cents and any exact half are known precisely; halves round to even, as printf rounds them.
+int formatPrice(char *out, float price) {
+    double cents = (double)price * 100;
+    if (!(cents > -1e15 && cents < 1e15)) {
+        return sprintf(out, "%.2f", price); // Huge values, infinities and NaN
+    }
+    double magnitude = cents < 0 ? -cents : cents;
+    long long whole = (long long)magnitude;
+    double fraction = magnitude - (double)whole;
+    if (fraction > 0.5 || (fraction == 0.5 && (whole & 1))) {
+        whole++;
+    }
+    int length = 0;
+    if (__builtin_signbit(price)) out[length++] = '-';
+    length += formatInt(out + length, whole / 100);
+    out[length++] = '.';
+    out[length++] = (char)('0' + whole / 10 % 10);
+    out[length++] = (char)('0' + whole % 10);
+    return length;
+}
+
+// Function to format the rows set in words [firstWord, endWord) of a selection bitmap into buffer, which must hold
+// EXPORT_ROW_BYTES per row. Returns the bytes written; a block without rows writes nothing.
+size_t formatExportBlock(int format, const uint64_t *selected, int firstWord, int endWord, char *buffer) {
+    int rows[EXPORT_BLOCK_WORDS * 64], count = 0;
+    for (int w = firstWord; w < endWord; w++) {
+        for (uint64_t bits = selected[w]; bits; bits &= bits - 1) {
+            rows[count++] = w * 64 + __builtin_ctzll(bits);
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    char *p = buffer;
+    if (format == EXPORT_CSV) {
+        for (int k = 0; k < count; k++) {
+            int i = rows[k];
+            size_t nameLength = strlen(ITEM_NAME(i)), categoryLength = strlen(ITEM_CATEGORY_NAME(i));
+            p += formatInt(p, ITEM_ID(i));
+            *p++ = ',';
+            memcpy(p, ITEM_NAME(i), nameLength);
+            p += nameLength;
+            *p++ = ',';
+            memcpy(p, ITEM_CATEGORY_NAME(i), categoryLength);
+            p += categoryLength;
+            *p++ = ',';
+            p += formatInt(p, ITEM_QUANTITY(i));
+            *p++ = ',';
+            p += formatPrice(p, ITEM_PRICE(i));
+            *p++ = '\n';
+        }
+        return p - buffer;
+    }
+
+    // Binary: the block's rows column by column; names as a column of length bytes, then the names back to back
+    uint32_t rowCount = (uint32_t)count;
+    memcpy(p, &rowCount, sizeof(rowCount));
+    p += sizeof(rowCount);
+    for (int k = 0; k < count; k++, p += sizeof(int)) memcpy(p, &ITEM_ID(rows[k]), sizeof(int));
+    for (int k = 0; k < count; k++, p += sizeof(int)) memcpy(p, &ITEM_QUANTITY(rows[k]), sizeof(int));
+    for (int k = 0; k < count; k++, p += sizeof(float)) memcpy(p, &ITEM_PRICE(rows[k]), sizeof(float));
+    for (int k = 0; k < count; k++) *p++ = (char)ITEM_CATEGORY(rows[k]);
+    unsigned char *lengths = (unsigned char *)p;
+    for (int k = 0; k < count; k++) *p++ = (char)strlen(ITEM_NAME(rows[k]));
+    for (int k = 0; k < count; k++) {
+        memcpy(p, ITEM_NAME(rows[k]), lengths[k]);
+        p += lengths[k];
+    }
+    return p - buffer;
+}
+
+// Function to write a whole buffer to fd, retrying short writes. Returns 0, or -1 with errno set.
+int writeAll(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            return -1;
+        }
+        p += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+// Function to open an export target for writing. A name ending in ".gz" is written through a gzip child process,
+// which compresses on another core while this process formats; *compressor is then its pid, otherwise 0.
+// Returns the descriptor to write to, or -1 with errno set.
+int openExportFile(const char *filename, pid_t *compressor) {
+    *compressor = 0;
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    size_t length = strlen(filename);
+    if (fd < 0 || length < 3 || strcmp(filename + length - 3, ".gz") != 0) {
+        return fd;
+    }
+
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+        close(fd);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN); // A compressor that dies shows up as a failed write instead of killing us
+    fflush(stdout);
+    *compressor = fork();
+    if (*compressor < 0) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        close(fd);
+        return -1;
+    }
+    if (*compressor == 0) {
+        dup2(pipeFds[0], STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        close(fd);
+        execlp("gzip", "gzip", "-c", (char *)NULL);
+        _exit(127);
+    }
+    close(pipeFds[0]);
+    close(fd);
+    return pipeFds[1];
+}
+
+// Function to finish an export: close the descriptor and wait for the compressor, if any. Returns 0 on success.
+int closeExportFile(int fd, pid_t compressor) {
+    int failed = close(fd) != 0;
+    if (compressor > 0) {
+        int status;
+        failed |= waitpid(compressor, &status, 0) != compressor || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to write the header and category names that start a binary export of rows rows
+int writeExportHeader(int fd, long long rows) {
+    ExportHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXPORT_MAGIC, sizeof(header.magic));
+    header.version = EXPORT_VERSION;
+    header.rowCount = (uint32_t)rows;
+    header.categoryCount = (uint32_t)categoryCount;
+    header.blockRows = EXPORT_BLOCK_WORDS * 64;
+    if (writeAll(fd, &header, sizeof(header)) != 0) {
+        return -1;
+    }
+    return writeAll(fd, categoryNames, sizeof(categoryNames[0]) * categoryCount);
+}
+
+// Function to stream the rows set in selected to filename, so no copy of the selection is ever built. Threads
+// take blocks round robin and format them into buffers of their own in parallel; the ordered region then hands
+// each buffer to write() strictly in block order, so the file is identical whatever the thread count.
+// Returns the rows written, or -1.
+long long exportRows(const char *filename, int format, const uint64_t *selected, int words) {
+    pid_t compressor;
+    int fd = openExportFile(filename, &compressor);
+    if (fd < 0) {
+        perror("Error exporting data");
+        return -1;
+    }
+
+    long long rows = 0;
+    #pragma omp parallel for reduction(+:rows)
+    for (int w = 0; w < words; w++) {
+        rows += __builtin_popcountll(selected[w]);
+    }
+    noteWork(rows, rows * ITEM_BYTES);
+    int failed = format == EXPORT_BINARY && writeExportHeader(fd, rows) != 0;
+    int blocks = (words + EXPORT_BLOCK_WORDS - 1) / EXPORT_BLOCK_WORDS;
+    #pragma omp parallel
+    {
+        char *buffer = malloc(EXPORT_BLOCK_WORDS * 64 * EXPORT_ROW_BYTES);
+        if (!buffer) {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        #pragma omp for ordered schedule(static, 1)
+        for (int b = 0; b < blocks; b++) {
+            int first = b * EXPORT_BLOCK_WORDS;
+            int end = first + EXPORT_BLOCK_WORDS < words ? first + EXPORT_BLOCK_WORDS : words;
+            size_t size = formatExportBlock(format, selected, first, end, buffer);
+            #pragma omp ordered
+            if (!failed && writeAll(fd, buffer, size) != 0) {
+                failed = 1;
+            }
+        }
+        free(buffer);
+    }
+    if (failed) {
+        perror("Error exporting data");
+    }
+    if (closeExportFile(fd, compressor) != 0 && !failed) {
+        fprintf(stderr, "Error exporting data: could not finish writing %s\n", filename);
+        failed = 1;
+    }
+    return failed ? -1 : rows;
+}
+
+// Function to export the items matching a filter (initBulkFilter matches every item) as CSV or binary columns.
+// The selection comes from the range scan kernels, exactly as for a filtered bulk update. Returns the rows
+// written, or -1 if the export failed.
+long long exportData(const char *filename, int format, const BulkFilter *filter) {
+    int category = filter->category[0] ? findCategory(filter->category) : -1;
+    int words = (itemCount + 63) / 64;
+    uint64_t *selected = newBitmap(words);
+    if (filter->category[0] && category < 0) {
+        memset(selected, 0, sizeof(uint64_t) * words); // Unknown category: nothing matches
+    } else {
+        selectFilterRows(filter, category, selected);
+    }
+    long long rows = exportRows(filename, format, selected, words);
+    free(selected);
+    return rows;
+}
+
+// Function to fold size bytes (a multiple of 8) into a running snapshot checksum
+uint64_t snapshotChecksum(uint64_t checksum, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        checksum = (checksum ^ word) * 0x9E3779B97F4A7C15ULL;
+        checksum ^= checksum >> 29;
+    }
+    return checksum;
+}
+
+// Function to round a section size up to the 8-byte alignment every snapshot section starts on
+size_t snapshotPadded(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// Function to check that a snapshot's name lengths walk its name section exactly, every name ending in its terminator
+int snapshotNamesValid(const unsigned char *lengths, const char *names, size_t n, uint64_t nameBytes) {
+    uint64_t offset = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (offset + lengths[k] >= nameBytes || memchr(names + offset, '\0', lengths[k] + 1) != names + offset + lengths[k]) {
+            return 0;
+        }
+        offset += lengths[k] + 1;
+    }
+    return offset == nameBytes;
+}
+
+// Function to append bytes to the snapshot being written, zero-padding a final partial word
+void writeSnapshotSection(FILE *file, const void *data, size_t size, uint64_t *checksum) {
+    size_t whole = size & ~(size_t)7;
+    fwrite(data, 1, size, file);
+    *checksum = snapshotChecksum(*checksum, data, whole);
+    if (size > whole) {
+        uint64_t tail = 0;
+        memcpy(&tail, (const char *)data + whole, size - whole);
+        fwrite((const char *)&tail + (size - whole), 1, 8 - (size - whole), file);
+        *checksum = snapshotChecksum(*checksum, &tail, sizeof(tail));
+    }
+}
+
+// Function to copy one field of rows [start, start + count) into buffer in snapshot (columnar) order.
+// Returns the number of bytes written.
+size_t gatherSnapshotBlock(int field, int start, int count, char *buffer) {
+    switch (field) {
+        case SNAPSHOT_FIELD_ID:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) ((int *)buffer)[k] = ITEM_ID(start + k);
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_QUANTITY:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) ((int *)buffer)[k] = ITEM_QUANTITY(start + k);
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_PRICE:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) ((float *)buffer)[k] = ITEM_PRICE(start + k);
+            return sizeof(float) * count;
+        case SNAPSHOT_FIELD_CATEGORY:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) ((unsigned char *)buffer)[k] = ITEM_CATEGORY(start + k);
+            return count;
+        default:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) ((unsigned char *)buffer)[k] = (unsigned char)strlen(ITEM_NAME(start + k));
+            return count;
+    }
+}
+
+// Function to copy one field of rows [start, start + count) back out of a snapshot section. Returns the bytes consumed.
+size_t scatterSnapshotBlock(int field, int start, int count, const char *data) {
+    switch (field) {
+        case SNAPSHOT_FIELD_ID:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) memcpy(&ITEM_ID(start + k), data + sizeof(int) * k, sizeof(int));
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_QUANTITY:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) memcpy(&ITEM_QUANTITY(start + k), data + sizeof(int) * k, sizeof(int));
+            return sizeof(int) * count;
+        case SNAPSHOT_FIELD_PRICE:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) memcpy(&ITEM_PRICE(start + k), data + sizeof(float) * k, sizeof(float));
+            return sizeof(float) * count;
+        case SNAPSHOT_FIELD_CATEGORY:
+            #pragma omp parallel for
+            for (int k = 0; k < count; k++) ITEM_CATEGORY(start + k) = (unsigned char)data[k];
+            return count;
+        default: {
+            // The names themselves follow in the name section and are appended to the arena next, back to back
+            size_t offset = nameArenaLength;
+            for (int k = 0; k < count; k++) {
+                items[start + k].nameOffset = (uint32_t)offset;
+                offset += (unsigned char)data[k] + 1;
+            }
+            return count;
+        }
+    }
+}
+
+// Function to save the whole table (rows, category dictionary and bitmaps, ID index) as a binary snapshot.
+// Deleted slots are compacted away first so the index and bitmaps can be stored exactly as they are in memory.
+void saveSnapshot(const char *filename) {
+    compactItems();
+    compactNames();
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES + (long long)nameArenaLength);
+
+    char tempName[PATH_MAX];
+    if (snprintf(tempName, sizeof(tempName), "%s.tmp", filename) >= (int)sizeof(tempName)) {
+        fprintf(stderr, "Error exporting snapshot: file name too long: %s\n", filename);
+        return;
+    }
+    FILE *file = fopen(tempName, "wb");
+    char *buffer = malloc(sizeof(int) * SNAPSHOT_BLOCK_ROWS);
+    if (!file || !buffer) {
+        perror("Error exporting snapshot");
+        if (file) fclose(file);
+        free(buffer);
+        return;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.itemCount = itemCount;
+    header.categoryCount = categoryCount;
+    header.indexCapacity = idIndexCapacity;
+    header.shard = 0;
+    header.walSequence = walSequence;
+    header.nameBytes = nameArenaLength;
+    header.shardCount = 1;
+    fwrite(&header, sizeof(header), 1, file); // Rewritten with the checksum at the end
+
+    uint64_t checksum = SNAPSHOT_CHECKSUM_SEED;
+    writeSnapshotSection(file, categoryNames, sizeof(categoryNames[0]) * categoryCount, &checksum);
+    writeSnapshotSection(file, categoryItemCount, sizeof(int) * categoryCount, &checksum);
+    for (int field = 0; field < SNAPSHOT_FIELDS; field++) {
+        for (int start = 0; start < itemCount; start += SNAPSHOT_BLOCK_ROWS) {
+            int count = itemCount - start < SNAPSHOT_BLOCK_ROWS ? itemCount - start : SNAPSHOT_BLOCK_ROWS;
+            writeSnapshotSection(file, buffer, gatherSnapshotBlock(field, start, count, buffer), &checksum);
+        }
+    }
+    writeSnapshotSection(file, nameArena, nameArenaLength, &checksum);
+    for (int c = 0; c < categoryCount; c++) {
+        writeSnapshotSection(file, categoryRows[c], sizeof(uint64_t) * ((itemCount + 63) / 64), &checksum);
+    }
+    writeSnapshotSection(file, idIndex, sizeof(IndexSlot) * idIndexCapacity, &checksum);
+    free(buffer);
+
+    header.checksum = checksum;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    if (ferror(file) | fclose(file) || rename(tempName, filename) != 0) {
+        perror("Error exporting snapshot");
+        remove(tempName);
+        return;
     }
+    printf("\nSnapshot of %d items written to %s.\n", itemCount, filename);
 }
 
+// Function to map a snapshot and check its header, size and checksum without touching the table.
+// Returns 1 if the snapshot can be restored, otherwise prints why and returns 0.
+int openSnapshot(const char *filename, MappedFile *snapshot) {
+    if (access(filename, R_OK) != 0) {
+        perror("Error opening snapshot");
+        return 0;
+    }
+    mapFile(filename, snapshot);
 
-// Function to retrieve an item by ID
-void retrieveItem(int id) {
-    int itemFound = 0;
-    #pragma omp parallel for
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].id == id) {
-            #pragma omp critical
-            {
-                printf("\nItem Details:\n");
-                printf("ID: %d\nName: %s\nCategory: %s\nQuantity: %d\nPrice: %.2f\n",
-                       items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-                itemFound = 1;
-            }
+    const SnapshotHeader *header = (const SnapshotHeader *)snapshot->data;
+    const char *problem = NULL;
+    if (snapshot->size < sizeof(SnapshotHeader) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a snapshot file";
+    } else if (header->version != SNAPSHOT_VERSION) {
+        problem = "unsupported snapshot version";
+    } else if (header->shard != 0 || header->shardCount != 1) {
+        problem = "snapshot was written by a different shard layout";
+    } else if (header->categoryCount > MAX_CATEGORIES || header->itemCount > MAX_ITEMS
+               || header->indexCapacity < MIN_INDEX_CAPACITY || (header->indexCapacity & (header->indexCapacity - 1))
+               || header->indexCapacity <= header->itemCount
+               || header->nameBytes > (uint64_t)header->itemCount * (NAME_MAX_LENGTH + 1)) {
+        problem = "corrupt snapshot header";
+    } else {
+        size_t n = header->itemCount;
+        size_t lengthsAt = sizeof(SnapshotHeader)
+            + snapshotPadded(sizeof(categoryNames[0]) * header->categoryCount)
+            + snapshotPadded(sizeof(int) * header->categoryCount)
+            + snapshotPadded(sizeof(int) * n) * 2 + snapshotPadded(sizeof(float) * n) + snapshotPadded(n);
+        size_t namesAt = lengthsAt + snapshotPadded(n);
+        size_t expected = namesAt + snapshotPadded(header->nameBytes)
+            + sizeof(uint64_t) * ((n + 63) / 64) * header->categoryCount
+            + sizeof(IndexSlot) * header->indexCapacity;
+        if (snapshot->size != expected) {
+            problem = "truncated snapshot";
+        } else if (snapshotChecksum(SNAPSHOT_CHECKSUM_SEED, snapshot->data + sizeof(SnapshotHeader),
+                                    snapshot->size - sizeof(SnapshotHeader)) != header->checksum) {
+            problem = "snapshot checksum mismatch";
+        } else if (!snapshotNamesValid((const unsigned char *)snapshot->data + lengthsAt, snapshot->data + namesAt, n,
+                                       header->nameBytes)) {
+            problem = "corrupt snapshot names";
         }
     }
-    if (!itemFound) {
-        printf("\nError: Item with ID %d not found.\n", id);
+
+    if (problem) {
+        fprintf(stderr, "Cannot use snapshot %s: %s.\n", filename, problem);
+        unmapFile(snapshot);
+        return 0;
     }
+    return 1;
 }
 
+// Function to fill the (empty) table from a snapshot accepted by openSnapshot, then unmap it
+void restoreSnapshot(MappedFile *snapshot) {
+    const SnapshotHeader *header = (const SnapshotHeader *)snapshot->data;
+    const char *p = snapshot->data + sizeof(SnapshotHeader);
+    int n = (int)header->itemCount;
+    if (n > itemCapacity) {
+        reserveRows(n);
+    }
 
-// Function to update an item's details
-void updateItem(int id, const char *name, const char *category, int quantity, float price) {
-    int itemFound = 0;
-    #pragma omp parallel for
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].id == id) {
-            #pragma omp critical
-            {
-                if (name) strncpy(items[i].name, name, sizeof(items[i].name) - 1);
-                if (category) strncpy(items[i].category, category, sizeof(items[i].category) - 1);
-                if (quantity >= 0) items[i].quantity = quantity;
-                if (price >= 0) items[i].price = price;
-                itemFound = 1;
-            }
-        }
+    const char (*names)[50] = (const char (*)[50])p;
+    for (int c = 0; c < (int)header->categoryCount; c++) {
+        char name[50];
+        memcpy(name, names[c], sizeof(name));
+        name[sizeof(name) - 1] = '\0';
+        internCategory(name);
+    }
+    p += snapshotPadded(sizeof(categoryNames[0]) * header->categoryCount);
+    memcpy(categoryItemCount, p, sizeof(int) * header->categoryCount);
+    p += snapshotPadded(sizeof(int) * header->categoryCount);
+
+    for (int field = 0; field < SNAPSHOT_FIELDS; field++) {
+        p += snapshotPadded(scatterSnapshotBlock(field, 0, n, p));
+    }
+    reserveNames(header->nameBytes);
+    memcpy(nameArena + nameArenaLength, p, header->nameBytes);
+    nameArenaLength += header->nameBytes;
+    p += snapshotPadded(header->nameBytes);
+    for (int c = 0; c < categoryCount; c++) {
+        memcpy(categoryRows[c], p, sizeof(uint64_t) * ((n + 63) / 64));
+        p += sizeof(uint64_t) * ((n + 63) / 64);
+    }
+
+    indexAllocate((int)header->indexCapacity);
+    memcpy(idIndex, p, sizeof(IndexSlot) * idIndexCapacity);
+    idIndexCount = n;
+    itemCount = n;
+    tombstoneCount = 0;
+    walSequence = header->walSequence;
+    unmapFile(snapshot);
+    buildNameIndex();
+    rebuildAggregates();
+}
+
+// Function to display items with low stock alert. The writes keep lowStockRows current, so this only collects
+// its set bits, from a copy so that the count and fill passes of collectBitmapRows see the same words.
+void stockAlert() {
+    printf("\nStock Alert: Low stock items (below their category's reorder threshold):\n");
+    RowList matches = {0};
+    int words = (itemCount + 63) / 64;
+    uint64_t *low = newBitmap(words);
+    for (int w = 0; w < words; w++) {
+        low[w] = __atomic_load_n(&lowStockRows[w], __ATOMIC_RELAXED);
     }
-    if (itemFound) {
-        printf("\nItem updated successfully.\n");
+    collectBitmapRows(low, words, &matches);
+    free(low);
+    noteWork(matches.count, (long long)matches.count * ITEM_BYTES);
+    if (matches.count == 0) {
+        printf("No items with low stock.\n");
     } else {
-        printf("\nError: Item with ID %d not found.\n", id);
+        printRows(&matches, ROW_FORMAT_FULL);
+        printf("%d items with low stock.\n", matches.count);
     }
+    free(matches.rows);
 }
 
-// Function to process bulk updates
-void processBulkUpdates(int increment) {
-    clock_t start_time, end_time;
-    double processing_time;
-    double sleep_time = 0.0;
+// Function to read the monotonic clock in nanoseconds
+uint64_t monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
 
-    start_time = clock();
+// Function to charge the operation being timed with rows scanned and bytes of row storage touched
+void noteWork(long long rows, long long bytes) {
+    workRows += rows;
+    workBytes += bytes;
+}
 
-    #pragma omp parallel for // Parallelize item quantity update
-    for (int i = 0; i < itemCount; i++) {
-        items[i].quantity += increment;
-        if (i % 100000 == 0) {
-            #pragma omp critical // Synchronize messages for progress
-            {
-                printf("\nProcessing done for %d items.\n", i);
-            }
-            sleep(2);
-            sleep_time += 2.0;
-        }
+// Function to start timing an operation
+OpTimer startOp(int op) {
+    OpTimer timer = {op, monotonicNs(), workRows, workBytes, pausedNs};
+    return timer;
+}
+
+// Function to map a latency onto its histogram bucket
+int latencyBucket(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (int)ns;
     }
+    int exponent = 63 - __builtin_clzll(ns);
+    int bucket = (exponent - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS +
+                 (int)((ns >> (exponent - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
 
-    end_time = clock();
-    processing_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
-    double total_time = processing_time + sleep_time;
+// Function to return the largest latency that falls into a bucket
+uint64_t bucketHighest(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    return ((uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS + 1) << shift) - 1;
+}
 
-    printf("\nBulk update completed: Incremented all quantities by %d.\n", increment);
-    printf("Total processing time: %.2f seconds\n", total_time);
+// Function to record the end of an operation in the calling thread's metrics
+void finishOp(const OpTimer *timer) {
+    if (timer->op == OP_NONE) {
+        return;
+    }
+    uint64_t ns = monotonicNs() - timer->startNs - (pausedNs - timer->pausedNs);
+    OpMetrics *metrics = &opMetrics[omp_get_thread_num() * OP_COUNT + timer->op];
+    metrics->count++;
+    metrics->totalNs += ns;
+    if (ns > metrics->maxNs) metrics->maxNs = ns;
+    metrics->rows += workRows - timer->rows;
+    metrics->bytes += workBytes - timer->bytes;
+    metrics->buckets[latencyBucket(ns)]++;
 }
 
-// Function to search for items by name (partial match)
-void searchItems(const char *keyword) {
-    printf("\nSearch Results for '%s':\n", keyword);
-    int found = 0;
-    #pragma omp parallel for reduction(+:found) // Parallelize search and use reduction to track found items
-    for (int i = 0; i < itemCount; i++) {
-        if (strstr(items[i].name, keyword)) {
-            #pragma omp critical // Synchronize printing search results
-            {
-                printf("ID: %d | Name: %s | Category: %s | Quantity: %d | Price: %.2f\n",
-                       items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-            }
-            found++;
+// Function to return the latency that permille thousandths of an operation's calls stayed within: the upper
+// bound of the bucket holding that rank, capped at the slowest call
+uint64_t latencyPercentile(const OpMetrics *metrics, int permille) {
+    uint64_t rank = (metrics->count * permille + 999) / 1000, seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += metrics->buckets[b];
+        if (seen > 0 && seen >= rank) {
+            uint64_t highest = bucketHighest(b);
+            return highest < metrics->maxNs ? highest : metrics->maxNs;
         }
     }
-    if (found == 0) {
-        printf("No items found matching '%s'.\n", keyword);
+    return metrics->maxNs;
+}
+
+// Function to allocate one set of metrics per thread
+void initMetrics() {
+    metricThreads = omp_get_max_threads();
+    opMetrics = calloc((size_t)metricThreads * OP_COUNT, sizeof(OpMetrics));
+    if (!opMetrics) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
     }
 }
 
-// Function to sort items by price using bubble sort (parallelized)
-void sortItemsByPrice() {
-    #pragma omp parallel for // Parallelize outer loop for bubble sort
-    for (int i = 0; i < itemCount - 1; i++) {
-        #pragma omp parallel for // Parallelize inner loop for comparisons and swaps
-        for (int j = 0; j < itemCount - i - 1; j++) {
-            if (items[j].price > items[j + 1].price) {
-                #pragma omp critical // Ensure thread safety for swapping
-                {
-                    Item temp = items[j];
-                    items[j] = items[j + 1];
-                    items[j + 1] = temp;
-                }
+// Function to sum every thread's metrics into merged[OP_COUNT]. Called between operations, never during one.
+void mergeMetrics(OpMetrics *merged) {
+    memset(merged, 0, sizeof(OpMetrics) * OP_COUNT);
+    for (int t = 0; t < metricThreads; t++) {
+        for (int op = 0; op < OP_COUNT; op++) {
+            const OpMetrics *own = &opMetrics[t * OP_COUNT + op];
+            OpMetrics *sum = &merged[op];
+            sum->count += own->count;
+            sum->totalNs += own->totalNs;
+            if (own->maxNs > sum->maxNs) sum->maxNs = own->maxNs;
+            sum->rows += own->rows;
+            sum->bytes += own->bytes;
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                sum->buckets[b] += own->buckets[b];
             }
         }
     }
-    printf("\nItems sorted by price.\n");
 }
 
-// Function to log operations to a file
-void logOperation(const char *operation, const char *details) {
-    #pragma omp critical // Ensure thread safety for writing logs
-    {
-        FILE *logFile = fopen("warehouse_log.txt", "a");
-        if (!logFile) {
-            perror("Error opening log file");
-            exit(EXIT_FAILURE);
-        }
-        fprintf(logFile, "%s: %s\n", operation, details);
-        fclose(logFile);
+// Function to append one CSV line per operation timed so far (prefix, then operation,count,mean_us,p50_us,p99_us,
+// max_us,rows_scanned,bytes_touched). Returns the number of lines.
+int formatStats(const OpMetrics *merged, const char *prefix, TextBuffer *out) {
+    int listed = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        const OpMetrics *metrics = &merged[op];
+        if (metrics->count == 0) continue;
+        textAppend(out, "%s%s,%llu,%.3f,%.3f,%.3f,%.3f,%llu,%llu\n", prefix, opNames[op], (unsigned long long)metrics->count,
+                   metrics->totalNs / 1e3 / metrics->count, latencyPercentile(metrics, 500) / 1e3,
+                   latencyPercentile(metrics, 990) / 1e3, metrics->maxNs / 1e3, (unsigned long long)metrics->rows,
+                   (unsigned long long)metrics->bytes);
+        listed++;
     }
+    return listed;
 }
 
-// Function to export data to a CSV file
-void exportData(const char *filename) {
-    #pragma omp parallel for // Parallelize exporting data
-    for (int i = 0; i < itemCount; i++) {
-        #pragma omp critical // Synchronize file writing
-        {
-            FILE *file = fopen(filename, "w");
-            if (!file) {
-                perror("Error opening file for export");
-                exit(EXIT_FAILURE);
-            }
-            fprintf(file, "%d,%s,%s,%d,%.2f\n", items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-            fclose(file);
-        }
+// Function to print the count, latency percentiles and work of every operation timed so far
+void showStats() {
+    OpMetrics *merged = malloc(sizeof(OpMetrics) * OP_COUNT);
+    if (!merged) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
     }
+    mergeMetrics(merged);
+    printf("\n======================================= Operation Stats =======================================\n");
+    printf("| %-15s | %8s | %10s | %10s | %10s | %12s | %14s |\n", "Operation", "Count", "p50 (us)", "p99 (us)",
+           "Max (us)", "Rows scanned", "Bytes touched");
+    printf("|---------------------------------------------------------------------------------------------|\n");
+    int listed = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        const OpMetrics *metrics = &merged[op];
+        if (metrics->count == 0) continue;
+        printf("| %-15s | %8llu | %10.1f | %10.1f | %10.1f | %12llu | %14llu |\n", opNames[op],
+               (unsigned long long)metrics->count, latencyPercentile(metrics, 500) / 1e3,
+               latencyPercentile(metrics, 990) / 1e3, metrics->maxNs / 1e3, (unsigned long long)metrics->rows,
+               (unsigned long long)metrics->bytes);
+        listed++;
+    }
+    if (!listed) {
+        printf("No operations timed yet.\n");
+    }
+    printf("===============================================================================================\n");
+    free(merged);
 }
 
-// Function to display items with low stock alert
-void stockAlert() {
-    printf("\nStock Alert: Low stock items (quantity < %d):\n", LOW_STOCK_THRESHOLD);
-    #pragma omp parallel for // Parallelize stock alert checking
-    for (int i = 0; i < itemCount; i++) {
-        if (items[i].quantity < LOW_STOCK_THRESHOLD) {
-            #pragma omp critical // Synchronize printing alert messages
-            {
-                printf("ID: %d | Name: %s | Category: %s | Quantity: %d | Price: %.2f\n",
-                       items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-            }
-        }
+// Function to create the --stats-file and write its header
+void openStatsFile() {
+    statsOutput = fopen(statsFile, "w");
+    if (!statsOutput) {
+        perror("Error opening stats file");
+        exit(EXIT_FAILURE);
+    }
+    fputs("elapsed_seconds,operation,count,mean_us,p50_us,p99_us,max_us,rows_scanned,bytes_touched\n", statsOutput);
+    lastStatsDump = omp_get_wtime();
+}
+
+// Function to append the metrics to the --stats-file, one line per operation, once statsInterval seconds have
+// passed since the last dump (or right away when force is set). Counters are cumulative since the start.
+void dumpStats(int force) {
+    double now = omp_get_wtime();
+    if (!statsOutput || (!force && now - lastStatsDump < statsInterval)) {
+        return;
+    }
+    lastStatsDump = now;
+
+    OpMetrics *merged = malloc(sizeof(OpMetrics) * OP_COUNT);
+    if (!merged) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    mergeMetrics(merged);
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%.3f,", now - statsStart);
+    TextBuffer text = {0};
+    formatStats(merged, prefix, &text);
+    if (text.length) {
+        fwrite(text.data, 1, text.length, statsOutput);
+    }
+    fflush(statsOutput);
+    free(text.data);
+    free(merged);
+}
+
+// Function to write a final dump and close the --stats-file
+void closeStatsFile() {
+    if (statsOutput) {
+        dumpStats(1);
+        fclose(statsOutput);
+        statsOutput = NULL;
     }
 }
 
@@ -306,87 +3634,759 @@ void displayMenu() {
     printf("4. Update Item\n");
     printf("5. Process Bulk Updates\n");
     printf("6. Search Items\n");
-    printf("7. Sort Items by Price\n");
+    printf("7. Sort Items\n");
     printf("8. Export Data\n");
     printf("9. Stock Alert\n");
     printf("10. Print All Items\n");
     printf("11. View Items by Category\n");
     printf("12. Calculate Total Value\n");
+    printf("13. Compact Storage\n");
+    printf("14. Export Snapshot\n");
+    printf("15. Filtered Bulk Update\n");
+    printf("16. Set Reorder Threshold\n");
+    printf("17. Show Operation Stats\n");
     printf("0. Exit\n");
 }
 
 // Function to print all items
 void printItems() {
     printf("\nAll Items in the Warehouse:\n");
-    #pragma omp parallel for // Parallelize item printing
-    for (int i = 0; i < itemCount; i++) {
-        #pragma omp critical // Synchronize printing item details
-        {
-            printf("ID: %d | Name: %s | Category: %s | Quantity: %d | Price: %.2f\n",
-                   items[i].id, items[i].name, items[i].category, items[i].quantity, items[i].price);
-        }
-    }
+    RowList rows = {0};
+    collectRows(QUERY_ALL, NULL, &rows);
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES);
+    printRows(&rows, ROW_FORMAT_FULL);
+    free(rows.rows);
 }
 
 // Function to view items by category
-void viewItemsByCategory() {
-    char category[50];
-    printf("\nEnter category to view items: ");
-    scanf("%49s", category);
+void viewItemsByCategory(const char *category) {
+    int code = findCategory(category);
+    if (code < 0 || categoryItemCount[code] == 0) {
+        printf("\nNo items found in category '%s'.\n", category);
+        return;
+    }
 
+    // Only the category's bitmap is walked, so rows of other categories are never touched
+    RowList rows = {0};
+    collectBitmapRows(categoryRows[code], (itemCount + 63) / 64, &rows);
+    noteWork(rows.count, (long long)rows.count * ITEM_BYTES);
+    long long total, categoryValues[MAX_CATEGORIES];
+    int lowStock;
+    readAggregates(&total, categoryValues, &lowStock);
     printf("\nItems in category '%s':\n", category);
-    #pragma omp parallel for // Parallelize category filtering
+    printRows(&rows, ROW_FORMAT_NO_CATEGORY);
+    printf("%d items, total value %.2f\n", rows.count, (double)categoryValues[code] / VALUE_SCALE);
+    free(rows.rows);
+}
+
+// Function to return a live row's value (quantity * price) in fixed-point aggregate units
+long long rowValueUnits(int row) {
+    double value = (double)ITEM_QUANTITY(row) * ITEM_PRICE(row) * VALUE_SCALE;
+    return (long long)(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+// Function to add (sign 1) or remove (sign -1) a live row's share of the running aggregates
+void aggregateRow(int row, int sign) {
+    AggregateSlot *slot = &aggregateSlots[omp_get_thread_num() % READER_SLOTS];
+    long long value = sign * rowValueUnits(row);
+    __atomic_fetch_add(&slot->value, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->categoryValue[ITEM_CATEGORY(row)], value, __ATOMIC_RELAXED);
+    if (isLowStock(row)) {
+        __atomic_fetch_add(&slot->lowStock, sign, __ATOMIC_RELAXED);
+    }
+}
+
+// Function to add or remove the share of every live row in [begin, end), summed locally and added to the slot once.
+// Bulk updates call it around each chunk, while the chunk is still in cache.
+void aggregateRows(int begin, int end, int sign) {
+    long long value = 0, categoryValue[MAX_CATEGORIES] = {0};
+    int lowStock = 0;
+    for (int i = begin; i < end; i++) {
+        if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+        long long rowValue = rowValueUnits(i);
+        value += rowValue;
+        categoryValue[ITEM_CATEGORY(i)] += rowValue;
+        lowStock += isLowStock(i);
+    }
+
+    AggregateSlot *slot = &aggregateSlots[omp_get_thread_num() % READER_SLOTS];
+    __atomic_fetch_add(&slot->value, sign * value, __ATOMIC_RELAXED);
+    for (int c = 0; c < categoryCount; c++) {
+        if (categoryValue[c]) {
+            __atomic_fetch_add(&slot->categoryValue[c], sign * categoryValue[c], __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_fetch_add(&slot->lowStock, sign * lowStock, __ATOMIC_RELAXED);
+}
+
+// Function to compute the aggregates with a full parallel rescan of the table
+void sumAggregates(long long *total, long long *categoryValues, int *lowStock) {
+    long long value = 0;
+    int low = 0;
+    memset(categoryValues, 0, sizeof(long long) * MAX_CATEGORIES);
+    noteWork(itemCount, (long long)itemCount * ITEM_BYTES);
+    #pragma omp parallel for reduction(+:value, low) reduction(+:categoryValues[:MAX_CATEGORIES])
     for (int i = 0; i < itemCount; i++) {
-        if (strcmp(items[i].category, category) == 0) {
-            #pragma omp critical // Synchronize printing category results
-            {
-                printf("ID: %d | Name: %s | Quantity: %d | Price: %.2f\n",
-                       items[i].id, items[i].name, items[i].quantity, items[i].price);
+        if (ITEM_ID(i) == TOMBSTONE_ID) continue;
+        long long rowValue = rowValueUnits(i);
+        value += rowValue;
+        categoryValues[ITEM_CATEGORY(i)] += rowValue;
+        low += isLowStock(i);
+    }
+    *total = value;
+    *lowStock = low;
+}
+
+// Function to read the running aggregates: the sum of every thread's slot
+void readAggregates(long long *total, long long *categoryValues, int *lowStock) {
+    *total = 0;
+    *lowStock = 0;
+    memset(categoryValues, 0, sizeof(long long) * MAX_CATEGORIES);
+    for (int s = 0; s < READER_SLOTS; s++) {
+        *total += __atomic_load_n(&aggregateSlots[s].value, __ATOMIC_RELAXED);
+        *lowStock += __atomic_load_n(&aggregateSlots[s].lowStock, __ATOMIC_RELAXED);
+        for (int c = 0; c < categoryCount; c++) {
+            categoryValues[c] += __atomic_load_n(&aggregateSlots[s].categoryValue[c], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Function to recompute the running aggregates and the low-stock set from the rows, after loading or restoring a table
+void rebuildAggregates() {
+    memset(aggregateSlots, 0, sizeof(aggregateSlots));
+    sumAggregates(&aggregateSlots[0].value, aggregateSlots[0].categoryValue, &aggregateSlots[0].lowStock);
+    rebuildLowStockRows();
+}
+
+// Function to cross-check the running aggregates against a full rescan, reporting and repairing any difference.
+// Returns 1 when they agreed.
+int checkAggregates() {
+    long long total, categoryValues[MAX_CATEGORIES], expectedTotal, expectedValues[MAX_CATEGORIES];
+    int lowStock, expectedLowStock;
+    readAggregates(&total, categoryValues, &lowStock);
+    sumAggregates(&expectedTotal, expectedValues, &expectedLowStock);
+
+    int agreed = total == expectedTotal && lowStock == expectedLowStock;
+    for (int c = 0; c < categoryCount; c++) {
+        if (categoryValues[c] != expectedValues[c]) {
+            printf("Aggregate mismatch: category '%s' value %.4f, rescan %.4f\n", categoryNames[c],
+                   (double)categoryValues[c] / VALUE_SCALE, (double)expectedValues[c] / VALUE_SCALE);
+            agreed = 0;
+        }
+    }
+    if (total != expectedTotal) {
+        printf("Aggregate mismatch: total value %.4f, rescan %.4f\n", (double)total / VALUE_SCALE, (double)expectedTotal / VALUE_SCALE);
+    }
+    if (lowStock != expectedLowStock) {
+        printf("Aggregate mismatch: low stock count %d, rescan %d\n", lowStock, expectedLowStock);
+    }
+    if (!agreed) {
+        rebuildAggregates();
+    }
+    return agreed;
+}
+
+// Function to tell whether a live row is below its category's reorder threshold
+int isLowStock(int row) {
+    return ITEM_QUANTITY(row) < categoryThreshold[ITEM_CATEGORY(row)];
+}
+
+// Function to queue an alert for a row that just crossed its threshold (low set) or came back above it
+void queueStockAlert(int row, int low) {
+    int slot = __atomic_fetch_add(&alertCount, 1, __ATOMIC_RELAXED);
+    if (slot >= ALERT_QUEUE_SIZE) {
+        return;
+    }
+    StockAlert *alert = &alertQueue[slot];
+    alert->id = ITEM_ID(row);
+    strcpy(alert->name, ITEM_NAME(row));
+    alert->quantity = ITEM_QUANTITY(row);
+    alert->threshold = categoryThreshold[ITEM_CATEGORY(row)];
+    alert->low = low;
+}
+
+// Function to bring a live row's low-stock bit in line with the row after a write, queueing an alert if it flips.
+// The caller holds the row's writer side, so the bit cannot flip between the test and the update.
+void trackStock(int row) {
+    uint64_t bit = (uint64_t)1 << (row & 63);
+    int low = isLowStock(row);
+    if (low != ((__atomic_load_n(&lowStockRows[row >> 6], __ATOMIC_RELAXED) & bit) != 0)) {
+        __atomic_fetch_xor(&lowStockRows[row >> 6], bit, __ATOMIC_RELAXED);
+        queueStockAlert(row, low);
+    }
+}
+
+// Function to track every live row in [begin, end); bulk updates call it after each chunk
+void trackStockRows(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        if (ITEM_ID(i) != TOMBSTONE_ID) {
+            trackStock(i);
+        }
+    }
+}
+
+// Function to clear a row's low-stock bit without an alert, when the row is deleted or moved. Returns the old bit.
+int untrackStock(int row) {
+    uint64_t bit = (uint64_t)1 << (row & 63);
+    return (__atomic_fetch_and(&lowStockRows[row >> 6], ~bit, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+// Function to recompute the low-stock set from the rows, without alerts. Each thread owns whole 64-row words.
+void rebuildLowStockRows() {
+    int words = (itemCount + 63) / 64;
+    // Clear the whole capacity so bits of rows past a shrunk itemCount go too
+    memset(lowStockRows, 0, sizeof(uint64_t) * ((itemCapacity + 63) / 64));
+    #pragma omp parallel for
+    for (int w = 0; w < words; w++) {
+        int end = (w + 1) * 64 < itemCount ? (w + 1) * 64 : itemCount;
+        uint64_t bits = 0;
+        for (int i = w * 64; i < end; i++) {
+            if (ITEM_ID(i) != TOMBSTONE_ID && isLowStock(i)) {
+                bits |= (uint64_t)1 << (i & 63);
             }
         }
+        lowStockRows[w] = bits;
+    }
+}
+
+// Function to change a category's reorder threshold. Only the category's own rows are visited, and those
+// that cross the new threshold either way are alerted like any other write. Every row of the category
+// changes state at once, so this runs in exclusive mode.
+void setCategoryThreshold(int code, int threshold) {
+    beginExclusive();
+    int words = (itemCount + 63) / 64;
+    noteWork(categoryItemCount[code], (long long)categoryItemCount[code] * ITEM_BYTES);
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = categoryRows[code][w]; bits; bits &= bits - 1) {
+            aggregateRow(w * 64 + __builtin_ctzll(bits), -1);
+        }
+    }
+    categoryThreshold[code] = threshold;
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = categoryRows[code][w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            aggregateRow(i, 1);
+            trackStock(i);
+        }
+    }
+    endExclusive();
+}
+
+// Function to show and empty the alert queue. Called between commands, once every writer has finished.
+void printStockAlerts(FILE *out) {
+    for (int a = 0; a < alertCount && a < ALERT_QUEUE_SIZE; a++) {
+        StockAlert *alert = &alertQueue[a];
+        if (alert->low) {
+            fprintf(out, "Stock alert: item %d (%s) is at %d, below its reorder threshold of %d.\n",
+                    alert->id, alert->name, alert->quantity, alert->threshold);
+        } else {
+            fprintf(out, "Restocked: item %d (%s) is at %d, back at or above its reorder threshold of %d.\n",
+                    alert->id, alert->name, alert->quantity, alert->threshold);
+        }
+    }
+    if (alertCount > ALERT_QUEUE_SIZE) {
+        fprintf(out, "...and %d more threshold crossings; see Stock Alert for the current list.\n", alertCount - ALERT_QUEUE_SIZE);
     }
+    discardStockAlerts();
+}
+
+// Function to empty the alert queue without showing it, e.g. after a WAL replay re-applied old writes
+void discardStockAlerts() {
+    alertCount = 0;
 }
 
-// Function to calculate and display the total value of all items
+// Function to display the dashboard: total value, item and low-stock counts, and value and count per category
 void calculateTotalValue() {
-    clock_t start_time, end_time;
-    double processing_time;
+    // Read from the running aggregates: no scan, however large the table
+    long long total, categoryValues[MAX_CATEGORIES];
+    int lowStock;
+    readAggregates(&total, categoryValues, &lowStock);
 
-    start_time = clock(); // Start timer
+    printf("\nTotal value of all items: %.2f\n", (double)total / VALUE_SCALE);
+    printf("Items: %d | Low stock (below reorder threshold): %d\n", idIndexCount, lowStock);
+    for (int c = 0; c < categoryCount; c++) {
+        if (categoryItemCount[c] > 0) {
+            printf("Category: %s | Items: %d | Value: %.2f | Threshold: %d\n", categoryNames[c], categoryItemCount[c],
+                   (double)categoryValues[c] / VALUE_SCALE, categoryThreshold[c]);
+        }
+    }
+
+    if (verifyAggregates) {
+        double start = omp_get_wtime();
+        int agreed = checkAggregates();
+        printf("%s (parallel rescan took %.3f seconds)\n", agreed ? "Aggregates match a full rescan" : "Aggregates rebuilt from a full rescan",
+               omp_get_wtime() - start);
+    }
+}
 
-    float totalValue = 0.0;
 
-    // Parallelize the loop to calculate the total value without the sleep delay
-    #pragma omp parallel for reduction(+:totalValue)
-    for (int i = 0; i < itemCount; i++) {
-        totalValue += items[i].quantity * items[i].price;
+// Function to make room for extra more bytes (plus a terminator) at the end of a buffer
+void textReserve(TextBuffer *buffer, size_t extra) {
+    if (buffer->length + extra < buffer->capacity) {
+        return;
+    }
+
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity <= buffer->length + extra) {
+        capacity *= 2;
+    }
+    buffer->data = realloc(buffer->data, capacity);
+    if (!buffer->data) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    buffer->capacity = capacity;
+}
+
+// Function to append printf-style text to a buffer, growing it as needed
+void textAppend(TextBuffer *buffer, const char *format, ...) {
+    for (;;) {
+        size_t room = buffer->capacity - buffer->length;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer->data ? buffer->data + buffer->length : NULL, room, format, args);
+        va_end(args);
+        if (n < 0) {
+            return;
+        }
+        if ((size_t)n < room) {
+            buffer->length += (size_t)n;
+            return;
+        }
+        textReserve(buffer, (size_t)n);
     }
+}
 
+// Function to append raw bytes to a buffer
+void textAppendBytes(TextBuffer *buffer, const void *data, size_t size) {
+    textReserve(buffer, size);
+    if (size) {
+        memcpy(buffer->data + buffer->length, data, size);
+    }
+    buffer->length += size;
+    buffer->data[buffer->length] = '\0';
+}
 
+// Function to append one row to a buffer in the same CSV layout as the data files
+void appendItemText(TextBuffer *buffer, int row) {
+    RowCopy copy;
+    copyRow(row, &copy);
+    textAppend(buffer, "%d,%s,%s,%d,%.2f\n", copy.id, copy.name, categoryNames[copy.category],
+               copy.quantity, copy.price);
+}
 
-    end_time = clock(); // End timer
-    processing_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC;
+// Function to copy a text field up to the next comma into out (clipped to size - 1 characters). Returns where the field ended.
+const char *copyBatchField(const char *p, const char *end, char *out, size_t size) {
+    const char *start = p;
+    while (p < end && *p != ',') p++;
+    size_t length = (size_t)(p - start) < size - 1 ? (size_t)(p - start) : size - 1;
+    memcpy(out, start, length);
+    out[length] = '\0';
+    return p;
+}
 
+// Function to parse one line of a batch stream. Returns 0 for blank and '#' comment lines, which produce no result.
+// Lines that cannot be parsed become BATCH_INVALID commands so they are still reported.
+int parseBatchCommand(const char *line, int lineNumber, BatchCommand *command) {
+    const char *end = line + strcspn(line, "\r\n");
+    if (line == end || *line == '#') {
+        return 0;
+    }
 
-    printf("\nTotal value of all items: %.2f\n", totalValue);
+    memset(command, 0, sizeof(*command));
+    command->line = lineNumber;
+    command->op = BATCH_INVALID;
+    const char *p = memchr(line, ',', end - line);
+    size_t opLength = (p ? p : end) - line;
+    p = p ? p + 1 : end;
 
-    printf("Processing time: %.2f seconds\n", processing_time);
+    if (opLength == 3 && strncmp(line, "add", 3) == 0) {
+        const char *name, *category;
+        int nameLength, categoryLength;
+        if (parseRow(p, end, &command->id, &name, &nameLength, &category, &categoryLength, &command->quantity, &command->price)) {
+            memcpy(command->name, name, nameLength);
+            memcpy(command->category, category, categoryLength);
+            command->op = BATCH_ADD;
+        }
+    } else if ((opLength == 3 && strncmp(line, "get", 3) == 0) || (opLength == 6 && strncmp(line, "delete", 6) == 0)) {
+        if (parseIntField(&p, end, &command->id) && p == end) {
+            command->op = line[0] == 'g' ? BATCH_GET : BATCH_DELETE;
+        }
+    } else if (opLength == 6 && strncmp(line, "search", 6) == 0) {
+        if (p < end) {
+            copyBatchField(p, end, command->name, sizeof(command->name));
+            command->op = BATCH_SEARCH;
+        }
+    } else if (opLength == 6 && strncmp(line, "update", 6) == 0) {
+        // update,ID,NAME,CATEGORY,QUANTITY,PRICE where an empty field keeps the current value
+        command->quantity = -1;
+        command->price = -1;
+        if (!parseIntField(&p, end, &command->id) || p == end || *p++ != ',') {
+            return 1;
+        }
+        p = copyBatchField(p, end, command->name, sizeof(command->name));
+        if (p == end || *p++ != ',') {
+            return 1;
+        }
+        p = copyBatchField(p, end, command->category, sizeof(command->category));
+        if (p == end || *p++ != ',') {
+            return 1;
+        }
+        if (p < end && *p != ',' && !parseIntField(&p, end, &command->quantity)) {
+            return 1;
+        }
+        if (p == end || *p++ != ',') {
+            return 1;
+        }
+        if (p < end && !parsePriceField(&p, end, &command->price)) {
+            return 1;
+        }
+        command->op = BATCH_UPDATE;
+    } else if (opLength == 5 && strncmp(line, "total", 5) == 0) {
+        command->op = p == end ? BATCH_TOTAL : BATCH_INVALID;
+    } else if (opLength == 4 && strncmp(line, "sort", 4) == 0) {
+        // sort,price|quantity|id|name[,desc]
+        static const char *columns[] = {"price", "quantity", "id", "name"};
+        char column[50];
+        p = copyBatchField(p, end, column, sizeof(column));
+        command->descending = end - p == 5 && strncmp(p, ",desc", 5) == 0;
+        if (p < end && !command->descending) {
+            return 1;
+        }
+        for (int c = 0; c < 4; c++) {
+            if (strcmp(column, columns[c]) == 0) {
+                command->mode = c;
+                command->op = BATCH_SORT;
+            }
+        }
+    } else if (opLength == 4 && strncmp(line, "bulk", 4) == 0) {
+        if (parseBatchBulk(p, end, &command->filter, &command->action)) {
+            command->op = BATCH_BULK;
+        }
+    } else if (opLength == 6 && strncmp(line, "export", 6) == 0) {
+        // export,FILENAME,csv|binary
+        p = copyBatchField(p, end, command->name, sizeof(command->name));
+        if (command->name[0] && end - p == 4 && strncmp(p, ",csv", 4) == 0) {
+            command->mode = EXPORT_CSV;
+            command->op = BATCH_EXPORT;
+        } else if (command->name[0] && end - p == 7 && strncmp(p, ",binary", 7) == 0) {
+            command->mode = EXPORT_BINARY;
+            command->op = BATCH_EXPORT;
+        }
+    } else if (opLength == 4 && strncmp(line, "time", 4) == 0) {
+        // time,LABEL reports the wall time since the previous time command (or since the program started)
+        copyBatchField(p, end, command->name, sizeof(command->name));
+        command->op = BATCH_TIME;
+    } else if (opLength == 5 && strncmp(line, "stats", 5) == 0) {
+        command->op = p == end ? BATCH_STATS : BATCH_INVALID;
+    }
+    return 1;
 }
 
+// Function to parse the fields of a bulk command:
+// bulk,CATEGORY,MIN_ID,MAX_ID,MIN_QUANTITY,MAX_QUANTITY,MIN_PRICE,MAX_PRICE,QUANTITY_MODE,QUANTITY,PRICE_MODE,PRICE
+// Bounds and modes read as in the filtered update menu: an empty category or a -1 bound matches anything.
+// Returns 0 if the fields are malformed.
+int parseBatchBulk(const char *p, const char *end, BulkFilter *filter, BulkAction *action) {
+    int bounds[4];
+    float priceBounds[2];
+    initBulkFilter(filter);
+    p = copyBatchField(p, end, filter->category, sizeof(filter->category));
+    for (int k = 0; k < 4; k++) {
+        if (p == end || *p++ != ',' || !parseIntField(&p, end, &bounds[k])) return 0;
+    }
+    for (int k = 0; k < 2; k++) {
+        if (p == end || *p++ != ',' || !parsePriceField(&p, end, &priceBounds[k])) return 0;
+    }
+    if (p == end || *p++ != ',' || !parseIntField(&p, end, &action->quantityMode)
+        || p == end || *p++ != ',' || !parseIntField(&p, end, &action->quantity)
+        || p == end || *p++ != ',' || !parseIntField(&p, end, &action->priceMode)
+        || p == end || *p++ != ',' || !parsePriceField(&p, end, &action->price) || p != end) {
+        return 0;
+    }
 
-// Function to parallelize the main loop for menu interaction
-int main() {
+    if (bounds[0] >= 0) filter->minId = bounds[0];
+    if (bounds[1] >= 0) filter->maxId = bounds[1];
+    if (bounds[2] >= 0) filter->minQuantity = bounds[2];
+    if (bounds[3] >= 0) filter->maxQuantity = bounds[3];
+    if (priceBounds[0] >= 0) filter->minPrice = priceBounds[0];
+    if (priceBounds[1] >= 0) filter->maxPrice = priceBounds[1];
+    return action->quantityMode >= BULK_KEEP && action->quantityMode <= BULK_SET
+        && action->priceMode >= BULK_KEEP && action->priceMode <= BULK_SCALE;
+}
 
- items = malloc(sizeof(Item) * itemCapacity);
-    if (!items) {
-        perror("Memory allocation failed");
+// Function to run one batch command, leaving its outcome in command->result and any rows in command->output
+void runBatchCommand(BatchCommand *command) {
+    static const int batchOps[] = {OP_NONE, OP_ADD, OP_DELETE, OP_UPDATE, OP_RETRIEVE, OP_SEARCH, OP_TOTAL, OP_SORT,
+                                   OP_FILTERED_UPDATE, OP_EXPORT, OP_NONE, OP_NONE};
+    OpTimer timer = startOp(batchOps[command->op]);
+    switch (command->op) {
+        case BATCH_ADD:
+            command->result = applyAddItem(command->id, command->name, command->category, command->quantity, command->price);
+            break;
+        case BATCH_DELETE:
+            command->result = applyDeleteItem(command->id);
+            break;
+        case BATCH_UPDATE:
+            command->result = applyUpdateItem(command->id, command->name[0] ? command->name : NULL,
+                                              command->category[0] ? command->category : NULL, command->quantity, command->price);
+            break;
+        case BATCH_GET: {
+            beginShared();
+            int i = findItemRow(command->id);
+            command->result = i == INDEX_EMPTY ? RESULT_NOT_FOUND : RESULT_OK;
+            if (i != INDEX_EMPTY) {
+                appendItemText(&command->output, i);
+                command->matches = 1;
+            }
+            endShared();
+            break;
+        }
+        case BATCH_SEARCH:
+            command->result = RESULT_OK;
+            beginShared();
+            RowList rows = {0};
+            findNameRows(command->name, &rows);
+            for (int r = 0; r < rows.count; r++) {
+                // The row was matched without its seqlock; print a consistent copy
+                RowCopy copy;
+                copyRow(rows.rows[r], &copy);
+                textAppend(&command->output, "%d,%s,%s,%d,%.2f\n", copy.id, copy.name, categoryNames[copy.category],
+                           copy.quantity, copy.price);
+                command->matches++;
+            }
+            free(rows.rows);
+            endShared();
+            break;
+        case BATCH_TOTAL: {
+            long long total, categoryValues[MAX_CATEGORIES];
+            int lowStock;
+            readAggregates(&total, categoryValues, &lowStock);
+            textAppend(&command->output, "%.2f %d\n", (double)total / VALUE_SCALE, idIndexCount);
+            command->result = RESULT_OK;
+            break;
+        }
+        case BATCH_SORT:
+            sortItems(command->mode, command->descending);
+            command->result = RESULT_OK;
+            break;
+        case BATCH_BULK: {
+            int plan;
+            int matched = applyFilteredUpdate(&command->filter, &command->action, &plan);
+            walLogFiltered(&command->filter, &command->action);
+            textAppend(&command->output, "%d\n", matched);
+            command->result = RESULT_OK;
+            break;
+        }
+        case BATCH_EXPORT: {
+            BulkFilter everything;
+            initBulkFilter(&everything);
+            long long rows = exportData(command->name, command->mode, &everything);
+            command->result = rows < 0 ? RESULT_WRITE_FAILED : RESULT_OK;
+            if (rows >= 0) {
+                textAppend(&command->output, "%lld\n", rows);
+            }
+            break;
+        }
+        case BATCH_TIME: {
+            double now = omp_get_wtime();
+            textAppend(&command->output, "%s %.6f\n", command->name, now - batchMark);
+            batchMark = now;
+            command->result = RESULT_OK;
+            break;
+        }
+        case BATCH_STATS: {
+            OpMetrics *merged = malloc(sizeof(OpMetrics) * OP_COUNT);
+            if (!merged) {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+            mergeMetrics(merged);
+            command->matches = formatStats(merged, "", &command->output);
+            command->result = RESULT_OK;
+            free(merged);
+            break;
+        }
+        default:
+            command->result = RESULT_INVALID_COMMAND;
+    }
+    finishOp(&timer);
+}
+
+// Function to print a command's outcome: "<line> OK" or "<line> ERROR <reason>". A get adds the row to the
+// OK line; a search adds its match count and is followed by one line per match. A total adds the value and item
+// count, a bulk update its match count, an export its row count and a time command its label and seconds.
+// A stats command adds the number of operations timed so far, followed by one formatStats() line for each.
+void printBatchResult(const BatchCommand *command) {
+    static const char *reasons[] = {"", "not found", "already exists", "reserved id", "too many categories", "invalid command",
+                                    "write failed"};
+    if (command->result != RESULT_OK) {
+        printf("%d ERROR %s\n", command->line, reasons[command->result]);
+    } else if (command->op == BATCH_SEARCH || command->op == BATCH_STATS) {
+        printf("%d OK %d\n", command->line, command->matches);
+        if (command->output.length) {
+            fwrite(command->output.data, 1, command->output.length, stdout);
+        }
+    } else if (command->output.length) {
+        printf("%d OK %.*s", command->line, (int)command->output.length, command->output.data);
+    } else {
+        printf("%d OK\n", command->line);
+    }
+}
+
+// Function to execute a group of batch commands. Searches run together, point commands are spread over the
+// threads by lock stripe, and a whole-table command runs alone, with the threads working inside it.
+void runBatchGroup(BatchCommand *commands, int count) {
+    int start = 0;
+    while (start < count) {
+        int end = start;
+        if (commands[start].op >= BATCH_TOTAL) {
+            runBatchCommand(&commands[start]);
+            end = start + 1;
+        } else if (commands[start].op == BATCH_SEARCH) {
+            // A run of searches: every one is a read-only scan
+            while (end < count && commands[end].op == BATCH_SEARCH) end++;
+            #pragma omp parallel for schedule(dynamic)
+            for (int c = start; c < end; c++) {
+                runBatchCommand(&commands[c]);
+            }
+        } else {
+            // Point commands up to the next search: each thread owns the ids of some lock stripes and runs
+            // their commands in input order, so commands on one id keep their order while the rest overlap
+            while (end < count && commands[end].op != BATCH_SEARCH && commands[end].op < BATCH_TOTAL) end++;
+            #pragma omp parallel
+            {
+                int threads = omp_get_num_threads();
+                int thread = omp_get_thread_num();
+                for (int c = start; c < end; c++) {
+                    if (idStripe(commands[c].id) % threads == thread) {
+                        runBatchCommand(&commands[c]);
+                    }
+                }
+            }
+        }
+        start = end;
+    }
+}
+
+// Function to run a command stream from a file ("-" for stdin) instead of the menu, printing one result per command.
+// Commands are handled in groups of BATCH_GROUP_LINES and the WAL is committed once per group.
+void runBatch(const char *filename) {
+    FILE *input = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    BatchCommand *commands = malloc(sizeof(BatchCommand) * BATCH_GROUP_LINES);
+    if (!input || !commands) {
+        perror("Error opening batch file");
         exit(EXIT_FAILURE);
     }
 
-    printf("Loading data from warehouse data files...\n");
-    loadDataFromFiles(); // Use the new loadDataFromFiles function
-    printf("Data loaded successfully.\n");
+    char line[MAX_LINE_LENGTH];
+    int lineNumber = 0, total = 0, failed = 0, more = 1;
+    double start = omp_get_wtime();
+    while (more) {
+        int count = 0;
+        while (count < BATCH_GROUP_LINES && (more = fgets(line, sizeof(line), input) != NULL)) {
+            if (parseBatchCommand(line, ++lineNumber, &commands[count])) {
+                count++;
+            }
+        }
+
+        runBatchGroup(commands, count);
+        walCommit();
+        dumpStats(0);
+        printStockAlerts(stderr); // Keeps stdout to one result line per command
+        for (int c = 0; c < count; c++) {
+            printBatchResult(&commands[c]);
+            failed += commands[c].result != RESULT_OK;
+            free(commands[c].output.data);
+        }
+        total += count;
+    }
+
+    fprintf(stderr, "Batch finished: %d commands (%d failed) in %.3f seconds.\n", total, failed, omp_get_wtime() - start);
+    if (input != stdin) fclose(input);
+    free(commands);
+}
+
+// Function to parse command-line options
+void parseOptions(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--delete-mode=swap") == 0) {
+            deleteMode = DELETE_MODE_SWAP;
+        } else if (strcmp(argv[i], "--delete-mode=tombstone") == 0) {
+            deleteMode = DELETE_MODE_TOMBSTONE;
+        } else if (strncmp(argv[i], "--snapshot=", 11) == 0 && argv[i][11] != '\0') {
+            snapshotFile = argv[i] + 11;
+        } else if (strncmp(argv[i], "--wal=", 6) == 0 && argv[i][6] != '\0') {
+            walFile = argv[i] + 6;
+        } else if (strncmp(argv[i], "--wal-sync=", 11) == 0 && argv[i][11] >= '0' && argv[i][11] <= '9') {
+            walSyncEvery = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--files=", 8) == 0 && argv[i][8] >= '1' && argv[i][8] <= '9') {
+            dataFileCount = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--batch=", 8) == 0 && argv[i][8] != '\0') {
+            batchFile = argv[i] + 8;
+        } else if (strncmp(argv[i], "--reorder-threshold=", 20) == 0 && argv[i][20] != '\0') {
+            defaultThreshold = atoi(argv[i] + 20);
+        } else if (strcmp(argv[i], "--verify-aggregates") == 0) {
+            verifyAggregates = 1;
+        } else if (strncmp(argv[i], "--stats-file=", 13) == 0 && argv[i][13] != '\0') {
+            statsFile = argv[i] + 13;
+        } else if (strncmp(argv[i], "--stats-interval=", 17) == 0 && argv[i][17] >= '0' && argv[i][17] <= '9') {
+            statsInterval = atoi(argv[i] + 17);
+        } else if (strcmp(argv[i], "--scan-kernel=scalar") == 0) {
+            scanKernel = SCAN_SCALAR;
+        } else if (strcmp(argv[i], "--scan-kernel=sse2") == 0) {
+            scanKernel = SCAN_SSE2;
+        } else if (strcmp(argv[i], "--scan-kernel=avx2") == 0) {
+            scanKernel = SCAN_AVX2;
+        } else if (strncmp(argv[i], "--page-rows=", 12) == 0 && argv[i][12] >= '0' && argv[i][12] <= '9') {
+            pageRows = atoi(argv[i] + 12);
+        } else if (strncmp(argv[i], "--limit=", 8) == 0 && argv[i][8] >= '0' && argv[i][8] <= '9') {
+            resultLimit = atoi(argv[i] + 8);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--delete-mode=tombstone|swap] [--snapshot=FILE] [--wal=FILE] [--wal-sync=N] [--batch=FILE|-] [--files=N] [--scan-kernel=scalar|sse2|avx2] [--reorder-threshold=N] [--verify-aggregates] [--stats-file=FILE] [--stats-interval=SECONDS] [--page-rows=N] [--limit=N]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Function to parallelize the main loop for menu interaction
+int main(int argc, char *argv[]) {
+    batchMark = omp_get_wtime();
+    statsStart = batchMark;
+    parseOptions(argc, argv);
+    initTableLocks();
+    initMetrics();
+    if (statsFile) {
+        openStatsFile();
+    }
+
+    reserveRows(itemCapacity);
+
+    MappedFile snapshot;
+    double loadStart = omp_get_wtime();
+    if (snapshotFile && openSnapshot(snapshotFile, &snapshot)) {
+        restoreSnapshot(&snapshot);
+        printf("Loaded %d items from snapshot %s in %.3f seconds.\n", itemCount, snapshotFile, omp_get_wtime() - loadStart);
+    } else {
+        printf("Loading data from warehouse data files...\n");
+        loadDataFromFiles(); // Use the new loadDataFromFiles function
+        printf("Data loaded successfully.\n");
+    }
+    if (walFile) {
+        walOpen(walFile);
+        discardStockAlerts(); // Replayed writes were alerted before the restart
+    }
 
+    if (batchFile) {
+        runBatch(batchFile);
+        walClose();
+        closeStatsFile();
+        freeRows();
+        free(idIndex);
+        freeNameIndex();
+        return 0;
+    }
 
     int choice;
     do {
@@ -394,21 +4394,23 @@ int main() {
         printf("\nEnter your choice: ");
         scanf("%d", &choice);
 
+        OpTimer timer = {OP_NONE, 0, 0, 0, 0}; // Each case starts it once its input is read
         switch (choice) {
             case 1: {
                 int id, quantity;
                 float price;
-                char name[50], category[50];
+                char name[NAME_MAX_LENGTH + 1], category[50];
                 printf("Enter ID: ");
                 scanf("%d", &id);
                 printf("Enter Name: ");
-                scanf("%49s", name);
+                scanf("%255s", name);
                 printf("Enter Category: ");
                 scanf("%49s", category);
                 printf("Enter Quantity: ");
                 scanf("%d", &quantity);
                 printf("Enter Price: ");
                 scanf("%f", &price);
+                timer = startOp(OP_ADD);
                 addItem(id, name, category, quantity, price);
                 break;
             }
@@ -416,6 +4418,7 @@ int main() {
                 int id;
                 printf("Enter ID of item to delete: ");
                 scanf("%d", &id);
+                timer = startOp(OP_DELETE);
                 deleteItem(id);
                 break;
             }
@@ -423,76 +4426,170 @@ int main() {
                 int id;
                 printf("Enter ID of item to retrieve: ");
                 scanf("%d", &id);
+                timer = startOp(OP_RETRIEVE);
                 retrieveItem(id);
                 break;
             }
             case 4: {
                 int id, quantity;
                 float price;
-                char name[50], category[50];
+                char name[NAME_MAX_LENGTH + 1], category[50];
                 printf("Enter ID of item to update: ");
                 scanf("%d", &id);
                 printf("Enter new Name: ");
-                scanf("%49s", name);
+                scanf("%255s", name);
                 printf("Enter new Category: ");
                 scanf("%49s", category);
                 printf("Enter new Quantity: ");
                 scanf("%d", &quantity);
                 printf("Enter new Price: ");
                 scanf("%f", &price);
+                timer = startOp(OP_UPDATE);
                 updateItem(id, name, category, quantity, price);
                 break;
             }
             case 5: {
                 int increment;
+                float priceChange;
                 printf("Enter increment value for bulk update: ");
                 scanf("%d", &increment);
-                processBulkUpdates(increment);
+                printf("Enter price change for bulk update (0 to keep prices): ");
+                scanf("%f", &priceChange);
+                timer = startOp(OP_BULK_UPDATE);
+                processBulkUpdates(increment, priceChange);
                 break;
             }
             case 6: {
-                char keyword[50];
-                printf("Enter keyword to search: ");
-                scanf("%49s", keyword);
+                char keyword[NAME_MAX_LENGTH + 1];
+                printf("Enter keyword to search (end it with * to match name prefixes): ");
+                scanf("%255s", keyword);
+                timer = startOp(OP_SEARCH);
                 searchItems(keyword);
                 break;
             }
             case 7: {
-                sortItemsByPrice();
+                int column, order;
+                printf("Sort by (1 = Price, 2 = Quantity, 3 = ID, 4 = Name): ");
+                scanf("%d", &column);
+                printf("Order (1 = Ascending, 2 = Descending): ");
+                scanf("%d", &order);
+                if (column < 1 || column > 4) {
+                    printf("Invalid sort column.\n");
+                    break;
+                }
+                static const char *columnNames[] = {"price", "quantity", "ID", "name"};
+                timer = startOp(OP_SORT);
+                double start = omp_get_wtime();
+                sortItems(column - 1, order == 2);
+                printf("\nItems sorted by %s (%s) in %.3f seconds.\n", columnNames[column - 1],
+                       order == 2 ? "descending" : "ascending", omp_get_wtime() - start);
                 break;
             }
             case 8: {
-                char filename[50];
-                printf("Enter filename to export data: ");
+                char filename[50], answer;
+                int format;
+                BulkFilter filter;
+                printf("Enter filename to export data (end it with .gz to compress): ");
                 scanf("%49s", filename);
-                exportData(filename);
+                printf("Format (1 = CSV, 2 = Binary columns): ");
+                scanf("%d", &format);
+                printf("Export only items matching a filter? (y/n): ");
+                scanf(" %c", &answer);
+                initBulkFilter(&filter);
+                if (answer == 'y' || answer == 'Y') {
+                    promptBulkFilter(&filter);
+                }
+                timer = startOp(OP_EXPORT);
+                double start = omp_get_wtime();
+                long long rows = exportData(filename, format == 2 ? EXPORT_BINARY : EXPORT_CSV, &filter);
+                if (rows >= 0) {
+                    printf("\nData exported successfully to %s: %lld items in %.3f seconds.\n", filename, rows, omp_get_wtime() - start);
+                }
                 break;
             }
             case 9: {
+                timer = startOp(OP_STOCK_ALERT);
                 stockAlert();
                 break;
             }
             case 10: {
+                timer = startOp(OP_PRINT);
                 printItems();
                 break;
             }
             case 11: {
-                viewItemsByCategory();
+                char category[50];
+                printf("\nEnter category to view items: ");
+                scanf("%49s", category);
+                timer = startOp(OP_CATEGORY_VIEW);
+                viewItemsByCategory(category);
                 break;
             }
             case 12: {
+                timer = startOp(OP_TOTAL);
                 calculateTotalValue();
                 break;
             }
+            case 13: {
+                timer = startOp(OP_COMPACT);
+                int reclaimed = tombstoneCount;
+                compactItems();
+                printf("\nCompaction done: reclaimed %d deleted slots.\n", reclaimed);
+                break;
+            }
+            case 14: {
+                char filename[50];
+                printf("Enter filename for the snapshot: ");
+                scanf("%49s", filename);
+                timer = startOp(OP_SNAPSHOT);
+                saveSnapshot(filename);
+                break;
+            }
+            case 15: {
+                BulkFilter filter;
+                BulkAction action;
+                promptFilteredUpdate(&filter, &action);
+                timer = startOp(OP_FILTERED_UPDATE);
+                processFilteredUpdate(&filter, &action);
+                break;
+            }
+            case 16: {
+                char category[50];
+                int threshold;
+                printf("Enter category: ");
+                scanf("%49s", category);
+                printf("Enter reorder threshold (items below it are low on stock): ");
+                scanf("%d", &threshold);
+                int code = findCategory(category);
+                if (code < 0) {
+                    printf("\nError: Category '%s' not found.\n", category);
+                    break;
+                }
+                timer = startOp(OP_SET_THRESHOLD);
+                setCategoryThreshold(code, threshold);
+                printf("\nReorder threshold of '%s' set to %d.\n", category, threshold);
+                break;
+            }
+            case 17:
+                showStats();
+                break;
             case 0:
                 printf("Exiting program.\n");
                 break;
             default:
                 printf("Invalid choice, please try again.\n");
         }
+        finishOp(&timer);
+        printStockAlerts(stdout);
+        walCommit(); // One write per command covers every record it produced
+        dumpStats(0);
     } while (choice != 0);
+    walClose();
+    closeStatsFile();
 
 
-    free(items);    
+    freeRows();
+    free(idIndex);
+    freeNameIndex();
     return 0;
 }
@@ -2,69 +2,521 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
 
-#define MAX_ITEMS 10000000 
-#define NUM_FILES 20 
+#define MAX_ITEMS 10000000 // Default row count
+#define NUM_FILES 20 // Default file count; the warehouse programs load this many too unless given the same --files=N
+#define MAX_CATEGORIES 256 // Category codes must fit in an unsigned char
+#define BASE_CATEGORIES 6
+#define MAX_NAME_LENGTH 255 // Longest name the loaders keep
+#define WRITE_BUFFER_BYTES (1 << 20) // Formatted rows collected per write() call
+#define ROW_BYTES 384 // Room for one formatted CSV row
+#define MIN_INDEX_CAPACITY 1024 // Index sizing must match buildIndex() in the warehouse programs
+#define INDEX_EMPTY -1
+#define SNAPSHOT_MAGIC "WHSNAP\0" // Snapshot layout shared with single_thread.c and openmp_exec.c
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_CHECKSUM_SEED 0x5748534E41503031ULL
 
-float randomFloat(float min, float max) {
-    return min + ((float)rand() / RAND_MAX) * (max - min);
+// Per-file random number generator (xoshiro256**), seeded from the run seed and the file number so every file
+// comes out the same whatever the thread count
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+// One slot of the ID index stored in a snapshot
+typedef struct {
+    int id;
+    int row;
+} IndexSlot;
+
+// Fixed header at the start of a snapshot file, as written by saveSnapshot()
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t itemCount;
+    uint32_t categoryCount;
+    uint32_t indexCapacity;
+    uint32_t shard;
+    uint32_t shardCount;
+    uint64_t walSequence;
+    uint64_t nameBytes;
+    uint64_t checksum;
+} SnapshotHeader;
+
+long long totalRows = MAX_ITEMS;
+int fileCount = NUM_FILES;
+uint64_t seed;
+double zipfExponent = 0; // 0 keeps the categories uniform
+int categoryTotal = BASE_CATEGORIES;
+int nameLength = 0; // 0 keeps the plain "Item_<id>" names
+double duplicatePercent = 0;
+const char *snapshotFile = NULL;
+int writeCsv = 1;
+
+char categoryNames[MAX_CATEGORIES][50];
+double categoryCdf[MAX_CATEGORIES]; // Cumulative Zipf weights, normalised to end at 1
+uint32_t duplicateThreshold; // A row reuses an earlier ID when 32 random bits fall below this
+
+// Rows kept in memory only when a snapshot is written
+int *rowIds = NULL;
+int *rowQuantities = NULL;
+float *rowPrices = NULL;
+unsigned char *rowCategories = NULL;
+char *rowNames = NULL; // rowNameWidth bytes per row, each holding a NUL-terminated name
+size_t rowNameWidth = 0;
+
+// Function to step a splitmix64 state; used only to expand a seed into generator state
+uint64_t splitMix(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
 }
 
-const char* randomCategory() {
-    const char* categories[] = {"Electronics", "Clothing", "Home Goods", "Books", "Toys", "Food"};
-    int index = rand() % 6;
-    return categories[index];
+// Function to seed the generator for one file
+void seedRng(Rng *rng, int file) {
+    uint64_t state = seed ^ ((uint64_t)(file + 1) * 0xD1B54A32D192ED03ULL);
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitMix(&state);
+    }
 }
 
-void generateRandomData(const char *filename, long long startID, long long numItems) {
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        perror("Error opening file for writing");
-        exit(EXIT_FAILURE);
+// Function to rotate x left by k bits
+uint64_t rotateLeft(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to draw 64 random bits
+uint64_t nextRandom(Rng *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft(s[3], 45);
+    return result;
+}
+
+// Function to draw a number in [0, bound) without a division (multiply-shift on the top 32 bits)
+uint32_t randomBelow(Rng *rng, uint32_t bound) {
+    return (uint32_t)(((nextRandom(rng) >> 32) * bound) >> 32);
+}
+
+// Function to draw a category code, following the Zipf weights in categoryCdf
+int randomCategory(Rng *rng) {
+    double u = (nextRandom(rng) >> 11) * 0x1.0p-53;
+    int low = 0, high = categoryTotal - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (categoryCdf[mid] > u) high = mid;
+        else low = mid + 1;
+    }
+    return low;
+}
+
+// Function to set up the category names and the cumulative Zipf weights (exponent 0 is uniform)
+void prepareCategories() {
+    const char *baseNames[BASE_CATEGORIES] = {"Electronics", "Clothing", "Home Goods", "Books", "Toys", "Food"};
+    double total = 0;
+    for (int c = 0; c < categoryTotal; c++) {
+        if (c < BASE_CATEGORIES) {
+            strcpy(categoryNames[c], baseNames[c]);
+        } else {
+            snprintf(categoryNames[c], sizeof(categoryNames[c]), "Category_%d", c + 1);
+        }
+        total += 1.0 / pow(c + 1, zipfExponent);
+        categoryCdf[c] = total;
+    }
+    for (int c = 0; c < categoryTotal; c++) {
+        categoryCdf[c] /= total;
+    }
+    categoryCdf[categoryTotal - 1] = 1.0;
+}
+
+// Function to write value in decimal at out. Returns the characters written.
+int formatInt(char *out, long long value) {
+    char digits[20];
+    int count = 0, length = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (count) out[length++] = digits[--count];
+    return length;
+}
+
+// Function to write a whole buffer to fd, retrying short writes
+void writeAll(int fd, const char *data, size_t size, const char *filename) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            fprintf(stderr, "Error writing %s: ", filename);
+            perror(NULL);
+            exit(EXIT_FAILURE);
+        }
+        data += written;
+        size -= (size_t)written;
     }
+}
+
+// Function to generate one file's rows. Rows are formatted into a large buffer that is written with one write()
+// per megabyte; when a snapshot is requested they are also stored at row firstRow onwards of the row columns.
+void generateRandomData(const char *filename, int file, long long firstRow, long long numItems) {
+    Rng rng;
+    seedRng(&rng, file);
 
-    fprintf(file, "ID,Name,Category,Quantity,Price\n");
+    int fd = -1;
+    char *buffer = NULL;
+    if (writeCsv) {
+        fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        buffer = malloc(WRITE_BUFFER_BYTES);
+        if (fd < 0 || !buffer) {
+            perror("Error opening file for writing");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    static const char header[] = "ID,Name,Category,Quantity,Price\n";
+    size_t used = 0;
+    if (writeCsv) {
+        memcpy(buffer, header, sizeof(header) - 1);
+        used = sizeof(header) - 1;
+    }
 
     for (long long i = 0; i < numItems; i++) {
-        long long id = startID + i; 
-        char name[20];
-        snprintf(name, sizeof(name), "Item_%lld", id); 
-        int quantity = rand() % 1000 + 1; 
-        float price = randomFloat(1.0, 100.0); 
-        const char* category = randomCategory(); 
+        long long id = firstRow + i + 1;
+        if (duplicateThreshold && id > 1 && (uint32_t)nextRandom(&rng) < duplicateThreshold) {
+            id = 1 + randomBelow(&rng, (uint32_t)(id - 1)); // Reuse an ID from an earlier row
+        }
+        char name[MAX_NAME_LENGTH + 1];
+        memcpy(name, "Item_", 5);
+        int length = 5 + formatInt(name + 5, id);
+        if (length < nameLength) {
+            name[length++] = '_';
+            while (length < nameLength) {
+                name[length++] = (char)('a' + randomBelow(&rng, 26));
+            }
+        }
+        name[length] = '\0';
+        int quantity = (int)randomBelow(&rng, 1000) + 1;
+        int cents = 100 + (int)randomBelow(&rng, 9901); // 1.00 to 100.00
+        int category = randomCategory(&rng);
+
+        if (rowIds) {
+            long long row = firstRow + i;
+            rowIds[row] = (int)id;
+            rowQuantities[row] = quantity;
+            rowPrices[row] = (float)(cents / 100.0); // The value the loaders parse back from the CSV text
+            rowCategories[row] = (unsigned char)category;
+            memcpy(rowNames + row * rowNameWidth, name, length + 1);
+        }
+        if (!writeCsv) {
+            continue;
+        }
 
-        fprintf(file, "%lld,%s,%s,%d,%.2f\n", id, name, category, quantity, price);
+        char *p = buffer + used;
+        p += formatInt(p, id);
+        *p++ = ',';
+        memcpy(p, name, length);
+        p += length;
+        *p++ = ',';
+        size_t categoryLength = strlen(categoryNames[category]);
+        memcpy(p, categoryNames[category], categoryLength);
+        p += categoryLength;
+        *p++ = ',';
+        p += formatInt(p, quantity);
+        *p++ = ',';
+        p += formatInt(p, cents / 100);
+        *p++ = '.';
+        *p++ = (char)('0' + cents / 10 % 10);
+        *p++ = (char)('0' + cents % 10);
+        *p++ = '\n';
+        used = p - buffer;
+        if (used > WRITE_BUFFER_BYTES - ROW_BYTES) {
+            writeAll(fd, buffer, used, filename);
+            used = 0;
+        }
     }
 
-    fclose(file);
-    printf("Data written successfully to %s\n", filename);
+    if (writeCsv) {
+        writeAll(fd, buffer, used, filename);
+        if (close(fd) != 0) {
+            perror("Error closing file");
+            exit(EXIT_FAILURE);
+        }
+        free(buffer);
+        printf("Data written successfully to %s\n", filename);
+    }
+}
+
+// Function to fold size bytes (a multiple of 8) into a running snapshot checksum
+uint64_t snapshotChecksum(uint64_t checksum, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        checksum = (checksum ^ word) * 0x9E3779B97F4A7C15ULL;
+        checksum ^= checksum >> 29;
+    }
+    return checksum;
 }
 
-int main() {
-    srand(time(NULL)); 
+// Function to append bytes to the snapshot being written, zero-padding a final partial word
+void writeSnapshotSection(FILE *file, const void *data, size_t size, uint64_t *checksum) {
+    size_t whole = size & ~(size_t)7;
+    fwrite(data, 1, size, file);
+    *checksum = snapshotChecksum(*checksum, data, whole);
+    if (size > whole) {
+        uint64_t tail = 0;
+        memcpy(&tail, (const char *)data + whole, size - whole);
+        fwrite((const char *)&tail + (size - whole), 1, 8 - (size - whole), file);
+        *checksum = snapshotChecksum(*checksum, &tail, sizeof(tail));
+    }
+}
 
-    clock_t startTime = clock();
+// Function to allocate the row columns a snapshot is built from
+void allocateRows() {
+    rowIds = malloc(sizeof(int) * totalRows);
+    rowQuantities = malloc(sizeof(int) * totalRows);
+    rowPrices = malloc(sizeof(float) * totalRows);
+    rowCategories = malloc(totalRows);
+    // Wide enough for "Item_" and the largest ID, or for a padded name
+    char digits[16];
+    rowNameWidth = 5 + formatInt(digits, totalRows);
+    if (rowNameWidth < (size_t)nameLength) rowNameWidth = nameLength;
+    rowNameWidth++;
+    rowNames = malloc(rowNameWidth * totalRows);
+    if (!rowIds || !rowQuantities || !rowPrices || !rowCategories || !rowNames) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+}
 
-    long long itemsPerFile = MAX_ITEMS / NUM_FILES; 
-    long long remainder = MAX_ITEMS % NUM_FILES;   
+// Function to write the generated rows as a snapshot, exactly as a warehouse program would save them right after
+// loading the CSV files: categories numbered in order of first appearance, rows with an already seen ID dropped,
+// names packed back to back in row order, and the ID index sized and filled the way buildIndex() does it.
+void writeSnapshot(const char *filename) {
+    // Renumber categories by first appearance, as the CSV loader interns them
+    int codeOf[MAX_CATEGORIES], codeCount = 0;
+    char names[MAX_CATEGORIES][50];
+    for (int c = 0; c < MAX_CATEGORIES; c++) codeOf[c] = -1;
+    for (long long i = 0; i < totalRows && codeCount < categoryTotal; i++) {
+        if (codeOf[rowCategories[i]] < 0) {
+            memcpy(names[codeCount], categoryNames[rowCategories[i]], sizeof(names[0]));
+            codeOf[rowCategories[i]] = codeCount++;
+        }
+    }
 
-    for (int i = 0; i < NUM_FILES; i++) {
+    int capacity = MIN_INDEX_CAPACITY, shift = 32;
+    while (totalRows * 10 > (long long)capacity * 7) {
+        capacity *= 2;
+    }
+    for (int c = capacity; c > 1; c >>= 1) shift--;
+    IndexSlot *index = malloc(sizeof(IndexSlot) * capacity);
+    if (!index) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int s = 0; s < capacity; s++) {
+        index[s].id = 0;
+        index[s].row = INDEX_EMPTY;
+    }
+
+    unsigned char *nameLengths = malloc(totalRows);
+    if (!nameLengths) {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Insert every row into the index, compacting away rows whose ID is already there. The names are packed
+    // in place: a kept row's name never lands past the start of the next row's slot.
+    int kept = 0, categoryItemCount[MAX_CATEGORIES] = {0};
+    size_t nameBytes = 0;
+    unsigned int mask = capacity - 1;
+    for (long long i = 0; i < totalRows; i++) {
+        unsigned int slot = ((unsigned int)rowIds[i] * 2654435769u) >> shift;
+        while (index[slot].row != INDEX_EMPTY && index[slot].id != rowIds[i]) {
+            slot = (slot + 1) & mask;
+        }
+        if (index[slot].row != INDEX_EMPTY) {
+            continue;
+        }
+        index[slot].id = rowIds[i];
+        index[slot].row = kept;
+        rowIds[kept] = rowIds[i];
+        rowQuantities[kept] = rowQuantities[i];
+        rowPrices[kept] = rowPrices[i];
+        rowCategories[kept] = (unsigned char)codeOf[rowCategories[i]];
+        nameLengths[kept] = (unsigned char)strlen(rowNames + i * rowNameWidth);
+        memmove(rowNames + nameBytes, rowNames + i * rowNameWidth, nameLengths[kept] + 1);
+        nameBytes += nameLengths[kept] + 1;
+        categoryItemCount[rowCategories[kept]]++;
+        kept++;
+    }
+
+    char tempName[PATH_MAX];
+    if (snprintf(tempName, sizeof(tempName), "%s.tmp", filename) >= (int)sizeof(tempName)) {
+        fprintf(stderr, "Error writing snapshot: file name too long: %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    FILE *file = fopen(tempName, "wb");
+    int words = (kept + 63) / 64;
+    uint64_t *bitmap = malloc(sizeof(uint64_t) * (words ? words : 1));
+    if (!file || !bitmap) {
+        perror("Error writing snapshot");
+        exit(EXIT_FAILURE);
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.itemCount = kept;
+    header.categoryCount = codeCount;
+    header.indexCapacity = capacity;
+    header.nameBytes = nameBytes;
+    header.shardCount = 1;
+    fwrite(&header, sizeof(header), 1, file); // Rewritten with the checksum at the end
+
+    uint64_t checksum = SNAPSHOT_CHECKSUM_SEED;
+    writeSnapshotSection(file, names, sizeof(names[0]) * codeCount, &checksum);
+    writeSnapshotSection(file, categoryItemCount, sizeof(int) * codeCount, &checksum);
+    writeSnapshotSection(file, rowIds, sizeof(int) * kept, &checksum);
+    writeSnapshotSection(file, rowQuantities, sizeof(int) * kept, &checksum);
+    writeSnapshotSection(file, rowPrices, sizeof(float) * kept, &checksum);
+    writeSnapshotSection(file, rowCategories, kept, &checksum);
+    writeSnapshotSection(file, nameLengths, kept, &checksum);
+    writeSnapshotSection(file, rowNames, nameBytes, &checksum);
+    for (int c = 0; c < codeCount; c++) {
+        memset(bitmap, 0, sizeof(uint64_t) * words);
+        for (int i = 0; i < kept; i++) {
+            if (rowCategories[i] == c) bitmap[i / 64] |= 1ULL << (i % 64);
+        }
+        writeSnapshotSection(file, bitmap, sizeof(uint64_t) * words, &checksum);
+    }
+    writeSnapshotSection(file, index, sizeof(IndexSlot) * capacity, &checksum);
+    free(bitmap);
+    free(index);
+    free(nameLengths);
+
+    header.checksum = checksum;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    if (ferror(file) | fclose(file) || rename(tempName, filename) != 0) {
+        perror("Error writing snapshot");
+        remove(tempName);
+        exit(EXIT_FAILURE);
+    }
+    printf("Snapshot of %d items written to %s", kept, filename);
+    if (kept < totalRows) {
+        printf(" (%lld rows with a duplicate ID left out)", totalRows - kept);
+    }
+    printf("\n");
+}
+
+// Function to read the monotonic wall clock in seconds
+double wallClockSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Function to read the command line options
+void parseOptions(int argc, char *argv[]) {
+    seed = (uint64_t)time(NULL);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--rows=", 7) == 0 && argv[i][7] != '\0') {
+            totalRows = atoll(argv[i] + 7);
+        } else if (strncmp(argv[i], "--files=", 8) == 0 && argv[i][8] != '\0') {
+            fileCount = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0 && argv[i][7] != '\0') {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--zipf=", 7) == 0 && argv[i][7] != '\0') {
+            zipfExponent = atof(argv[i] + 7);
+        } else if (strncmp(argv[i], "--categories=", 13) == 0 && argv[i][13] != '\0') {
+            categoryTotal = atoi(argv[i] + 13);
+        } else if (strncmp(argv[i], "--name-length=", 14) == 0 && argv[i][14] != '\0') {
+            nameLength = atoi(argv[i] + 14);
+        } else if (strncmp(argv[i], "--duplicates=", 13) == 0 && argv[i][13] != '\0') {
+            duplicatePercent = atof(argv[i] + 13);
+        } else if (strncmp(argv[i], "--snapshot=", 11) == 0 && argv[i][11] != '\0') {
+            snapshotFile = argv[i] + 11;
+        } else if (strcmp(argv[i], "--no-csv") == 0) {
+            writeCsv = 0;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--rows=N] [--files=N] [--seed=N] [--zipf=S] [--categories=N] [--name-length=N] [--duplicates=PERCENT] [--snapshot=FILE] [--no-csv]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (totalRows < 1 || totalRows > INT_MAX || fileCount < 1 || fileCount > totalRows) {
+        fprintf(stderr, "Need 1 to %d rows and 1 file per row at most.\n", INT_MAX);
+        exit(EXIT_FAILURE);
+    }
+    if (categoryTotal < 1 || categoryTotal > MAX_CATEGORIES || zipfExponent < 0) {
+        fprintf(stderr, "Need 1 to %d categories and a Zipf exponent of 0 or more.\n", MAX_CATEGORIES);
+        exit(EXIT_FAILURE);
+    }
+    if (nameLength > MAX_NAME_LENGTH) {
+        nameLength = MAX_NAME_LENGTH;
+    }
+    if (duplicatePercent < 0 || duplicatePercent > 100) {
+        fprintf(stderr, "Duplicate percentage must be between 0 and 100.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (snapshotFile && totalRows > MAX_ITEMS) {
+        fprintf(stderr, "Snapshots are limited to %d rows, the most the warehouse programs hold.\n", MAX_ITEMS);
+        exit(EXIT_FAILURE);
+    }
+    if (!writeCsv && !snapshotFile) {
+        fprintf(stderr, "--no-csv needs --snapshot=FILE.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    parseOptions(argc, argv);
+    prepareCategories();
+    duplicateThreshold = (uint32_t)(duplicatePercent / 100 * 4294967295.0);
+    if (snapshotFile) {
+        allocateRows();
+    }
+
+    double startTime = wallClockSeconds();
+    printf("Generating %lld rows in %d files (seed %llu)...\n", totalRows, fileCount, (unsigned long long)seed);
+
+    long long itemsPerFile = totalRows / fileCount;
+    long long remainder = totalRows % fileCount;
+
+    // Files are independent, so each thread takes whole files
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < fileCount; i++) {
         char filename[50];
-        snprintf(filename, sizeof(filename), "warehouse_data_%d.csv", i + 1); 
+        snprintf(filename, sizeof(filename), "warehouse_data_%d.csv", i + 1);
 
-        long long startID = i * itemsPerFile + 1; 
-        long long numItems = itemsPerFile;      
+        long long firstRow = i * itemsPerFile;
+        long long numItems = itemsPerFile;
 
-        if (i == NUM_FILES - 1) { 
+        if (i == fileCount - 1) {
             numItems += remainder;
         }
 
-        printf("Generating data for file %s...\n", filename);
-        generateRandomData(filename, startID, numItems);
+        generateRandomData(filename, i, firstRow, numItems);
+    }
+
+    if (snapshotFile) {
+        writeSnapshot(snapshotFile);
     }
 
-    clock_t endTime = clock();
-    double totalTime = ((double)(endTime - startTime)) / CLOCKS_PER_SEC;
+    double totalTime = wallClockSeconds() - startTime;
 
     printf("All files generated successfully.\n");
     printf("Total time taken: %.2f seconds\n", totalTime);